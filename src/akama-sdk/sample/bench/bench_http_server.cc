@@ -0,0 +1,70 @@
+#include "akama-sdk/sample/bench/bench_http_server.h"
+
+#include "base/bind.h"
+#include "base/strings/string_number_conversions.h"
+#include "net/http/http_status_code.h"
+#include "net/test/embedded_test_server/http_request.h"
+#include "net/test/embedded_test_server/http_response.h"
+#include "url/gurl.h"
+
+namespace {
+
+constexpr char kPayloadPath[] = "/bytes";
+
+}  // namespace
+
+BenchHttpServer::BenchHttpServer(Protocol protocol)
+    : protocol_(protocol),
+      server_(protocol == Protocol::kHttp2
+                  ? net::EmbeddedTestServer::TYPE_HTTPS
+                  : net::EmbeddedTestServer::TYPE_HTTP,
+              protocol == Protocol::kHttp2
+                  ? net::test_server::HttpConnection::Protocol::kHttp2
+                  : net::test_server::HttpConnection::Protocol::kHttp1) {
+  if (protocol == Protocol::kHttp2)
+    server_.SetSSLConfig(net::EmbeddedTestServer::CERT_OK);
+  server_.RegisterRequestHandler(base::BindRepeating(
+      &BenchHttpServer::HandleRequest, base::Unretained(this)));
+}
+
+BenchHttpServer::~BenchHttpServer() = default;
+
+/* static */
+bool BenchHttpServer::RegisterTestCerts() {
+  return net::EmbeddedTestServer::RegisterTestCerts();
+}
+
+bool BenchHttpServer::Start() {
+  server_handle_ = server_.StartAndReturnHandle();
+  return static_cast<bool>(server_handle_);
+}
+
+std::string BenchHttpServer::GetPayloadUrl(size_t size) const {
+  return server_
+      .GetURL(std::string(kPayloadPath) + "?size=" + base::NumberToString(size))
+      .spec();
+}
+
+const char* BenchHttpServer::protocol_name() const {
+  return protocol_ == Protocol::kHttp2 ? "h2" : "h1";
+}
+
+std::unique_ptr<net::test_server::HttpResponse> BenchHttpServer::HandleRequest(
+    const net::test_server::HttpRequest& request) {
+  GURL url = request.GetURL();
+  size_t size = 0;
+  if (url.path() != kPayloadPath || url.query().rfind("size=", 0) != 0 ||
+      !base::StringToSizeT(url.query().substr(5), &size)) {
+    return nullptr;
+  }
+
+  auto it = payloads_.find(size);
+  if (it == payloads_.end())
+    it = payloads_.emplace(size, std::string(size, 'x')).first;
+
+  auto response = std::make_unique<net::test_server::BasicHttpResponse>();
+  response->set_code(net::HTTP_OK);
+  response->set_content_type("application/octet-stream");
+  response->set_content(it->second);
+  return response;
+}
@@ -0,0 +1,58 @@
+#ifndef AKAMA_SDK_SAMPLE_BENCH_BENCH_HTTP_SERVER_H_
+#define AKAMA_SDK_SAMPLE_BENCH_BENCH_HTTP_SERVER_H_
+
+#include <map>
+#include <memory>
+#include <string>
+
+#include "net/test/embedded_test_server/embedded_test_server.h"
+
+namespace net {
+namespace test_server {
+struct HttpRequest;
+class HttpResponse;
+}  // namespace test_server
+}  // namespace net
+
+// In-process HTTP server the benchmark runs against, so it never leaves the
+// machine. Serves "/bytes?size=N" with an N byte body, over HTTP/1.1 in clear
+// text or over HTTP/2 with TLS, using the test certificate of
+// EmbeddedTestServer.
+class BenchHttpServer {
+ public:
+  enum class Protocol {
+    kHttp1,
+    kHttp2,
+  };
+
+  explicit BenchHttpServer(Protocol protocol);
+  BenchHttpServer(const BenchHttpServer&) = delete;
+  BenchHttpServer& operator=(const BenchHttpServer&) = delete;
+  ~BenchHttpServer();
+
+  // Makes the engine trust the test certificate. Must be called once before
+  // any HTTP/2 server is used.
+  static bool RegisterTestCerts();
+
+  bool Start();
+
+  // Returns the URL of a |size| byte response.
+  std::string GetPayloadUrl(size_t size) const;
+
+  Protocol protocol() const { return protocol_; }
+  // Short protocol name used in the report, "h1" or "h2".
+  const char* protocol_name() const;
+
+ private:
+  // Runs on the IO thread of |server_|.
+  std::unique_ptr<net::test_server::HttpResponse> HandleRequest(
+      const net::test_server::HttpRequest& request);
+
+  const Protocol protocol_;
+  net::EmbeddedTestServer server_;
+  net::test_server::EmbeddedTestServerHandle server_handle_;
+  // Bodies by size, built once. Only used on the IO thread.
+  std::map<size_t, std::string> payloads_;
+};
+
+#endif  // AKAMA_SDK_SAMPLE_BENCH_BENCH_HTTP_SERVER_H_
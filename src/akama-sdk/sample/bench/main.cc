@@ -0,0 +1,232 @@
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "akama-sdk/sample/bench/bench_http_server.h"
+#include "akama-sdk/sample/demo/cronet/bulk_fetcher.h"
+#include "akama-sdk/sample/demo/cronet/request_metrics.h"
+#include "akama-sdk/sample/demo/cronet/response_body_sink.h"
+#include "akama-sdk/sample/demo/cronet/work_stealing_executor.h"
+#include "akama-sdk/sample/demo/cronet_engine.h"
+#include "base/command_line.h"
+#include "base/files/file_path.h"
+#include "base/files/file_util.h"
+#include "base/json/json_reader.h"
+#include "base/json/json_writer.h"
+#include "base/strings/string_number_conversions.h"
+#include "base/strings/string_split.h"
+#include "base/synchronization/lock.h"
+#include "base/time/time.h"
+#include "base/values.h"
+
+// clang-format off
+// akama-sdk-bench：在进程内启动HTTP/1.1和HTTP/2测试服务器，用CreateCronetEngine创建的engine
+// 按指定并发和payload大小压测，输出JSON格式的结果（qps、吞吐、p50/p90/p99/p999延迟），方便回归对比
+//
+// 参数：
+// --requests=N          每组测试的请求数，默认2000
+// --concurrency=N       同时进行的请求数，默认32
+// --payload-sizes=a,b   响应大小，默认1024,65536,1048576
+// --protocols=h1,h2     测试的协议，默认h1,h2
+// --workers=N           WorkStealingExecutor的线程数，默认CPU核数
+// --output=path         JSON结果另外写入文件
+// engine相关参数（--http-cache、--disable-quic等）见EngineProfile
+// clang-format on
+
+namespace {
+
+constexpr char kRequestsSwitch[] = "requests";
+constexpr char kConcurrencySwitch[] = "concurrency";
+constexpr char kPayloadSizesSwitch[] = "payload-sizes";
+constexpr char kProtocolsSwitch[] = "protocols";
+constexpr char kWorkersSwitch[] = "workers";
+constexpr char kOutputSwitch[] = "output";
+
+size_t GetSizeSwitch(const base::CommandLine& command_line,
+                     const char* name,
+                     size_t default_value) {
+  size_t value;
+  if (!base::StringToSizeT(command_line.GetSwitchValueASCII(name), &value))
+    return default_value;
+  return value;
+}
+
+std::vector<std::string> GetListSwitch(const base::CommandLine& command_line,
+                                       const char* name,
+                                       const std::string& default_value) {
+  std::string value = command_line.GetSwitchValueASCII(name);
+  return base::SplitString(value.empty() ? default_value : value, ",",
+                           base::TRIM_WHITESPACE, base::SPLIT_WANT_NONEMPTY);
+}
+
+// Returns the |percentile| (0-1) of the sorted |values|.
+double GetPercentile(const std::vector<double>& values, double percentile) {
+  if (values.empty())
+    return 0;
+  size_t rank = static_cast<size_t>(std::ceil(percentile * values.size()));
+  return values[std::min(values.size(), std::max<size_t>(rank, 1)) - 1];
+}
+
+struct RunStats {
+  size_t succeeded = 0;
+  size_t failed = 0;
+  int64_t body_bytes = 0;
+  // Latency of the succeeded requests in milliseconds.
+  std::vector<double> latencies_ms;
+  base::TimeDelta elapsed;
+};
+
+RunStats FetchAll(Cronet_EnginePtr engine,
+                  WorkStealingExecutor* executor,
+                  const std::string& url,
+                  size_t num_requests,
+                  size_t concurrency) {
+  RunStats stats;
+  stats.latencies_ms.reserve(num_requests);
+  base::Lock lock;
+
+  BulkFetcher fetcher(engine, executor, concurrency);
+  base::TimeTicks start = base::TimeTicks::Now();
+  fetcher.Fetch(
+      std::vector<std::string>(num_requests, url),
+      [&stats, &lock](BulkFetcher::Result result) {
+        double latency_ms =
+            std::chrono::duration<double, std::milli>(result.latency).count();
+        base::AutoLock auto_lock(lock);
+        if (!result.success || result.http_status_code != 200) {
+          ++stats.failed;
+          return;
+        }
+        ++stats.succeeded;
+        stats.body_bytes += result.body->size();
+        stats.latencies_ms.push_back(latency_ms);
+      },
+      nullptr);
+  fetcher.WaitForDone();
+  stats.elapsed = base::TimeTicks::Now() - start;
+  return stats;
+}
+
+base::Value::Dict RunBenchmark(Cronet_EnginePtr engine,
+                               WorkStealingExecutor* executor,
+                               const BenchHttpServer& server,
+                               size_t payload_size,
+                               size_t num_requests,
+                               size_t concurrency) {
+  const std::string url = server.GetPayloadUrl(payload_size);
+  // Warm up connections, so the handshakes are not part of the run.
+  FetchAll(engine, executor, url, concurrency, concurrency);
+  RunStats stats = FetchAll(engine, executor, url, num_requests, concurrency);
+
+  std::sort(stats.latencies_ms.begin(), stats.latencies_ms.end());
+  double seconds = stats.elapsed.InSecondsF();
+
+  base::Value::Dict latency;
+  latency.Set("p50", GetPercentile(stats.latencies_ms, 0.5));
+  latency.Set("p90", GetPercentile(stats.latencies_ms, 0.9));
+  latency.Set("p99", GetPercentile(stats.latencies_ms, 0.99));
+  latency.Set("p999", GetPercentile(stats.latencies_ms, 0.999));
+  latency.Set("max", stats.latencies_ms.empty() ? 0 : stats.latencies_ms.back());
+
+  base::Value::Dict run;
+  run.Set("protocol", server.protocol_name());
+  run.Set("payload_bytes", static_cast<double>(payload_size));
+  run.Set("concurrency", static_cast<int>(concurrency));
+  run.Set("requests", static_cast<int>(num_requests));
+  run.Set("succeeded", static_cast<int>(stats.succeeded));
+  run.Set("failed", static_cast<int>(stats.failed));
+  run.Set("duration_ms", stats.elapsed.InMillisecondsF());
+  run.Set("requests_per_second", seconds > 0 ? stats.succeeded / seconds : 0);
+  run.Set("bytes_per_second", seconds > 0 ? stats.body_bytes / seconds : 0);
+  run.Set("latency_ms", std::move(latency));
+  return run;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  base::CommandLine::Init(argc, argv);
+  const base::CommandLine& command_line =
+      *base::CommandLine::ForCurrentProcess();
+
+  const size_t num_requests =
+      GetSizeSwitch(command_line, kRequestsSwitch, 2000);
+  const size_t concurrency =
+      GetSizeSwitch(command_line, kConcurrencySwitch, 32);
+  std::vector<size_t> payload_sizes;
+  for (const std::string& size : GetListSwitch(
+           command_line, kPayloadSizesSwitch, "1024,65536,1048576")) {
+    size_t value;
+    if (base::StringToSizeT(size, &value))
+      payload_sizes.push_back(value);
+  }
+  std::vector<BenchHttpServer::Protocol> protocols;
+  for (const std::string& protocol :
+       GetListSwitch(command_line, kProtocolsSwitch, "h1,h2")) {
+    if (protocol == "h1")
+      protocols.push_back(BenchHttpServer::Protocol::kHttp1);
+    else if (protocol == "h2")
+      protocols.push_back(BenchHttpServer::Protocol::kHttp2);
+  }
+
+  // HTTP/2需要TLS，让engine信任测试证书
+  if (!BenchHttpServer::RegisterTestCerts()) {
+    std::cerr << "failed to register test certificates" << std::endl;
+    return 1;
+  }
+  // cronet会初始化线程池，测试服务器在engine之后启动
+  EngineProfile engine_profile;
+  if (!EngineProfile::FromCommandLine(command_line, &engine_profile))
+    return 1;
+  Cronet_EnginePtr engine = CreateCronetEngine(engine_profile);
+  if (!engine) {
+    std::cerr << "failed to start cronet engine" << std::endl;
+    return 1;
+  }
+  WorkStealingExecutor executor(GetSizeSwitch(command_line, kWorkersSwitch, 0));
+  // 每个请求各阶段的耗时，按host和协议汇总
+  RequestMetricsCollector request_metrics;
+  request_metrics.Attach(engine);
+
+  base::Value::List runs;
+  for (BenchHttpServer::Protocol protocol : protocols) {
+    BenchHttpServer server(protocol);
+    if (!server.Start()) {
+      std::cerr << "failed to start " << server.protocol_name() << " server"
+                << std::endl;
+      continue;
+    }
+    for (size_t payload_size : payload_sizes) {
+      runs.Append(RunBenchmark(engine, &executor, server, payload_size,
+                               num_requests, concurrency));
+    }
+  }
+
+  base::Value::Dict report;
+  report.Set("cronet_version", Cronet_Engine_GetVersionString(engine));
+  report.Set("workers", static_cast<int>(executor.num_workers()));
+  report.Set("runs", std::move(runs));
+  absl::optional<base::Value> network_metrics =
+      base::JSONReader::Read(request_metrics.GetSnapshotAsJson());
+  if (network_metrics)
+    report.Set("network_metrics", std::move(*network_metrics));
+
+  std::string json;
+  base::JSONWriter::WriteWithOptions(base::Value(std::move(report)),
+                                     base::JSONWriter::OPTIONS_PRETTY_PRINT,
+                                     &json);
+  std::cout << json;
+  if (command_line.HasSwitch(kOutputSwitch)) {
+    base::FilePath output = command_line.GetSwitchValuePath(kOutputSwitch);
+    if (!base::WriteFile(output, json))
+      std::cerr << "failed to write " << output << std::endl;
+  }
+
+  request_metrics.Detach();
+  executor.ShutdownExecutor();
+  Cronet_Engine_Shutdown(engine);
+  Cronet_Engine_Destroy(engine);
+  return 0;
+}
@@ -0,0 +1,241 @@
+#include "body_processor.h"
+
+#include "third_party/brotli/include/brotli/decode.h"
+#include "third_party/zlib/zlib.h"
+
+namespace {
+
+// Size of the output of one inflate call.
+constexpr size_t kInflateBufferSize = 32 * 1024;
+
+}  // namespace
+
+BodyProcessor::BodyProcessor() = default;
+
+BodyProcessor::~BodyProcessor() = default;
+
+bool BodyProcessor::OnEnd(bool complete) {
+  return EmitEnd(complete);
+}
+
+bool BodyProcessor::Fail(std::string error_message) {
+  error_message_ = std::move(error_message);
+  return false;
+}
+
+BodyProcessorChain::BodyProcessorChain() = default;
+
+BodyProcessorChain::~BodyProcessorChain() = default;
+
+std::string BodyProcessorChain::error_message() const {
+  for (const std::unique_ptr<BodyProcessor>& stage : stages_) {
+    if (!stage->error_message().empty())
+      return stage->error_message();
+  }
+  return std::string();
+}
+
+void BodyProcessorChain::OnBodyRead(Cronet_BufferPtr buffer,
+                                    uint64_t bytes_read,
+                                    ReadNext read_next) {
+  if (!failed_ && !stages_.empty()) {
+    const char* data = static_cast<const char*>(Cronet_Buffer_GetData(buffer));
+    failed_ = !stages_.front()->OnData(
+        std::string_view(data, static_cast<size_t>(bytes_read)));
+  }
+  if (failed_) {
+    Cronet_Buffer_Destroy(buffer);
+    read_next(nullptr);
+    return;
+  }
+  // Nothing keeps the data, the buffer is free for the next read.
+  read_next(buffer);
+}
+
+void BodyProcessorChain::OnBodyComplete(bool success) {
+  if (!failed_ && !stages_.empty())
+    failed_ = !stages_.front()->OnEnd(success);
+  succeeded_ = success && !failed_;
+}
+
+LineSplitter::LineSplitter(LineCallback callback, size_t max_line_size)
+    : callback_(std::move(callback)), max_line_size_(max_line_size) {}
+
+LineSplitter::~LineSplitter() = default;
+
+bool LineSplitter::OnData(std::string_view data) {
+  std::string_view rest = data;
+  size_t newline;
+  while ((newline = rest.find('\n')) != std::string_view::npos) {
+    std::string_view line = rest.substr(0, newline);
+    rest.remove_prefix(newline + 1);
+    if (partial_line_.empty()) {
+      if (!ReportLine(line))
+        return false;
+      continue;
+    }
+    if (partial_line_.size() + line.size() > max_line_size_)
+      return Fail("Line longer than " + std::to_string(max_line_size_));
+    partial_line_.append(line);
+    bool ok = ReportLine(partial_line_);
+    partial_line_.clear();
+    if (!ok)
+      return false;
+  }
+  if (partial_line_.size() + rest.size() > max_line_size_)
+    return Fail("Line longer than " + std::to_string(max_line_size_));
+  partial_line_.append(rest);
+  return Emit(data);
+}
+
+bool LineSplitter::OnEnd(bool complete) {
+  if (complete && !partial_line_.empty()) {
+    bool ok = ReportLine(partial_line_);
+    partial_line_.clear();
+    if (!ok)
+      return false;
+  }
+  return EmitEnd(complete);
+}
+
+bool LineSplitter::ReportLine(std::string_view line) {
+  if (!line.empty() && line.back() == '\r')
+    line.remove_suffix(1);
+  ++num_lines_;
+  if (!callback_(line))
+    return Fail("Stopped by the line callback");
+  return true;
+}
+
+struct InflateProcessor::Decoder {
+  Decoder() = default;
+  Decoder(const Decoder&) = delete;
+  Decoder& operator=(const Decoder&) = delete;
+  ~Decoder() {
+    if (zlib_initialized)
+      inflateEnd(&zlib_stream);
+    if (brotli_state)
+      BrotliDecoderDestroyInstance(brotli_state);
+  }
+
+  z_stream zlib_stream = {};
+  bool zlib_initialized = false;
+  BrotliDecoderState* brotli_state = nullptr;
+};
+
+InflateProcessor::InflateProcessor(Format format, uint64_t max_output_size)
+    : format_(format),
+      max_output_size_(max_output_size),
+      decoder_(std::make_unique<Decoder>()),
+      output_buffer_(kInflateBufferSize) {
+  if (format_ == Format::kGzip) {
+    // 32 on top of the window size lets zlib detect gzip or zlib headers.
+    decoder_->zlib_initialized =
+        inflateInit2(&decoder_->zlib_stream, MAX_WBITS + 32) == Z_OK;
+    if (!decoder_->zlib_initialized)
+      decoder_.reset();
+  } else {
+    decoder_->brotli_state =
+        BrotliDecoderCreateInstance(nullptr, nullptr, nullptr);
+    if (!decoder_->brotli_state)
+      decoder_.reset();
+  }
+}
+
+InflateProcessor::~InflateProcessor() = default;
+
+bool InflateProcessor::OnData(std::string_view data) {
+  if (!decoder_)
+    return Fail("Can't create the decoder");
+  return format_ == Format::kGzip ? InflateGzip(data) : InflateBrotli(data);
+}
+
+bool InflateProcessor::OnEnd(bool complete) {
+  if (complete && !stream_end_)
+    return Fail("Truncated compressed body");
+  return EmitEnd(complete);
+}
+
+bool InflateProcessor::InflateGzip(std::string_view data) {
+  z_stream& stream = decoder_->zlib_stream;
+  stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data.data()));
+  stream.avail_in = static_cast<uInt>(data.size());
+  do {
+    if (stream_end_ && stream.avail_in > 0) {
+      // Next gzip member.
+      if (inflateReset(&stream) != Z_OK)
+        return Fail("inflateReset failed");
+      stream_end_ = false;
+    }
+    stream.next_out = reinterpret_cast<Bytef*>(output_buffer_.data());
+    stream.avail_out = static_cast<uInt>(output_buffer_.size());
+    int result = inflate(&stream, Z_NO_FLUSH);
+    if (result == Z_STREAM_END) {
+      stream_end_ = true;
+    } else if (result != Z_OK && result != Z_BUF_ERROR) {
+      return Fail(std::string("inflate failed: ") +
+                  (stream.msg ? stream.msg : std::to_string(result)));
+    }
+    if (!EmitOutput(output_buffer_.size() - stream.avail_out))
+      return false;
+    // No progress is possible without more input.
+    if (result == Z_BUF_ERROR)
+      break;
+  } while (stream.avail_in > 0 || stream.avail_out == 0);
+  return true;
+}
+
+bool InflateProcessor::InflateBrotli(std::string_view data) {
+  if (stream_end_)
+    return data.empty() || Fail("Data after the end of the brotli stream");
+  const uint8_t* next_in = reinterpret_cast<const uint8_t*>(data.data());
+  size_t avail_in = data.size();
+  while (true) {
+    uint8_t* next_out = reinterpret_cast<uint8_t*>(output_buffer_.data());
+    size_t avail_out = output_buffer_.size();
+    BrotliDecoderResult result = BrotliDecoderDecompressStream(
+        decoder_->brotli_state, &avail_in, &next_in, &avail_out, &next_out,
+        nullptr);
+    if (result == BROTLI_DECODER_RESULT_ERROR) {
+      return Fail(std::string("Brotli decoding failed: ") +
+                  BrotliDecoderErrorString(
+                      BrotliDecoderGetErrorCode(decoder_->brotli_state)));
+    }
+    if (!EmitOutput(output_buffer_.size() - avail_out))
+      return false;
+    if (result == BROTLI_DECODER_RESULT_NEEDS_MORE_OUTPUT)
+      continue;
+    if (result == BROTLI_DECODER_RESULT_SUCCESS) {
+      stream_end_ = true;
+      if (avail_in > 0)
+        return Fail("Data after the end of the brotli stream");
+    }
+    // Done, or waiting for more input.
+    return true;
+  }
+}
+
+bool InflateProcessor::EmitOutput(size_t size) {
+  if (size == 0)
+    return true;
+  output_size_ += size;
+  if (max_output_size_ && output_size_ > max_output_size_) {
+    return Fail("Inflated body larger than " +
+                std::to_string(max_output_size_));
+  }
+  return Emit(std::string_view(output_buffer_.data(), size));
+}
+
+Crc32Checksum::Crc32Checksum()
+    : value_(static_cast<uint32_t>(crc32(0L, Z_NULL, 0))) {}
+
+Crc32Checksum::~Crc32Checksum() = default;
+
+bool Crc32Checksum::OnData(std::string_view data) {
+  // crc32() takes at most 4 GB at once, more than a read ever returns.
+  value_ = static_cast<uint32_t>(
+      crc32(value_, reinterpret_cast<const Bytef*>(data.data()),
+            static_cast<uInt>(data.size())));
+  size_ += data.size();
+  return Emit(data);
+}
@@ -0,0 +1,178 @@
+#ifndef AKAMA_SDK_SAMPLE_DEMO_CRONET_BODY_PROCESSOR_H_
+#define AKAMA_SDK_SAMPLE_DEMO_CRONET_BODY_PROCESSOR_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "cronet_c.h"
+#include "response_body_consumer.h"
+
+// One stage of a BodyProcessorChain. Sees the body piece by piece while it is
+// received and passes its output, the same bytes or transformed ones, on to
+// the next stage.
+class BodyProcessor {
+ public:
+  BodyProcessor();
+  BodyProcessor(const BodyProcessor&) = delete;
+  BodyProcessor& operator=(const BodyProcessor&) = delete;
+  virtual ~BodyProcessor();
+
+  // Processes the next piece of the body. Returns false to stop, which
+  // cancels the request.
+  virtual bool OnData(std::string_view data) = 0;
+  // Called once after the last piece. |complete| is false if the request
+  // failed or was canceled. Returns false if the body is invalid, e.g. a
+  // truncated compressed stream. Passes the end on by default.
+  virtual bool OnEnd(bool complete);
+
+  // Set if OnData() or OnEnd() returned false.
+  const std::string& error_message() const { return error_message_; }
+
+ protected:
+  // Passes |data| to the next stage, if any.
+  bool Emit(std::string_view data) { return !next_ || next_->OnData(data); }
+  bool EmitEnd(bool complete) { return !next_ || next_->OnEnd(complete); }
+  // Records |error_message| and returns false.
+  bool Fail(std::string error_message);
+
+ private:
+  friend class BodyProcessorChain;
+
+  BodyProcessor* next_ = nullptr;
+  std::string error_message_;
+};
+
+// Runs the body of a request through a chain of BodyProcessors as it is
+// read, so processing overlaps with the transfer and the body is never
+// buffered whole. Every buffer is handed back to Cronet once the chain is
+// done with it. Set it as the body consumer of a SampleUrlRequestCallback.
+class BodyProcessorChain : public ResponseBodyConsumer {
+ public:
+  BodyProcessorChain();
+  BodyProcessorChain(const BodyProcessorChain&) = delete;
+  BodyProcessorChain& operator=(const BodyProcessorChain&) = delete;
+  ~BodyProcessorChain() override;
+
+  // Appends a stage fed by the output of the previous one. Must be called
+  // before the request starts. Returns the stage, owned by |this|.
+  template <typename Stage, typename... Args>
+  Stage* AddStage(Args&&... args) {
+    auto stage = std::make_unique<Stage>(std::forward<Args>(args)...);
+    Stage* stage_ptr = stage.get();
+    if (!stages_.empty())
+      stages_.back()->next_ = stage_ptr;
+    stages_.push_back(std::move(stage));
+    return stage_ptr;
+  }
+
+  // True once the request is done and every stage accepted the whole body.
+  bool succeeded() const { return succeeded_; }
+  // Error of the first stage that failed, if any.
+  std::string error_message() const;
+
+  // ResponseBodyConsumer:
+  void OnBodyRead(Cronet_BufferPtr buffer,
+                  uint64_t bytes_read,
+                  ReadNext read_next) override;
+  void OnBodyComplete(bool success) override;
+
+ private:
+  std::vector<std::unique_ptr<BodyProcessor>> stages_;
+  // Set when a stage stopped the request.
+  bool failed_ = false;
+  bool succeeded_ = false;
+};
+
+// Calls |callback| for every newline-terminated record, without the "\n" or
+// "\r\n", and passes the body on unchanged. A last record without a newline
+// is reported at the end of a complete body. Records are only copied when
+// they span two pieces of the body.
+class LineSplitter : public BodyProcessor {
+ public:
+  // Returns false to stop the request.
+  using LineCallback = std::function<bool(std::string_view line)>;
+
+  explicit LineSplitter(LineCallback callback,
+                        size_t max_line_size = 1024 * 1024);
+  ~LineSplitter() override;
+
+  size_t num_lines() const { return num_lines_; }
+
+  // BodyProcessor:
+  bool OnData(std::string_view data) override;
+  bool OnEnd(bool complete) override;
+
+ private:
+  bool ReportLine(std::string_view line);
+
+  const LineCallback callback_;
+  const size_t max_line_size_;
+  // Start of a record continued in the next piece.
+  std::string partial_line_;
+  size_t num_lines_ = 0;
+};
+
+// Inflates a gzip, zlib or brotli stream Cronet did not decode itself, e.g. a
+// .gz file or a custom encoding, and passes the inflated data on.
+class InflateProcessor : public BodyProcessor {
+ public:
+  enum class Format {
+    // gzip or zlib, told apart by the header. Concatenated gzip members are
+    // inflated one after the other.
+    kGzip,
+    kBrotli,
+  };
+
+  // Fails once more than |max_output_size| bytes come out, 0 for no limit.
+  explicit InflateProcessor(Format format, uint64_t max_output_size = 0);
+  ~InflateProcessor() override;
+
+  uint64_t output_size() const { return output_size_; }
+
+  // BodyProcessor:
+  bool OnData(std::string_view data) override;
+  bool OnEnd(bool complete) override;
+
+ private:
+  // Keeps zlib and brotli out of the header.
+  struct Decoder;
+
+  bool InflateGzip(std::string_view data);
+  bool InflateBrotli(std::string_view data);
+  bool EmitOutput(size_t size);
+
+  const Format format_;
+  const uint64_t max_output_size_;
+  // Null if the decoder could not be created.
+  std::unique_ptr<Decoder> decoder_;
+  // True if the stream ended, more data may start a new gzip member.
+  bool stream_end_ = false;
+  uint64_t output_size_ = 0;
+  std::vector<char> output_buffer_;
+};
+
+// Computes the CRC-32 of the body, as in gzip and zip, and passes the body on
+// unchanged.
+class Crc32Checksum : public BodyProcessor {
+ public:
+  Crc32Checksum();
+  ~Crc32Checksum() override;
+
+  uint32_t value() const { return value_; }
+  uint64_t size() const { return size_; }
+
+  // BodyProcessor:
+  bool OnData(std::string_view data) override;
+
+ private:
+  uint32_t value_;
+  uint64_t size_ = 0;
+};
+
+#endif  // AKAMA_SDK_SAMPLE_DEMO_CRONET_BODY_PROCESSOR_H_
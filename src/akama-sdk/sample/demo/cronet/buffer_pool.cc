@@ -0,0 +1,112 @@
+#include "buffer_pool.h"
+
+#include <algorithm>
+
+BufferPool::BufferPool(size_t max_cached_bytes)
+    : max_cached_bytes_(max_cached_bytes),
+      callback_(Cronet_BufferCallback_CreateWith(BufferPool::OnBufferDestroyed)) {
+  Cronet_BufferCallback_SetClientContext(callback_, this);
+}
+
+BufferPool::~BufferPool() {
+  for (size_t i = 0; i < kNumBuckets; ++i) {
+    for (char* block : buckets_[i].free_blocks)
+      delete[] block;
+  }
+  Cronet_BufferCallback_Destroy(callback_);
+}
+
+/* static */
+BufferPool* BufferPool::GetInstance() {
+  static BufferPool* const instance = new BufferPool();
+  return instance;
+}
+
+Cronet_BufferPtr BufferPool::Acquire(size_t size) {
+  const size_t index = GetBucketIndex(size);
+  const size_t block_size = GetBucketSize(index);
+
+  char* block = nullptr;
+  {
+    Bucket& bucket = buckets_[index];
+    std::lock_guard<std::mutex> lock(bucket.lock);
+    if (!bucket.free_blocks.empty()) {
+      block = bucket.free_blocks.back();
+      bucket.free_blocks.pop_back();
+    }
+  }
+  if (block) {
+    hits_.fetch_add(1, std::memory_order_relaxed);
+    cached_bytes_.fetch_sub(block_size, std::memory_order_relaxed);
+  } else {
+    misses_.fetch_add(1, std::memory_order_relaxed);
+    block = new char[block_size];
+  }
+  outstanding_buffers_.fetch_add(1, std::memory_order_relaxed);
+  outstanding_bytes_.fetch_add(block_size, std::memory_order_relaxed);
+
+  Cronet_BufferPtr buffer = Cronet_Buffer_Create();
+  Cronet_Buffer_InitWithDataAndCallback(buffer, block, block_size, callback_);
+  return buffer;
+}
+
+BufferPool::Stats BufferPool::GetStats() const {
+  Stats stats;
+  stats.hits = hits_.load(std::memory_order_relaxed);
+  stats.misses = misses_.load(std::memory_order_relaxed);
+  stats.outstanding_buffers =
+      outstanding_buffers_.load(std::memory_order_relaxed);
+  stats.outstanding_bytes = outstanding_bytes_.load(std::memory_order_relaxed);
+  stats.cached_bytes = cached_bytes_.load(std::memory_order_relaxed);
+  return stats;
+}
+
+/* static */
+size_t BufferPool::GetBucketIndex(size_t size) {
+  size_t index = 0;
+  while (index + 1 < kNumBuckets && GetBucketSize(index) < size)
+    ++index;
+  return index;
+}
+
+void BufferPool::Release(char* block, size_t size) {
+  outstanding_buffers_.fetch_sub(1, std::memory_order_relaxed);
+  outstanding_bytes_.fetch_sub(size, std::memory_order_relaxed);
+
+  if (cached_bytes_.fetch_add(size, std::memory_order_relaxed) + size >
+      max_cached_bytes_) {
+    cached_bytes_.fetch_sub(size, std::memory_order_relaxed);
+    delete[] block;
+    return;
+  }
+  Bucket& bucket = buckets_[GetBucketIndex(size)];
+  std::lock_guard<std::mutex> lock(bucket.lock);
+  bucket.free_blocks.push_back(block);
+}
+
+/* static */
+void BufferPool::OnBufferDestroyed(Cronet_BufferCallbackPtr self,
+                                   Cronet_BufferPtr buffer) {
+  auto* pool =
+      static_cast<BufferPool*>(Cronet_BufferCallback_GetClientContext(self));
+  pool->Release(static_cast<char*>(Cronet_Buffer_GetData(buffer)),
+                Cronet_Buffer_GetSize(buffer));
+}
+
+AdaptiveReadSize::AdaptiveReadSize(int64_t content_length)
+    : size_(kDefaultSize) {
+  if (content_length >= 0) {
+    size_ = BufferPool::kMinBlockSize;
+    while (size_ < BufferPool::kMaxBlockSize &&
+           size_ < static_cast<uint64_t>(content_length)) {
+      size_ <<= 1;
+    }
+  }
+}
+
+void AdaptiveReadSize::OnReadCompleted(size_t buffer_size, size_t bytes_read) {
+  if (bytes_read >= buffer_size)
+    size_ = std::min(size_ * 2, BufferPool::kMaxBlockSize);
+  else if (bytes_read < buffer_size / 4)
+    size_ = std::max(size_ / 2, BufferPool::kMinBlockSize);
+}
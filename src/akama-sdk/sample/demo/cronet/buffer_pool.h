@@ -0,0 +1,107 @@
+#ifndef AKAMA_SDK_SAMPLE_DEMO_CRONET_BUFFER_POOL_H_
+#define AKAMA_SDK_SAMPLE_DEMO_CRONET_BUFFER_POOL_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+#include "cronet_c.h"
+
+// Process-wide pool of memory blocks for Cronet_Buffer.
+//
+// Blocks are bucketed by power of two sizes from kMinBlockSize to
+// kMaxBlockSize. Acquire() wraps a pooled block into a new Cronet_Buffer with
+// Cronet_Buffer_InitWithDataAndCallback(), and destroying that buffer, by the
+// application or by Cronet, puts the block back into its bucket. Freed blocks
+// are kept until |max_cached_bytes| are cached, the rest goes back to the heap.
+class BufferPool {
+ public:
+  struct Stats {
+    // Acquire() calls served from a bucket and from the heap.
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    // Buffers acquired and not destroyed yet, and their total size.
+    int64_t outstanding_buffers = 0;
+    int64_t outstanding_bytes = 0;
+    // Size of the blocks waiting in the buckets.
+    int64_t cached_bytes = 0;
+
+    double hit_rate() const {
+      uint64_t total = hits + misses;
+      return total ? static_cast<double>(hits) / total : 0;
+    }
+  };
+
+  static constexpr size_t kMinBlockSize = 4 * 1024;
+  static constexpr size_t kMaxBlockSize = 1024 * 1024;
+  static constexpr size_t kDefaultMaxCachedBytes = 32 * 1024 * 1024;
+
+  explicit BufferPool(size_t max_cached_bytes = kDefaultMaxCachedBytes);
+  BufferPool(const BufferPool&) = delete;
+  BufferPool& operator=(const BufferPool&) = delete;
+  // Must outlive all buffers it handed out.
+  ~BufferPool();
+
+  // Returns the pool shared by all requests. Never destroyed.
+  static BufferPool* GetInstance();
+
+  // Returns a buffer of at least |size| bytes, clamped to
+  // [kMinBlockSize, kMaxBlockSize] and rounded up to the bucket size.
+  Cronet_BufferPtr Acquire(size_t size);
+
+  Stats GetStats() const;
+
+ private:
+  static constexpr size_t kNumBuckets = 9;
+  static_assert(kMinBlockSize << (kNumBuckets - 1) == kMaxBlockSize,
+                "Buckets must cover all block sizes");
+
+  struct Bucket {
+    std::mutex lock;
+    std::vector<char*> free_blocks;
+  };
+
+  static size_t GetBucketIndex(size_t size);
+  static size_t GetBucketSize(size_t index) { return kMinBlockSize << index; }
+
+  // Puts |block| of |size| bytes back into its bucket.
+  void Release(char* block, size_t size);
+
+  // Implementation of Cronet_BufferCallback methods.
+  static void OnBufferDestroyed(Cronet_BufferCallbackPtr self,
+                                Cronet_BufferPtr buffer);
+
+  const size_t max_cached_bytes_;
+  Bucket buckets_[kNumBuckets];
+
+  std::atomic<uint64_t> hits_{0};
+  std::atomic<uint64_t> misses_{0};
+  std::atomic<int64_t> outstanding_buffers_{0};
+  std::atomic<int64_t> outstanding_bytes_{0};
+  std::atomic<int64_t> cached_bytes_{0};
+
+  Cronet_BufferCallbackPtr const callback_;
+};
+
+// Picks the size of the next read of a response body. Starts from the
+// Content-Length if there is one, doubles while reads fill the whole buffer
+// and halves when they use less than a quarter of it, so tiny bodies use tiny
+// buffers and large transfers get large ones.
+class AdaptiveReadSize {
+ public:
+  // |content_length| is -1 if it is unknown.
+  explicit AdaptiveReadSize(int64_t content_length = -1);
+
+  size_t size() const { return size_; }
+  // Adjusts size() after a read of |bytes_read| into a |buffer_size| buffer.
+  void OnReadCompleted(size_t buffer_size, size_t bytes_read);
+
+  static constexpr size_t kDefaultSize = 16 * 1024;
+
+ private:
+  size_t size_;
+};
+
+#endif  // AKAMA_SDK_SAMPLE_DEMO_CRONET_BUFFER_POOL_H_
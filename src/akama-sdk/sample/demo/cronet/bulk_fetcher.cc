@@ -0,0 +1,416 @@
+#include "bulk_fetcher.h"
+
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <utility>
+
+#include "response_body_sink.h"
+#include "response_cache.h"
+#include "sample_url_request_callback.h"
+#include "work_stealing_executor.h"
+
+namespace {
+
+// Index of the attempt not chosen yet.
+constexpr size_t kNoWinner = static_cast<size_t>(-1);
+
+void RunTask(Cronet_RunnablePtr self) {
+  std::unique_ptr<std::function<void()>> task(
+      static_cast<std::function<void()>*>(
+          Cronet_Runnable_GetClientContext(self)));
+  (*task)();
+}
+
+// Runs |task| on |executor|, which takes over the runnable.
+void PostTask(Cronet_ExecutorPtr executor, std::function<void()> task) {
+  Cronet_RunnablePtr runnable = Cronet_Runnable_CreateWith(RunTask);
+  Cronet_Runnable_SetClientContext(
+      runnable, new std::function<void()>(std::move(task)));
+  Cronet_Executor_Execute(executor, runnable);
+}
+
+}  // namespace
+
+// One URL of the batch. Owns its Cronet_UrlRequests, the original one and the
+// hedge if it was sent, and deletes itself through
+// BulkFetcher::OnRequestDone() once all of them are done.
+class BulkFetcher::Request {
+ public:
+  Request(BulkFetcher* owner,
+          std::string url,
+          ResponseCache* cache,
+          std::shared_ptr<const ResponseCache::Entry> stale_entry)
+      : owner_(owner),
+        url_(std::move(url)),
+        cache_(cache),
+        stale_entry_(std::move(stale_entry)) {}
+  Request(const Request&) = delete;
+  Request& operator=(const Request&) = delete;
+  ~Request() = default;
+
+  // Starts the request. Unless zero, it is canceled after |timeout| and
+  // hedged after |hedge_delay|, both run by |timer|.
+  void Start(Cronet_EnginePtr engine,
+             Cronet_ExecutorPtr executor,
+             const std::string& http_method,
+             bool disable_cache,
+             std::chrono::milliseconds timeout,
+             std::chrono::microseconds hedge_delay,
+             DeadlineTimer* timer) {
+    engine_ = engine;
+    executor_ = executor;
+    http_method_ = http_method;
+    disable_cache_ = disable_cache;
+    timer_ = timer;
+
+    std::lock_guard<std::mutex> lock(lock_);
+    start_time_ = std::chrono::steady_clock::now();
+    StartAttempt();
+    if (timeout.count() > 0) {
+      timeout_timer_id_ = timer_->Schedule(start_time_ + timeout,
+                                           [this] { Cancel(true); });
+    }
+    if (hedge_delay.count() > 0) {
+      hedge_timer_id_ = timer_->Schedule(start_time_ + hedge_delay,
+                                         [this] { OnHedgeDelayPassed(); });
+    }
+  }
+
+  // Cancels the attempts still running, reporting the request as timed out if
+  // |timed_out|.
+  void Cancel(bool timed_out) {
+    std::lock_guard<std::mutex> lock(lock_);
+    canceled_ = true;
+    timed_out_ = timed_out_ || timed_out;
+    CancelRunningAttempts();
+  }
+
+  Result TakeResult(bool success) {
+    Attempt& winner = *attempts_[winner_];
+    Result result;
+    result.success = success;
+    result.http_status_code = winner.callback.http_status_code();
+    result.was_cached = winner.callback.was_cached();
+    result.timed_out = timed_out_ && !success;
+    result.hedged = attempts_.size() > 1;
+    result.hedge_won = winner_ > 0;
+    result.error_message = result.timed_out
+                               ? "Timed out"
+                               : winner.callback.last_error_message();
+    result.body = winner.callback.TakeResponseBody();
+    result.latency = std::chrono::steady_clock::now() - start_time_;
+    if (cache_ && success) {
+      std::shared_ptr<const ResponseCache::Entry> entry =
+          cache_->Update(url_, stale_entry_, result.http_status_code,
+                         winner.callback.response_headers(), result.body);
+      if (entry) {
+        result.http_status_code = entry->http_status_code;
+        result.body = entry->body;
+        result.from_response_cache = true;
+      }
+    }
+    result.url = std::move(url_);
+    return result;
+  }
+
+ private:
+  // One Cronet_UrlRequest for the URL.
+  struct Attempt {
+    Attempt() : request(Cronet_UrlRequest_Create()) {}
+    Attempt(const Attempt&) = delete;
+    Attempt& operator=(const Attempt&) = delete;
+    ~Attempt() { Cronet_UrlRequest_Destroy(request); }
+
+    SampleUrlRequestCallback callback;
+    Cronet_UrlRequestPtr const request;
+    bool done = false;
+  };
+
+  // Must be called with |lock_| held, which also keeps the callbacks of the
+  // new attempt waiting until it is added to |attempts_|.
+  void StartAttempt() {
+    const size_t index = attempts_.size();
+    auto attempt = std::make_unique<Attempt>();
+    attempt->callback.set_verbose(false);
+    attempt->callback.set_done_callback(
+        [this, index](bool success) { OnAttemptDone(index, success); });
+
+    Cronet_UrlRequestParamsPtr request_params =
+        Cronet_UrlRequestParams_Create();
+    Cronet_UrlRequestParams_http_method_set(request_params,
+                                            http_method_.c_str());
+    Cronet_UrlRequestParams_disable_cache_set(request_params, disable_cache_);
+    if (stale_entry_)
+      ResponseCache::AddConditionalHeaders(*stale_entry_, request_params);
+    Cronet_UrlRequest_InitWithParams(attempt->request, engine_, url_.c_str(),
+                                     request_params,
+                                     attempt->callback.GetUrlRequestCallback(),
+                                     executor_);
+    Cronet_UrlRequestParams_Destroy(request_params);
+
+    Cronet_UrlRequest_Start(attempt->request);
+    attempts_.push_back(std::move(attempt));
+  }
+
+  // Must be called with |lock_| held.
+  void CancelRunningAttempts() {
+    for (const std::unique_ptr<Attempt>& attempt : attempts_) {
+      if (!attempt->done)
+        Cronet_UrlRequest_Cancel(attempt->request);
+    }
+  }
+
+  void OnHedgeDelayPassed() {
+    std::lock_guard<std::mutex> lock(lock_);
+    if (canceled_ || winner_ != kNoWinner || attempts_.size() > 1)
+      return;
+    StartAttempt();
+  }
+
+  void OnAttemptDone(size_t index, bool success) {
+    {
+      std::lock_guard<std::mutex> lock(lock_);
+      attempts_[index]->done = true;
+      ++num_attempts_done_;
+      // The first successful attempt wins and the other one is dropped. A
+      // failed attempt only wins if there is no other one left to wait for.
+      if (winner_ == kNoWinner &&
+          (success || num_attempts_done_ == attempts_.size())) {
+        winner_ = index;
+        winner_success_ = success;
+        CancelRunningAttempts();
+      }
+      if (num_attempts_done_ != attempts_.size())
+        return;
+    }
+    // No timer may run once |this| is deleted. A hedge firing meanwhile sees
+    // the winner and does nothing.
+    timer_->Cancel(timeout_timer_id_);
+    timer_->Cancel(hedge_timer_id_);
+    owner_->OnRequestDone(this, winner_success_);
+  }
+
+  BulkFetcher* const owner_;
+  std::string url_;
+  ResponseCache* const cache_;
+  // Entry being revalidated by this request, if any.
+  const std::shared_ptr<const ResponseCache::Entry> stale_entry_;
+  Cronet_EnginePtr engine_ = nullptr;
+  Cronet_ExecutorPtr executor_ = nullptr;
+  std::string http_method_;
+  bool disable_cache_ = false;
+  DeadlineTimer* timer_ = nullptr;
+  DeadlineTimer::TimerId timeout_timer_id_ = DeadlineTimer::kInvalidTimerId;
+  DeadlineTimer::TimerId hedge_timer_id_ = DeadlineTimer::kInvalidTimerId;
+  std::chrono::steady_clock::time_point start_time_;
+
+  // Synchronise access to the members below between the attempts and the
+  // timers.
+  std::mutex lock_;
+  std::vector<std::unique_ptr<Attempt>> attempts_;
+  size_t num_attempts_done_ = 0;
+  size_t winner_ = kNoWinner;
+  bool winner_success_ = false;
+  bool canceled_ = false;
+  bool timed_out_ = false;
+};
+
+BulkFetcher::BulkFetcher(Cronet_EnginePtr engine,
+                         WorkStealingExecutor* executor,
+                         size_t max_concurrency)
+    : engine_(engine),
+      executor_(executor),
+      max_concurrency_(std::max<size_t>(1, max_concurrency)),
+      timer_(DeadlineTimer::GetInstance()) {}
+
+BulkFetcher::~BulkFetcher() {
+  DeadlineTimer::TimerId batch_timer_id;
+  {
+    std::lock_guard<std::mutex> lock(lock_);
+    batch_timer_id = batch_timer_id_;
+  }
+  timer_->Cancel(batch_timer_id);
+  Cancel();
+  WaitForDone();
+}
+
+void BulkFetcher::Fetch(std::vector<std::string> urls,
+                        ResultCallback on_result,
+                        DoneCallback on_done) {
+  DeadlineTimer::TimerId previous_batch_timer_id;
+  {
+    std::lock_guard<std::mutex> lock(lock_);
+    previous_batch_timer_id = batch_timer_id_;
+    batch_timer_id_ = DeadlineTimer::kInvalidTimerId;
+  }
+  // The deadline of the previous batch must not cancel this one.
+  timer_->Cancel(previous_batch_timer_id);
+  {
+    std::lock_guard<std::mutex> lock(lock_);
+    urls_ = std::move(urls);
+    next_url_ = 0;
+    num_reported_ = 0;
+    canceled_ = false;
+    batch_timed_out_ = false;
+    running_ = !urls_.empty();
+    on_result_ = std::move(on_result);
+    on_done_ = std::move(on_done);
+  }
+  if (!running_) {
+    if (on_done_)
+      on_done_();
+    return;
+  }
+  if (batch_timeout_.count() > 0) {
+    DeadlineTimer::TimerId batch_timer_id =
+        timer_->Schedule(std::chrono::steady_clock::now() + batch_timeout_,
+                         [this] { CancelBatch(true); });
+    std::lock_guard<std::mutex> lock(lock_);
+    batch_timer_id_ = batch_timer_id;
+  }
+  for (size_t i = 0; i < max_concurrency_; ++i)
+    StartNext();
+}
+
+void BulkFetcher::CancelBatch(bool timed_out) {
+  std::vector<std::string> unstarted_urls;
+  {
+    std::lock_guard<std::mutex> lock(lock_);
+    canceled_ = true;
+    batch_timed_out_ = batch_timed_out_ || timed_out;
+    timed_out = batch_timed_out_;
+    for (Request* request : in_flight_)
+      request->Cancel(timed_out);
+    unstarted_urls.assign(urls_.begin() + next_url_, urls_.end());
+    next_url_ = urls_.size();
+  }
+  if (unstarted_urls.empty())
+    return;
+  // The result callbacks may take long, they must not hold up the timer
+  // thread.
+  PostTask(executor_->GetExecutor(),
+           [this, unstarted_urls = std::move(unstarted_urls), timed_out] {
+             ReportUnstarted(unstarted_urls, timed_out);
+           });
+}
+
+void BulkFetcher::ReportUnstarted(const std::vector<std::string>& urls,
+                                  bool timed_out) {
+  // The last one may finish the batch, so |this| must not be used afterwards.
+  for (const std::string& url : urls) {
+    Result result;
+    result.url = url;
+    result.body = std::make_shared<ResponseBodySink>();
+    result.timed_out = timed_out;
+    result.error_message = timed_out ? "Timed out" : "Canceled";
+    ReportResult(std::move(result));
+  }
+}
+
+void BulkFetcher::WaitForDone() {
+  std::unique_lock<std::mutex> lock(lock_);
+  batch_done_.wait(lock, [this] { return !running_; });
+}
+
+bool BulkFetcher::WaitForDoneUntil(
+    std::chrono::steady_clock::time_point deadline) {
+  std::unique_lock<std::mutex> lock(lock_);
+  return batch_done_.wait_until(lock, deadline, [this] { return !running_; });
+}
+
+void BulkFetcher::StartNext() {
+  std::vector<Result> cached_results;
+  Request* request = nullptr;
+  while (!request) {
+    std::string url;
+    {
+      std::lock_guard<std::mutex> lock(lock_);
+      if (canceled_ || next_url_ >= urls_.size())
+        break;
+      url = urls_[next_url_++];
+    }
+    ResponseCache::LookupResult cached;
+    if (response_cache_ && http_method_ == "GET")
+      cached = response_cache_->Lookup(url);
+    if (cached.fresh) {
+      Result result;
+      result.url = std::move(url);
+      result.success = true;
+      result.http_status_code = cached.entry->http_status_code;
+      result.from_response_cache = true;
+      result.body = cached.entry->body;
+      cached_results.push_back(std::move(result));
+      continue;
+    }
+
+    std::lock_guard<std::mutex> lock(lock_);
+    request = new Request(this, std::move(url),
+                          http_method_ == "GET" ? response_cache_ : nullptr,
+                          cached.entry);
+    in_flight_.push_back(request);
+  }
+
+  if (request) {
+    request->Start(engine_, executor_->GetExecutor(), http_method_,
+                   disable_cache_, request_timeout_, GetHedgeDelay(), timer_);
+
+    // Cancel() may have run before the request was started.
+    std::lock_guard<std::mutex> lock(lock_);
+    if (canceled_ && std::find(in_flight_.begin(), in_flight_.end(),
+                               request) != in_flight_.end()) {
+      request->Cancel(batch_timed_out_);
+    }
+  }
+  // The last one may finish the batch, so |this| must not be used afterwards.
+  for (Result& result : cached_results)
+    ReportResult(std::move(result));
+}
+
+std::chrono::microseconds BulkFetcher::GetHedgeDelay() {
+  // Only idempotent requests can be sent twice.
+  if (hedge_percentile_ <= 0 ||
+      (http_method_ != "GET" && http_method_ != "HEAD")) {
+    return std::chrono::microseconds(0);
+  }
+  if (latencies_us_.GetSnapshot().count <
+      std::max<size_t>(1, hedge_min_samples_)) {
+    return std::chrono::microseconds(0);
+  }
+  return std::chrono::microseconds(
+      latencies_us_.GetPercentile(hedge_percentile_));
+}
+
+void BulkFetcher::OnRequestDone(Request* request, bool success) {
+  Result result = request->TakeResult(success);
+  if (result.success) {
+    latencies_us_.Record(static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::microseconds>(result.latency)
+            .count()));
+  }
+  {
+    std::lock_guard<std::mutex> lock(lock_);
+    in_flight_.erase(
+        std::find(in_flight_.begin(), in_flight_.end(), request));
+  }
+  delete request;
+
+  StartNext();
+  // May finish the batch, so |this| must not be used afterwards.
+  ReportResult(std::move(result));
+}
+
+void BulkFetcher::ReportResult(Result result) {
+  on_result_(std::move(result));
+
+  {
+    std::lock_guard<std::mutex> lock(lock_);
+    if (++num_reported_ != urls_.size())
+      return;
+  }
+  if (on_done_)
+    on_done_();
+  std::lock_guard<std::mutex> lock(lock_);
+  running_ = false;
+  batch_done_.notify_all();
+}
@@ -0,0 +1,169 @@
+#ifndef AKAMA_SDK_SAMPLE_DEMO_CRONET_BULK_FETCHER_H_
+#define AKAMA_SDK_SAMPLE_DEMO_CRONET_BULK_FETCHER_H_
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "cronet_c.h"
+#include "deadline_timer.h"
+#include "request_metrics.h"
+
+class ResponseBodySink;
+class ResponseCache;
+class WorkStealingExecutor;
+
+// Fetches a list of URLs on a shared engine, keeping at most
+// |max_concurrency| requests in flight. Every URL is reported through the
+// result callback as soon as it is done, so the caller is never blocked.
+//
+// Requests and batches can be given a deadline, after which they are
+// canceled, and slow requests can be hedged: once a request has been
+// outstanding for longer than a percentile of the latencies seen so far, a
+// duplicate is sent and whichever response completes first is kept. The
+// deadlines and hedges of all requests run on the shared DeadlineTimer.
+class BulkFetcher {
+ public:
+  struct Result {
+    std::string url;
+    bool success = false;
+    int http_status_code = 0;
+    // True if the response came from the HTTP cache of the engine.
+    bool was_cached = false;
+    // True if the response was served by the ResponseCache, either without a
+    // request or after a 304 reply.
+    bool from_response_cache = false;
+    // True if the request or the batch timed out.
+    bool timed_out = false;
+    // True if a duplicate of the request was sent, and if its response was
+    // the one kept.
+    bool hedged = false;
+    bool hedge_won = false;
+    std::string error_message;
+    // Never null. Shared, so the result can be passed around without copying
+    // the body.
+    std::shared_ptr<const ResponseBodySink> body;
+    // Time between starting the request and its last callback.
+    std::chrono::steady_clock::duration latency{};
+  };
+  // Invoked once per URL on one of the executor threads, possibly
+  // concurrently for different URLs.
+  using ResultCallback = std::function<void(Result result)>;
+  // Invoked once after the result of the last URL is reported.
+  using DoneCallback = std::function<void()>;
+
+  BulkFetcher(Cronet_EnginePtr engine,
+              WorkStealingExecutor* executor,
+              size_t max_concurrency);
+  BulkFetcher(const BulkFetcher&) = delete;
+  BulkFetcher& operator=(const BulkFetcher&) = delete;
+  // Cancels the requests in flight and waits for them.
+  ~BulkFetcher();
+
+  // Serves URLs from |cache| when possible and stores the responses in it.
+  // |cache| must outlive |this|. Fresh entries are reported right away, from
+  // the thread that gets the concurrency slot, which may be the thread calling
+  // Fetch().
+  void set_response_cache(ResponseCache* cache) { response_cache_ = cache; }
+  // Method of the requests, GET by default. The response cache is only used
+  // for GET.
+  void set_http_method(std::string method) { http_method_ = std::move(method); }
+  // Bypasses the HTTP cache of the engine.
+  void set_disable_cache(bool disable_cache) { disable_cache_ = disable_cache; }
+  // Cancels every request still outstanding |timeout| after it started, and
+  // reports it as timed out. Zero, the default, means no deadline.
+  void set_request_timeout(std::chrono::milliseconds timeout) {
+    request_timeout_ = timeout;
+  }
+  // Cancels the batch |timeout| after Fetch(), URLs not done by then are
+  // reported as timed out. Zero, the default, means no deadline.
+  void set_batch_timeout(std::chrono::milliseconds timeout) {
+    batch_timeout_ = timeout;
+  }
+  // Hedges GET and HEAD requests outstanding for longer than |percentile| of
+  // the latencies of the previous requests of |this|, once |min_samples| of
+  // them succeeded. A percentile of 95 sends about 5% more requests. Zero
+  // disables hedging, the default.
+  void set_hedging(double percentile, size_t min_samples) {
+    hedge_percentile_ = percentile;
+    hedge_min_samples_ = min_samples;
+  }
+
+  // Starts fetching |urls|. Must not be called again before the previous
+  // batch is done.
+  void Fetch(std::vector<std::string> urls,
+             ResultCallback on_result,
+             DoneCallback on_done);
+
+  // Cancels the requests in flight. URLs that were not started yet are
+  // reported as failed from an executor thread, never from the calling one,
+  // so the caller may hold locks its result callback takes.
+  void Cancel() { CancelBatch(false); }
+
+  // Waits until the current batch is done.
+  void WaitForDone();
+  // Waits until the current batch is done or |deadline| passed. Returns true
+  // if the batch is done.
+  bool WaitForDoneUntil(std::chrono::steady_clock::time_point deadline);
+
+  size_t max_concurrency() const { return max_concurrency_; }
+
+ private:
+  class Request;
+
+  // Cancels the batch, marking the results as timed out if |timed_out|. The
+  // URLs not started yet are reported from an executor thread.
+  void CancelBatch(bool timed_out);
+  // Reports |urls| as canceled, or timed out if |timed_out|.
+  void ReportUnstarted(const std::vector<std::string>& urls, bool timed_out);
+  // Returns how long a new request may be outstanding before it is hedged,
+  // or zero if it must not be.
+  std::chrono::microseconds GetHedgeDelay();
+  // Starts the next URL of the batch if there is one. URLs fresh in
+  // |response_cache_| are reported without taking the slot.
+  void StartNext();
+  // Called from |request| callbacks once it is done.
+  void OnRequestDone(Request* request, bool success);
+  // Reports |result| and runs |on_done_| if it was the last one.
+  void ReportResult(Result result);
+
+  Cronet_EnginePtr const engine_;
+  WorkStealingExecutor* const executor_;
+  const size_t max_concurrency_;
+  ResponseCache* response_cache_ = nullptr;
+  std::string http_method_ = "GET";
+  bool disable_cache_ = false;
+  std::chrono::milliseconds request_timeout_{0};
+  std::chrono::milliseconds batch_timeout_{0};
+  double hedge_percentile_ = 0;
+  size_t hedge_min_samples_ = 0;
+  DeadlineTimer* const timer_;
+  // Latencies of the successful requests, in microseconds.
+  LogLinearHistogram latencies_us_;
+
+  // Synchronise access to the members below.
+  std::mutex lock_;
+  std::vector<std::string> urls_;
+  // Index of the next URL to start.
+  size_t next_url_ = 0;
+  // Number of URLs reported so far.
+  size_t num_reported_ = 0;
+  bool canceled_ = false;
+  bool batch_timed_out_ = false;
+  DeadlineTimer::TimerId batch_timer_id_ = DeadlineTimer::kInvalidTimerId;
+  // True from Fetch() until |on_done_| returned.
+  bool running_ = false;
+  std::vector<Request*> in_flight_;
+  ResultCallback on_result_;
+  DoneCallback on_done_;
+  // Notified when the batch is done.
+  std::condition_variable batch_done_;
+};
+
+#endif  // AKAMA_SDK_SAMPLE_DEMO_CRONET_BULK_FETCHER_H_
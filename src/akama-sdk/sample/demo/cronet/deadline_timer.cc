@@ -0,0 +1,110 @@
+#include "deadline_timer.h"
+
+#include <algorithm>
+#include <utility>
+
+namespace {
+
+// Below this size the heap is never compacted.
+constexpr size_t kMinHeapSizeToCompact = 64;
+
+}  // namespace
+
+DeadlineTimer::DeadlineTimer()
+    : timer_thread_(&DeadlineTimer::RunTimers, this) {}
+
+DeadlineTimer::~DeadlineTimer() {
+  {
+    std::lock_guard<std::mutex> lock(lock_);
+    stop_thread_loop_ = true;
+  }
+  wake_up_.notify_one();
+  timer_thread_.join();
+}
+
+/* static */
+DeadlineTimer* DeadlineTimer::GetInstance() {
+  static DeadlineTimer* const instance = new DeadlineTimer();
+  return instance;
+}
+
+DeadlineTimer::TimerId DeadlineTimer::Schedule(
+    std::chrono::steady_clock::time_point deadline,
+    Callback callback) {
+  bool is_earliest;
+  TimerId id;
+  {
+    std::lock_guard<std::mutex> lock(lock_);
+    id = next_id_++;
+    callbacks_.emplace(id, std::move(callback));
+    heap_.push_back({deadline, id});
+    std::push_heap(heap_.begin(), heap_.end(), Later());
+    is_earliest = heap_.front().id == id;
+  }
+  // Later deadlines are picked up when the thread wakes up anyway.
+  if (is_earliest)
+    wake_up_.notify_one();
+  return id;
+}
+
+bool DeadlineTimer::Cancel(TimerId id) {
+  if (id == kInvalidTimerId)
+    return false;
+  std::unique_lock<std::mutex> lock(lock_);
+  if (callbacks_.erase(id)) {
+    MaybeCompactHeap();
+    return true;
+  }
+  // Waiting from the callback itself would never return.
+  if (std::this_thread::get_id() != timer_thread_.get_id())
+    callback_done_.wait(lock, [this, id] { return running_id_ != id; });
+  return false;
+}
+
+void DeadlineTimer::RunTimers() {
+  std::unique_lock<std::mutex> lock(lock_);
+  while (!stop_thread_loop_) {
+    if (heap_.empty()) {
+      wake_up_.wait(lock);
+      continue;
+    }
+    const Pending earliest = heap_.front();
+    auto it = callbacks_.find(earliest.id);
+    if (it == callbacks_.end()) {
+      // Canceled.
+      std::pop_heap(heap_.begin(), heap_.end(), Later());
+      heap_.pop_back();
+      continue;
+    }
+    if (std::chrono::steady_clock::now() < earliest.deadline) {
+      wake_up_.wait_until(lock, earliest.deadline);
+      continue;
+    }
+
+    std::pop_heap(heap_.begin(), heap_.end(), Later());
+    heap_.pop_back();
+    Callback callback = std::move(it->second);
+    callbacks_.erase(it);
+    running_id_ = earliest.id;
+    lock.unlock();
+    callback();
+    // Destroy what the callback holds before Cancel() returns.
+    callback = nullptr;
+    lock.lock();
+    running_id_ = kInvalidTimerId;
+    callback_done_.notify_all();
+  }
+}
+
+void DeadlineTimer::MaybeCompactHeap() {
+  if (heap_.size() < kMinHeapSizeToCompact ||
+      heap_.size() < 2 * callbacks_.size()) {
+    return;
+  }
+  heap_.erase(std::remove_if(heap_.begin(), heap_.end(),
+                             [this](const Pending& pending) {
+                               return !callbacks_.count(pending.id);
+                             }),
+              heap_.end());
+  std::make_heap(heap_.begin(), heap_.end(), Later());
+}
@@ -0,0 +1,82 @@
+#ifndef AKAMA_SDK_SAMPLE_DEMO_CRONET_DEADLINE_TIMER_H_
+#define AKAMA_SDK_SAMPLE_DEMO_CRONET_DEADLINE_TIMER_H_
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// Runs callbacks at deadlines on one thread shared by any number of requests,
+// instead of a timer per request. Pending deadlines are kept in a min-heap,
+// so scheduling and canceling are O(log n) and the thread only wakes up for
+// the earliest one.
+class DeadlineTimer {
+ public:
+  using TimerId = uint64_t;
+  using Callback = std::function<void()>;
+
+  // Never returned by Schedule(), ignored by Cancel().
+  static constexpr TimerId kInvalidTimerId = 0;
+
+  DeadlineTimer();
+  DeadlineTimer(const DeadlineTimer&) = delete;
+  DeadlineTimer& operator=(const DeadlineTimer&) = delete;
+  // Drops the pending callbacks without running them.
+  ~DeadlineTimer();
+
+  // Timer shared by the whole process. Never destroyed.
+  static DeadlineTimer* GetInstance();
+
+  // Runs |callback| on the timer thread once |deadline| passed. The callback
+  // must be short, it delays the ones after it.
+  TimerId Schedule(std::chrono::steady_clock::time_point deadline,
+                   Callback callback);
+
+  // Cancels timer |id|. Returns true if its callback won't run. If the
+  // callback is running on another thread, waits for it to return, so the
+  // state it uses can be destroyed right after. Ids that already fired or
+  // were canceled are ignored.
+  bool Cancel(TimerId id);
+
+ private:
+  struct Pending {
+    std::chrono::steady_clock::time_point deadline;
+    TimerId id;
+  };
+  struct Later {
+    bool operator()(const Pending& a, const Pending& b) const {
+      return a.deadline > b.deadline ||
+             (a.deadline == b.deadline && a.id > b.id);
+    }
+  };
+
+  // Runs the callbacks as their deadlines pass until |stop_thread_loop_|.
+  void RunTimers();
+  // Drops the heap entries of canceled timers once they dominate the heap.
+  void MaybeCompactHeap();
+
+  // Synchronise access to the members below.
+  std::mutex lock_;
+  // Min-heap on the deadline. Canceled timers stay in it until they reach
+  // the top or the heap is compacted.
+  std::vector<Pending> heap_;
+  // Callbacks of the timers that are neither run nor canceled.
+  std::unordered_map<TimerId, Callback> callbacks_;
+  TimerId next_id_ = kInvalidTimerId + 1;
+  // Timer whose callback is running, if any.
+  TimerId running_id_ = kInvalidTimerId;
+  // Notified if the earliest deadline changed or |stop_thread_loop_| is set.
+  std::condition_variable wake_up_;
+  // Notified when a callback returned.
+  std::condition_variable callback_done_;
+  bool stop_thread_loop_ = false;
+
+  std::thread timer_thread_;
+};
+
+#endif  // AKAMA_SDK_SAMPLE_DEMO_CRONET_DEADLINE_TIMER_H_
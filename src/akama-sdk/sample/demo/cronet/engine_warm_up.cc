@@ -0,0 +1,56 @@
+#include "engine_warm_up.h"
+
+#include <utility>
+
+namespace {
+
+// Warms up all origins at once, they are usually few.
+constexpr size_t kMaxConcurrency = 16;
+
+}  // namespace
+
+EngineWarmUp::EngineWarmUp(Cronet_EnginePtr engine,
+                           WorkStealingExecutor* executor)
+    : fetcher_(engine, executor, kMaxConcurrency) {
+  // Only the connection matters, neither a body nor a cached response.
+  fetcher_.set_http_method("HEAD");
+  fetcher_.set_disable_cache(true);
+}
+
+EngineWarmUp::~EngineWarmUp() = default;
+
+void EngineWarmUp::Start(const std::vector<std::string>& origins) {
+  std::vector<std::string> urls;
+  urls.reserve(origins.size());
+  for (const std::string& origin : origins) {
+    // HEAD the root of the origin.
+    urls.push_back(!origin.empty() && origin.back() == '/' ? origin
+                                                           : origin + "/");
+  }
+  fetcher_.Fetch(
+      std::move(urls),
+      [this](BulkFetcher::Result result) {
+        OriginResult origin_result;
+        origin_result.origin = std::move(result.url);
+        // Any HTTP response means the connection is up.
+        origin_result.success = result.success;
+        origin_result.latency = result.latency;
+        std::lock_guard<std::mutex> lock(lock_);
+        results_.push_back(std::move(origin_result));
+      },
+      nullptr);
+}
+
+bool EngineWarmUp::WaitUntil(std::chrono::steady_clock::time_point deadline) {
+  return fetcher_.WaitForDoneUntil(deadline);
+}
+
+void EngineWarmUp::Cancel() {
+  fetcher_.Cancel();
+  fetcher_.WaitForDone();
+}
+
+std::vector<EngineWarmUp::OriginResult> EngineWarmUp::GetResults() const {
+  std::lock_guard<std::mutex> lock(lock_);
+  return results_;
+}
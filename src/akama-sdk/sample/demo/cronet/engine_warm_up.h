@@ -0,0 +1,57 @@
+#ifndef AKAMA_SDK_SAMPLE_DEMO_CRONET_ENGINE_WARM_UP_H_
+#define AKAMA_SDK_SAMPLE_DEMO_CRONET_ENGINE_WARM_UP_H_
+
+#include <chrono>
+#include <cstddef>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "bulk_fetcher.h"
+#include "cronet_c.h"
+
+class WorkStealingExecutor;
+
+// Gets an engine ready for the origins it is about to use. The native Cronet
+// API has no preconnect or DNS prefetch call, so a HEAD request is sent to
+// every origin in parallel instead: it resolves the host, sets up the TCP or
+// QUIC connection and the TLS session, all of which are then reused by the
+// real requests. QUIC hints for the origins must be set on the engine params,
+// see EngineProfile.
+class EngineWarmUp {
+ public:
+  struct OriginResult {
+    std::string origin;
+    bool success = false;
+    std::chrono::steady_clock::duration latency{};
+  };
+
+  EngineWarmUp(Cronet_EnginePtr engine, WorkStealingExecutor* executor);
+  EngineWarmUp(const EngineWarmUp&) = delete;
+  EngineWarmUp& operator=(const EngineWarmUp&) = delete;
+  // Cancels the warm-up requests still in flight.
+  ~EngineWarmUp();
+
+  // Starts warming up |origins|, e.g. "https://www.example.com". Can be
+  // called once.
+  void Start(const std::vector<std::string>& origins);
+
+  // Waits until every origin is warm or |deadline| passed. The warm-up goes
+  // on in the background after a timeout. Returns true if it finished.
+  bool WaitUntil(std::chrono::steady_clock::time_point deadline);
+
+  // Cancels the requests still in flight and waits for them. Must be called
+  // before the engine is shut down.
+  void Cancel();
+
+  // Origins warmed up so far.
+  std::vector<OriginResult> GetResults() const;
+
+ private:
+  mutable std::mutex lock_;
+  std::vector<OriginResult> results_;
+  // Last, so it is destroyed, and waits for its callbacks, first.
+  BulkFetcher fetcher_;
+};
+
+#endif  // AKAMA_SDK_SAMPLE_DEMO_CRONET_ENGINE_WARM_UP_H_
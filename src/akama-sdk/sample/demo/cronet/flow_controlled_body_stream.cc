@@ -0,0 +1,316 @@
+#include "flow_controlled_body_stream.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <utility>
+
+#include "buffer_pool.h"
+#include "memory_budget.h"
+
+class FlowControlledBodyStream::State
+    : public std::enable_shared_from_this<State> {
+ public:
+  State(const Options& options, DataAvailableCallback data_available)
+      : options_(options), data_available_(std::move(data_available)) {}
+  State(const State&) = delete;
+  State& operator=(const State&) = delete;
+
+  ~State() {
+    // Chunks never popped.
+    for (const Queued& queued : queue_) {
+      Cronet_Buffer_Destroy(queued.buffer);
+      if (options_.budget)
+        options_.budget->Release(queued.capacity);
+    }
+  }
+
+  void OnBodyRead(Cronet_BufferPtr buffer,
+                  uint64_t bytes_read,
+                  ReadNext read_next) {
+    const size_t capacity = static_cast<size_t>(Cronet_Buffer_GetSize(buffer));
+    size_t reserved;
+    bool canceled;
+    {
+      std::lock_guard<std::mutex> lock(lock_);
+      reserved = read_reserved_bytes_;
+      read_reserved_bytes_ = 0;
+      canceled = canceled_;
+      if (!canceled) {
+        queue_.push_back(
+            {buffer, static_cast<size_t>(bytes_read), capacity});
+        buffered_bytes_ += static_cast<size_t>(bytes_read);
+        peak_buffered_bytes_ = std::max(peak_buffered_bytes_, buffered_bytes_);
+        pending_read_ = std::move(read_next);
+      }
+    }
+    if (canceled) {
+      Cronet_Buffer_Destroy(buffer);
+      if (options_.budget)
+        options_.budget->Release(reserved);
+      read_next(nullptr);
+      return;
+    }
+    // The budget was charged for the size of the read, or not at all for the
+    // first read, issued by SampleUrlRequestCallback.
+    if (options_.budget) {
+      if (capacity > reserved)
+        options_.budget->ForceAcquire(capacity - reserved);
+      else
+        options_.budget->Release(reserved - capacity);
+    }
+    data_ready_.notify_all();
+    if (data_available_)
+      data_available_();
+    MaybeRead();
+  }
+
+  void OnBodyComplete(bool success) {
+    size_t reserved;
+    {
+      std::lock_guard<std::mutex> lock(lock_);
+      done_ = true;
+      success_ = success;
+      pending_read_ = nullptr;
+      reserved = read_reserved_bytes_;
+      read_reserved_bytes_ = 0;
+    }
+    if (options_.budget && reserved)
+      options_.budget->Release(reserved);
+    data_ready_.notify_all();
+    if (data_available_)
+      data_available_();
+  }
+
+  bool Pop(Chunk* chunk, bool wait) {
+    // Before locking, dropping the old chunk takes the lock too.
+    chunk->Reset();
+    std::unique_lock<std::mutex> lock(lock_);
+    if (wait)
+      data_ready_.wait(lock, [this] { return !queue_.empty() || done_; });
+    if (queue_.empty())
+      return false;
+    const Queued& queued = queue_.front();
+    chunk->state_ = shared_from_this();
+    chunk->buffer_ = queued.buffer;
+    chunk->size_ = queued.size;
+    chunk->capacity_ = queued.capacity;
+    queue_.pop_front();
+    return true;
+  }
+
+  void OnChunkConsumed(Cronet_BufferPtr buffer, size_t size, size_t capacity) {
+    Cronet_Buffer_Destroy(buffer);
+    {
+      std::lock_guard<std::mutex> lock(lock_);
+      buffered_bytes_ -= size;
+    }
+    if (options_.budget)
+      options_.budget->Release(capacity);
+    MaybeRead();
+  }
+
+  void Cancel() {
+    ReadNext read_next;
+    {
+      std::lock_guard<std::mutex> lock(lock_);
+      canceled_ = true;
+      // A read waiting for the budget is canceled once it is granted, and a
+      // read in flight once it completes.
+      if (!waiting_for_budget_)
+        read_next = std::move(pending_read_);
+    }
+    if (read_next)
+      read_next(nullptr);
+  }
+
+  bool at_end() const {
+    std::lock_guard<std::mutex> lock(lock_);
+    return done_ && queue_.empty();
+  }
+
+  bool succeeded() const {
+    std::lock_guard<std::mutex> lock(lock_);
+    return success_;
+  }
+
+  Stats GetStats() const {
+    std::lock_guard<std::mutex> lock(lock_);
+    Stats stats;
+    stats.buffered_bytes = buffered_bytes_;
+    stats.peak_buffered_bytes = peak_buffered_bytes_;
+    stats.pauses = pauses_;
+    stats.budget_waits = budget_waits_;
+    return stats;
+  }
+
+ private:
+  struct Queued {
+    Cronet_BufferPtr buffer;
+    size_t size;
+    size_t capacity;
+  };
+
+  // Issues the held-off read once the consumer is below the watermark and
+  // the budget has room for it.
+  void MaybeRead() {
+    ReadNext read_next;
+    {
+      std::lock_guard<std::mutex> lock(lock_);
+      if (!pending_read_ || waiting_for_budget_ || canceled_ || done_)
+        return;
+      // Between the marks, keep going in the direction we were going.
+      const bool hold_off = paused_
+                                ? buffered_bytes_ > options_.low_water_mark
+                                : buffered_bytes_ >= options_.high_water_mark;
+      if (hold_off) {
+        if (!paused_)
+          ++pauses_;
+        paused_ = true;
+        return;
+      }
+      paused_ = false;
+      if (options_.budget) {
+        std::weak_ptr<State> weak_state = weak_from_this();
+        MemoryBudget* budget = options_.budget;
+        const size_t size = options_.read_size;
+        if (!budget->Acquire(size, [weak_state, budget, size] {
+              if (std::shared_ptr<State> state = weak_state.lock())
+                state->OnBudgetGranted();
+              else
+                budget->Release(size);
+            })) {
+          waiting_for_budget_ = true;
+          ++budget_waits_;
+          return;
+        }
+        read_reserved_bytes_ = size;
+      }
+      read_next = std::move(pending_read_);
+    }
+    read_next(BufferPool::GetInstance()->Acquire(options_.read_size));
+  }
+
+  void OnBudgetGranted() {
+    ReadNext read_next;
+    bool canceled;
+    {
+      std::lock_guard<std::mutex> lock(lock_);
+      waiting_for_budget_ = false;
+      canceled = canceled_ || done_;
+      read_next = std::move(pending_read_);
+      if (!canceled)
+        read_reserved_bytes_ = options_.read_size;
+    }
+    if (canceled) {
+      options_.budget->Release(options_.read_size);
+      if (read_next)
+        read_next(nullptr);
+      return;
+    }
+    read_next(BufferPool::GetInstance()->Acquire(options_.read_size));
+  }
+
+  const Options options_;
+  const DataAvailableCallback data_available_;
+
+  // Synchronise access to the members below.
+  mutable std::mutex lock_;
+  std::deque<Queued> queue_;
+  // Bytes of body received and not consumed yet.
+  size_t buffered_bytes_ = 0;
+  size_t peak_buffered_bytes_ = 0;
+  // Read held off by the watermarks or the budget.
+  ReadNext pending_read_;
+  // Charged to the budget for the read in flight.
+  size_t read_reserved_bytes_ = 0;
+  bool paused_ = false;
+  bool waiting_for_budget_ = false;
+  bool canceled_ = false;
+  bool done_ = false;
+  bool success_ = false;
+  uint64_t pauses_ = 0;
+  uint64_t budget_waits_ = 0;
+  // Notified when a chunk is queued or the body ended.
+  std::condition_variable data_ready_;
+};
+
+FlowControlledBodyStream::Chunk::Chunk() = default;
+
+FlowControlledBodyStream::Chunk::Chunk(Chunk&& other)
+    : state_(std::move(other.state_)),
+      buffer_(std::exchange(other.buffer_, nullptr)),
+      size_(std::exchange(other.size_, 0)),
+      capacity_(std::exchange(other.capacity_, 0)) {}
+
+FlowControlledBodyStream::Chunk& FlowControlledBodyStream::Chunk::operator=(
+    Chunk&& other) {
+  if (this != &other) {
+    Reset();
+    state_ = std::move(other.state_);
+    buffer_ = std::exchange(other.buffer_, nullptr);
+    size_ = std::exchange(other.size_, 0);
+    capacity_ = std::exchange(other.capacity_, 0);
+  }
+  return *this;
+}
+
+FlowControlledBodyStream::Chunk::~Chunk() {
+  Reset();
+}
+
+const char* FlowControlledBodyStream::Chunk::data() const {
+  return buffer_ ? static_cast<const char*>(Cronet_Buffer_GetData(buffer_))
+                 : nullptr;
+}
+
+void FlowControlledBodyStream::Chunk::Reset() {
+  if (buffer_)
+    state_->OnChunkConsumed(buffer_, size_, capacity_);
+  state_.reset();
+  buffer_ = nullptr;
+  size_ = 0;
+  capacity_ = 0;
+}
+
+FlowControlledBodyStream::FlowControlledBodyStream(
+    const Options& options,
+    DataAvailableCallback data_available)
+    : state_(std::make_shared<State>(options, std::move(data_available))) {}
+
+FlowControlledBodyStream::~FlowControlledBodyStream() = default;
+
+bool FlowControlledBodyStream::TryPop(Chunk* chunk) {
+  return state_->Pop(chunk, false);
+}
+
+bool FlowControlledBodyStream::Pop(Chunk* chunk) {
+  return state_->Pop(chunk, true);
+}
+
+bool FlowControlledBodyStream::at_end() const {
+  return state_->at_end();
+}
+
+bool FlowControlledBodyStream::succeeded() const {
+  return state_->succeeded();
+}
+
+void FlowControlledBodyStream::Cancel() {
+  state_->Cancel();
+}
+
+FlowControlledBodyStream::Stats FlowControlledBodyStream::GetStats() const {
+  return state_->GetStats();
+}
+
+void FlowControlledBodyStream::OnBodyRead(Cronet_BufferPtr buffer,
+                                          uint64_t bytes_read,
+                                          ReadNext read_next) {
+  state_->OnBodyRead(buffer, bytes_read, std::move(read_next));
+}
+
+void FlowControlledBodyStream::OnBodyComplete(bool success) {
+  state_->OnBodyComplete(success);
+}
@@ -0,0 +1,111 @@
+#ifndef AKAMA_SDK_SAMPLE_DEMO_CRONET_FLOW_CONTROLLED_BODY_STREAM_H_
+#define AKAMA_SDK_SAMPLE_DEMO_CRONET_FLOW_CONTROLLED_BODY_STREAM_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string_view>
+
+#include "cronet_c.h"
+#include "response_body_consumer.h"
+
+class MemoryBudget;
+
+// Queues the body of a request for a consumer running on another thread or
+// sequence, and reads only as fast as the consumer keeps up: once the bytes
+// waiting for the consumer reach the high-water mark no read is issued until
+// they fall below the low-water mark. Every buffer, queued or being read
+// into, is also charged to an optional MemoryBudget shared by all requests,
+// so a burst of requests can't grow the process without bound.
+//
+// The consumer pops chunks and drops them once it is done with their data,
+// which frees the memory and resumes the reads. It must not hold on to
+// chunks while waiting for more data, or a full budget never drains.
+class FlowControlledBodyStream : public ResponseBodyConsumer {
+ public:
+  struct Options {
+    size_t high_water_mark = 1024 * 1024;
+    size_t low_water_mark = 256 * 1024;
+    // Size of the buffers of the reads.
+    size_t read_size = 32 * 1024;
+    // Shared by the streams of all requests, null for no budget. Must
+    // outlive the stream and its chunks.
+    MemoryBudget* budget = nullptr;
+  };
+
+  struct Stats {
+    size_t buffered_bytes = 0;
+    size_t peak_buffered_bytes = 0;
+    // Times the reads were held off by the high-water mark.
+    uint64_t pauses = 0;
+    // Times a read waited for the budget.
+    uint64_t budget_waits = 0;
+  };
+
+  class State;
+
+  // A piece of the body, moved out of the stream. Frees its buffer and its
+  // share of the budget when destroyed.
+  class Chunk {
+   public:
+    Chunk();
+    Chunk(Chunk&& other);
+    Chunk& operator=(Chunk&& other);
+    ~Chunk();
+
+    const char* data() const;
+    size_t size() const { return size_; }
+    std::string_view AsStringView() const { return {data(), size_}; }
+
+    // Frees the chunk early.
+    void Reset();
+
+   private:
+    friend class State;
+
+    std::shared_ptr<State> state_;
+    Cronet_BufferPtr buffer_ = nullptr;
+    size_t size_ = 0;
+    // Size of |buffer_|, charged to the budget.
+    size_t capacity_ = 0;
+  };
+
+  // Run on the Cronet executor when a chunk is queued and when the body
+  // ended, e.g. to post a task draining the stream to the consumer sequence.
+  using DataAvailableCallback = std::function<void()>;
+
+  FlowControlledBodyStream(const Options& options,
+                           DataAvailableCallback data_available);
+  FlowControlledBodyStream(const FlowControlledBodyStream&) = delete;
+  FlowControlledBodyStream& operator=(const FlowControlledBodyStream&) =
+      delete;
+  ~FlowControlledBodyStream() override;
+
+  // Moves the next chunk to |chunk| if there is one. Any thread.
+  bool TryPop(Chunk* chunk);
+  // Waits for the next chunk. Returns false once the body ended.
+  bool Pop(Chunk* chunk);
+  // True once the request is done and every chunk was popped.
+  bool at_end() const;
+  // True if the request succeeded. Only meaningful at_end().
+  bool succeeded() const;
+
+  // Cancels the request, e.g. when the consumer gives up.
+  void Cancel();
+
+  Stats GetStats() const;
+
+  // ResponseBodyConsumer:
+  void OnBodyRead(Cronet_BufferPtr buffer,
+                  uint64_t bytes_read,
+                  ReadNext read_next) override;
+  void OnBodyComplete(bool success) override;
+
+ private:
+  // Shared with the chunks and the budget callbacks, which may outlive
+  // |this|.
+  const std::shared_ptr<State> state_;
+};
+
+#endif  // AKAMA_SDK_SAMPLE_DEMO_CRONET_FLOW_CONTROLLED_BODY_STREAM_H_
@@ -0,0 +1,62 @@
+#include "memory_budget.h"
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+MemoryBudget::MemoryBudget(size_t limit) : limit_(limit) {}
+
+MemoryBudget::~MemoryBudget() = default;
+
+bool MemoryBudget::Acquire(size_t size, GrantedCallback granted) {
+  std::lock_guard<std::mutex> lock(lock_);
+  // Nobody jumps the line, or large requests would starve.
+  if (waiters_.empty() && FitsLocked(size)) {
+    TakeLocked(size);
+    return true;
+  }
+  ++waits_;
+  waiters_.push_back({size, std::move(granted)});
+  return false;
+}
+
+void MemoryBudget::ForceAcquire(size_t size) {
+  std::lock_guard<std::mutex> lock(lock_);
+  TakeLocked(size);
+}
+
+void MemoryBudget::Release(size_t size) {
+  std::vector<GrantedCallback> granted;
+  {
+    std::lock_guard<std::mutex> lock(lock_);
+    used_ -= std::min(size, used_);
+    while (!waiters_.empty() && FitsLocked(waiters_.front().size)) {
+      TakeLocked(waiters_.front().size);
+      granted.push_back(std::move(waiters_.front().granted));
+      waiters_.pop_front();
+    }
+  }
+  // The callbacks usually issue a read, which may release more.
+  for (GrantedCallback& callback : granted)
+    callback();
+}
+
+MemoryBudget::Stats MemoryBudget::GetStats() const {
+  std::lock_guard<std::mutex> lock(lock_);
+  Stats stats;
+  stats.limit = limit_;
+  stats.used = used_;
+  stats.peak = peak_;
+  stats.waits = waits_;
+  stats.waiting = waiters_.size();
+  return stats;
+}
+
+bool MemoryBudget::FitsLocked(size_t size) const {
+  return used_ == 0 || size <= limit_ - std::min(used_, limit_);
+}
+
+void MemoryBudget::TakeLocked(size_t size) {
+  used_ += size;
+  peak_ = std::max(peak_, used_);
+}
@@ -0,0 +1,65 @@
+#ifndef AKAMA_SDK_SAMPLE_DEMO_CRONET_MEMORY_BUDGET_H_
+#define AKAMA_SDK_SAMPLE_DEMO_CRONET_MEMORY_BUDGET_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+
+// Bytes of response data the requests of a process may hold at once, shared
+// by all of them so memory stays bounded under a burst of requests. A request
+// that doesn't fit waits in line and is called back once enough is released.
+class MemoryBudget {
+ public:
+  // Called, without locks held, once |size| bytes are granted.
+  using GrantedCallback = std::function<void()>;
+
+  struct Stats {
+    size_t limit = 0;
+    size_t used = 0;
+    size_t peak = 0;
+    // Acquisitions that had to wait.
+    uint64_t waits = 0;
+    size_t waiting = 0;
+  };
+
+  explicit MemoryBudget(size_t limit);
+  MemoryBudget(const MemoryBudget&) = delete;
+  MemoryBudget& operator=(const MemoryBudget&) = delete;
+  // The callbacks still waiting are dropped.
+  ~MemoryBudget();
+
+  // Takes |size| bytes if they fit and returns true. Otherwise returns false
+  // and runs |granted| once they were taken for the caller, in FIFO order. A
+  // request larger than the limit is granted when nothing else is used.
+  bool Acquire(size_t size, GrantedCallback granted);
+  // Takes |size| bytes even if that exceeds the limit, for data that is
+  // already there.
+  void ForceAcquire(size_t size);
+  // Returns bytes and grants waiting requests that fit now.
+  void Release(size_t size);
+
+  Stats GetStats() const;
+
+ private:
+  struct Waiter {
+    size_t size;
+    GrantedCallback granted;
+  };
+
+  // Must be called with |lock_| held.
+  bool FitsLocked(size_t size) const;
+  void TakeLocked(size_t size);
+
+  const size_t limit_;
+
+  // Synchronise access to the members below.
+  mutable std::mutex lock_;
+  size_t used_ = 0;
+  size_t peak_ = 0;
+  uint64_t waits_ = 0;
+  std::deque<Waiter> waiters_;
+};
+
+#endif  // AKAMA_SDK_SAMPLE_DEMO_CRONET_MEMORY_BUDGET_H_
@@ -0,0 +1,193 @@
+#include "request_coalescer.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cctype>
+
+#include "response_body_sink.h"
+#include "sample_url_request_callback.h"
+#include "work_stealing_executor.h"
+
+namespace {
+
+bool EqualsCaseInsensitive(const std::string& a, const std::string& b) {
+  return a.size() == b.size() &&
+         std::equal(a.begin(), a.end(), b.begin(), [](char x, char y) {
+           return std::tolower(static_cast<unsigned char>(x)) ==
+                  std::tolower(static_cast<unsigned char>(y));
+         });
+}
+
+}  // namespace
+
+// One Cronet request and the callers waiting for its response. Deletes itself
+// through RequestCoalescer::OnFlightDone() once the request is done.
+class RequestCoalescer::Flight {
+ public:
+  Flight(RequestCoalescer* owner,
+         std::string key,
+         ResponseCallback callback)
+      : owner_(owner),
+        key_(std::move(key)),
+        request_(Cronet_UrlRequest_Create()) {
+    callbacks_.push_back(std::move(callback));
+    callback_.set_verbose(false);
+    callback_.set_response_started_callback(
+        [this](Cronet_UrlResponseInfoPtr info) {
+          owner_->OnResponseStarted(this);
+        });
+    callback_.set_done_callback(
+        [this](bool success) { owner_->OnFlightDone(this, success); });
+  }
+  Flight(const Flight&) = delete;
+  Flight& operator=(const Flight&) = delete;
+  ~Flight() { Cronet_UrlRequest_Destroy(request_); }
+
+  void Start(Cronet_EnginePtr engine,
+             Cronet_ExecutorPtr executor,
+             const std::string& url,
+             const RequestHeaders& headers) {
+    Cronet_UrlRequestParamsPtr request_params =
+        Cronet_UrlRequestParams_Create();
+    Cronet_UrlRequestParams_http_method_set(request_params, "GET");
+    for (const auto& header : headers) {
+      Cronet_HttpHeaderPtr request_header = Cronet_HttpHeader_Create();
+      Cronet_HttpHeader_name_set(request_header, header.first.c_str());
+      Cronet_HttpHeader_value_set(request_header, header.second.c_str());
+      Cronet_UrlRequestParams_request_headers_add(request_params,
+                                                  request_header);
+      Cronet_HttpHeader_Destroy(request_header);
+    }
+    Cronet_UrlRequest_InitWithParams(request_, engine, url.c_str(),
+                                     request_params,
+                                     callback_.GetUrlRequestCallback(),
+                                     executor);
+    Cronet_UrlRequestParams_Destroy(request_params);
+    Cronet_UrlRequest_Start(request_);
+  }
+
+  void Cancel() { Cronet_UrlRequest_Cancel(request_); }
+
+  std::shared_ptr<const Response> TakeResponse(bool success) {
+    auto response = std::make_shared<Response>();
+    response->success = success;
+    response->http_status_code = callback_.http_status_code();
+    response->error_message = callback_.last_error_message();
+    response->headers = callback_.response_headers();
+    // Joined when the request was done.
+    response->body = callback_.TakeResponseBody();
+    assert(response->body->is_contiguous());
+    return response;
+  }
+
+  const std::string& key() const { return key_; }
+  // Accessed with the lock of |owner_| held.
+  std::vector<ResponseCallback>& callbacks() { return callbacks_; }
+  bool headers_received = false;
+
+ private:
+  RequestCoalescer* const owner_;
+  const std::string key_;
+  std::vector<ResponseCallback> callbacks_;
+  SampleUrlRequestCallback callback_;
+  Cronet_UrlRequestPtr const request_;
+};
+
+RequestCoalescer::Options::Options() = default;
+RequestCoalescer::Options::Options(const Options&) = default;
+RequestCoalescer::Options::~Options() = default;
+
+RequestCoalescer::RequestCoalescer(Cronet_EnginePtr engine,
+                                   WorkStealingExecutor* executor,
+                                   Options options)
+    : engine_(engine), executor_(executor), options_(std::move(options)) {}
+
+RequestCoalescer::~RequestCoalescer() {
+  std::unique_lock<std::mutex> lock(lock_);
+  canceled_ = true;
+  for (Flight* flight : flights_)
+    flight->Cancel();
+  flights_done_.wait(
+      lock, [this] { return flights_.empty() && num_delivering_ == 0; });
+}
+
+void RequestCoalescer::Get(const std::string& url,
+                           const RequestHeaders& headers,
+                           ResponseCallback callback) {
+  std::string key = GetKey(url, headers);
+  Flight* flight;
+  {
+    std::lock_guard<std::mutex> lock(lock_);
+    ++stats_.requests;
+    auto it = joinable_.find(key);
+    if (it != joinable_.end()) {
+      if (!it->second->headers_received || options_.allow_late_join) {
+        it->second->callbacks().push_back(std::move(callback));
+        ++stats_.coalesced;
+        return;
+      }
+      ++stats_.late_joins_refused;
+    }
+    ++stats_.flights;
+    flight = new Flight(this, key, std::move(callback));
+    joinable_[key] = flight;
+    flights_.push_back(flight);
+  }
+  flight->Start(engine_, executor_->GetExecutor(), url, headers);
+
+  // The destructor may have run Cancel() before the request was started.
+  std::lock_guard<std::mutex> lock(lock_);
+  if (canceled_ &&
+      std::find(flights_.begin(), flights_.end(), flight) != flights_.end()) {
+    flight->Cancel();
+  }
+}
+
+RequestCoalescer::Stats RequestCoalescer::GetStats() const {
+  std::lock_guard<std::mutex> lock(lock_);
+  return stats_;
+}
+
+std::string RequestCoalescer::GetKey(const std::string& url,
+                                     const RequestHeaders& headers) const {
+  std::string key = url;
+  for (const std::string& name : options_.key_headers) {
+    key += '\n';
+    for (const auto& header : headers) {
+      if (EqualsCaseInsensitive(header.first, name)) {
+        // Marks the header as present, even with an empty value.
+        key += ':';
+        key += header.second;
+        break;
+      }
+    }
+  }
+  return key;
+}
+
+void RequestCoalescer::OnResponseStarted(Flight* flight) {
+  std::lock_guard<std::mutex> lock(lock_);
+  flight->headers_received = true;
+}
+
+void RequestCoalescer::OnFlightDone(Flight* flight, bool success) {
+  std::shared_ptr<const Response> response = flight->TakeResponse(success);
+  std::vector<ResponseCallback> callbacks;
+  {
+    std::lock_guard<std::mutex> lock(lock_);
+    auto it = joinable_.find(flight->key());
+    if (it != joinable_.end() && it->second == flight)
+      joinable_.erase(it);
+    callbacks = std::move(flight->callbacks());
+    flights_.erase(std::find(flights_.begin(), flights_.end(), flight));
+    ++num_delivering_;
+  }
+  delete flight;
+
+  for (const ResponseCallback& callback : callbacks)
+    callback(response);
+
+  std::lock_guard<std::mutex> lock(lock_);
+  if (--num_delivering_ == 0 && flights_.empty())
+    flights_done_.notify_all();
+}
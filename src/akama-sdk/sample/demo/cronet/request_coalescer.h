@@ -0,0 +1,112 @@
+#ifndef AKAMA_SDK_SAMPLE_DEMO_CRONET_REQUEST_COALESCER_H_
+#define AKAMA_SDK_SAMPLE_DEMO_CRONET_REQUEST_COALESCER_H_
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "cronet_c.h"
+#include "response_headers.h"
+
+class ResponseBodySink;
+class WorkStealingExecutor;
+
+// Coalesces concurrent GET requests for the same key into one Cronet request
+// ("single flight"). Every caller attached to a flight receives the same
+// Response object, the body is never copied.
+class RequestCoalescer {
+ public:
+  using RequestHeaders = std::vector<std::pair<std::string, std::string>>;
+
+  struct Options {
+    Options();
+    Options(const Options&);
+    ~Options();
+
+    // Names of request headers that are part of the key besides the URL,
+    // compared case-insensitively. A missing header and one with an empty
+    // value are different keys. Other headers of a joining request are
+    // ignored, the flight is sent with the headers of its first request.
+    std::vector<std::string> key_headers;
+    // Whether a request may still join a flight whose response headers have
+    // arrived. Joining late saves a request, but the joiner gets a response
+    // that was generated before it asked.
+    bool allow_late_join = true;
+  };
+
+  struct Response {
+    bool success = false;
+    int http_status_code = 0;
+    std::string error_message;
+    ResponseHeaders headers;
+    // Never null. Joined before it is handed out, so the callbacks may read
+    // it concurrently.
+    std::shared_ptr<const ResponseBodySink> body;
+  };
+  // Invoked on one of the executor threads once the flight is done.
+  using ResponseCallback =
+      std::function<void(std::shared_ptr<const Response> response)>;
+
+  struct Stats {
+    // Calls to Get().
+    uint64_t requests = 0;
+    // Cronet requests sent.
+    uint64_t flights = 0;
+    // Requests that joined a flight instead of being sent, i.e. saved.
+    uint64_t coalesced = 0;
+    // Requests that found a flight with headers received but could not join
+    // it because late joins are disabled.
+    uint64_t late_joins_refused = 0;
+  };
+
+  RequestCoalescer(Cronet_EnginePtr engine,
+                   WorkStealingExecutor* executor,
+                   Options options = Options());
+  RequestCoalescer(const RequestCoalescer&) = delete;
+  RequestCoalescer& operator=(const RequestCoalescer&) = delete;
+  // Cancels the flights in progress and waits for them.
+  ~RequestCoalescer();
+
+  // GETs |url| with |headers|, joining a flight for the same key if there is
+  // one.
+  void Get(const std::string& url,
+           const RequestHeaders& headers,
+           ResponseCallback callback);
+
+  Stats GetStats() const;
+
+ private:
+  class Flight;
+
+  std::string GetKey(const std::string& url,
+                     const RequestHeaders& headers) const;
+  // Called from |flight| callbacks.
+  void OnResponseStarted(Flight* flight);
+  void OnFlightDone(Flight* flight, bool success);
+
+  Cronet_EnginePtr const engine_;
+  WorkStealingExecutor* const executor_;
+  const Options options_;
+
+  // Synchronise access to the members below.
+  mutable std::mutex lock_;
+  // Flights new requests may join, by key.
+  std::unordered_map<std::string, Flight*> joinable_;
+  // All flights in progress.
+  std::vector<Flight*> flights_;
+  Stats stats_;
+  // Flights whose callbacks are being run.
+  size_t num_delivering_ = 0;
+  bool canceled_ = false;
+  // Notified when |flights_| becomes empty and no callback is running.
+  std::condition_variable flights_done_;
+};
+
+#endif  // AKAMA_SDK_SAMPLE_DEMO_CRONET_REQUEST_COALESCER_H_
@@ -0,0 +1,400 @@
+#include "request_metrics.h"
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <sstream>
+
+#include "base/bits.h"
+
+namespace {
+
+int64_t GetTime(Cronet_DateTimePtr date_time) {
+  return date_time ? Cronet_DateTime_value_get(date_time) : -1;
+}
+
+void RecordDuration(LogLinearHistogram& histogram,
+                    int64_t start,
+                    int64_t end) {
+  if (start >= 0 && end >= start)
+    histogram.Record(static_cast<uint64_t>(end - start));
+}
+
+// Returns "host[:port]" of |url|.
+std::string GetHost(const std::string& url) {
+  size_t begin = url.find("://");
+  begin = begin == std::string::npos ? 0 : begin + 3;
+  size_t end = url.find_first_of("/?#", begin);
+  std::string host = url.substr(begin, end == std::string::npos
+                                           ? std::string::npos
+                                           : end - begin);
+  size_t at = host.rfind('@');
+  return at == std::string::npos ? host : host.substr(at + 1);
+}
+
+// Maps the ALPN of the response to h1, h2 or quic.
+std::string GetProtocol(const std::string& negotiated_protocol) {
+  if (negotiated_protocol.empty() ||
+      negotiated_protocol.compare(0, 5, "http/") == 0) {
+    return "h1";
+  }
+  if (negotiated_protocol == "h2")
+    return "h2";
+  if (negotiated_protocol.compare(0, 2, "h3") == 0 ||
+      negotiated_protocol.find("quic") != std::string::npos) {
+    return "quic";
+  }
+  return negotiated_protocol;
+}
+
+void AppendJsonString(std::ostringstream& out, const std::string& value) {
+  out << '"';
+  for (char c : value) {
+    if (c == '"' || c == '\\')
+      out << '\\';
+    if (static_cast<unsigned char>(c) >= 0x20)
+      out << c;
+  }
+  out << '"';
+}
+
+void AppendJsonHistogram(std::ostringstream& out,
+                         const LogLinearHistogram::Snapshot& snapshot) {
+  out << "{\"count\":" << snapshot.count << ",\"sum\":" << snapshot.sum
+      << ",\"max\":" << snapshot.max << ",\"p50\":" << snapshot.p50
+      << ",\"p90\":" << snapshot.p90 << ",\"p99\":" << snapshot.p99 << '}';
+}
+
+}  // namespace
+
+LogLinearHistogram::LogLinearHistogram() {
+  for (std::atomic<uint64_t>& bucket : buckets_)
+    bucket.store(0, std::memory_order_relaxed);
+}
+
+LogLinearHistogram::~LogLinearHistogram() = default;
+
+void LogLinearHistogram::Record(uint64_t value) {
+  value = std::min<uint64_t>(value, (uint64_t{1} << kMaxValueBits) - 1);
+  buckets_[GetBucket(value)].fetch_add(1, std::memory_order_relaxed);
+  count_.fetch_add(1, std::memory_order_relaxed);
+  sum_.fetch_add(value, std::memory_order_relaxed);
+  uint64_t max = max_.load(std::memory_order_relaxed);
+  while (value > max &&
+         !max_.compare_exchange_weak(max, value, std::memory_order_relaxed)) {
+  }
+}
+
+LogLinearHistogram::Snapshot LogLinearHistogram::GetSnapshot() const {
+  Snapshot snapshot;
+  Counts counts;
+  snapshot.count = LoadCounts(&counts);
+  snapshot.sum = sum_.load(std::memory_order_relaxed);
+  snapshot.max = max_.load(std::memory_order_relaxed);
+  if (snapshot.count == 0)
+    return snapshot;
+
+  snapshot.p50 = FindPercentile(counts, snapshot.count, snapshot.max, 50);
+  snapshot.p90 = FindPercentile(counts, snapshot.count, snapshot.max, 90);
+  snapshot.p99 = FindPercentile(counts, snapshot.count, snapshot.max, 99);
+  return snapshot;
+}
+
+uint64_t LogLinearHistogram::GetPercentile(double percentile) const {
+  Counts counts;
+  const uint64_t count = LoadCounts(&counts);
+  if (count == 0)
+    return 0;
+  return FindPercentile(counts, count, max_.load(std::memory_order_relaxed),
+                        percentile);
+}
+
+uint64_t LogLinearHistogram::LoadCounts(Counts* counts) const {
+  uint64_t count = 0;
+  for (size_t i = 0; i < kNumBuckets; ++i) {
+    (*counts)[i] = buckets_[i].load(std::memory_order_relaxed);
+    count += (*counts)[i];
+  }
+  return count;
+}
+
+/* static */
+uint64_t LogLinearHistogram::FindPercentile(const Counts& counts,
+                                            uint64_t count,
+                                            uint64_t max,
+                                            double percentile) {
+  // Rank of the percentile, rounded up.
+  const uint64_t rank = std::max<uint64_t>(
+      1, static_cast<uint64_t>(std::ceil(count * percentile / 100)));
+  uint64_t seen = 0;
+  for (size_t i = 0; i < kNumBuckets; ++i) {
+    seen += counts[i];
+    if (seen >= rank)
+      return std::min(GetBucketUpperBound(i), max);
+  }
+  return max;
+}
+
+/* static */
+size_t LogLinearHistogram::GetBucket(uint64_t value) {
+  if (value < (uint64_t{1} << kSubBucketBits))
+    return static_cast<size_t>(value);
+  // Log2Floor() takes 32 bits, values go up to |kMaxValueBits|.
+  int exponent = (value >> 32)
+                     ? 32 + base::bits::Log2Floor(
+                                static_cast<uint32_t>(value >> 32))
+                     : base::bits::Log2Floor(static_cast<uint32_t>(value));
+  int shift = exponent - kSubBucketBits;
+  size_t sub_bucket = (value >> shift) & ((1 << kSubBucketBits) - 1);
+  return (static_cast<size_t>(shift + 1) << kSubBucketBits) + sub_bucket;
+}
+
+/* static */
+uint64_t LogLinearHistogram::GetBucketUpperBound(size_t bucket) {
+  if (bucket < (size_t{1} << kSubBucketBits))
+    return bucket;
+  int shift = static_cast<int>(bucket >> kSubBucketBits) - 1;
+  uint64_t sub_bucket = bucket & ((1 << kSubBucketBits) - 1);
+  uint64_t lower = ((uint64_t{1} << kSubBucketBits) + sub_bucket) << shift;
+  return lower + (uint64_t{1} << shift) - 1;
+}
+
+struct RequestMetricsCollector::Entry {
+  Entry(std::string host, std::string protocol)
+      : host(std::move(host)), protocol(std::move(protocol)) {}
+
+  const std::string host;
+  const std::string protocol;
+  std::atomic<uint64_t> requests{0};
+  std::atomic<uint64_t> failed{0};
+  std::atomic<uint64_t> canceled{0};
+  std::atomic<uint64_t> socket_reused{0};
+  std::array<LogLinearHistogram, kNumPhases> phases_ms;
+  LogLinearHistogram sent_bytes;
+  LogLinearHistogram received_bytes;
+};
+
+RequestMetricsCollector::Snapshot::Snapshot() = default;
+RequestMetricsCollector::Snapshot::Snapshot(const Snapshot&) = default;
+RequestMetricsCollector::Snapshot::~Snapshot() = default;
+
+RequestMetricsCollector::RequestMetricsCollector()
+    : listener_(Cronet_RequestFinishedInfoListener_CreateWith(
+          RequestMetricsCollector::OnRequestFinished)),
+      executor_(Cronet_Executor_CreateWith(
+          RequestMetricsCollector::ExecuteDirectly)),
+      other_(std::make_unique<Entry>("other", "other")) {
+  Cronet_RequestFinishedInfoListener_SetClientContext(listener_, this);
+  for (std::atomic<Entry*>& entry : entries_)
+    entry.store(nullptr, std::memory_order_relaxed);
+}
+
+RequestMetricsCollector::~RequestMetricsCollector() {
+  Detach();
+  Cronet_RequestFinishedInfoListener_Destroy(listener_);
+  Cronet_Executor_Destroy(executor_);
+  for (std::atomic<Entry*>& entry : entries_)
+    delete entry.load(std::memory_order_acquire);
+}
+
+void RequestMetricsCollector::Attach(Cronet_EnginePtr engine) {
+  Detach();
+  engine_ = engine;
+  Cronet_Engine_AddRequestFinishedListener(engine_, listener_, executor_);
+}
+
+void RequestMetricsCollector::Detach() {
+  if (!engine_)
+    return;
+  Cronet_Engine_RemoveRequestFinishedListener(engine_, listener_);
+  engine_ = nullptr;
+}
+
+/* static */
+const char* RequestMetricsCollector::GetPhaseName(Phase phase) {
+  switch (phase) {
+    case kDns:
+      return "dns";
+    case kConnect:
+      return "connect";
+    case kSsl:
+      return "ssl";
+    case kSend:
+      return "send";
+    case kTimeToFirstByte:
+      return "ttfb";
+    case kBody:
+      return "body";
+    case kTotal:
+      return "total";
+    case kNumPhases:
+      break;
+  }
+  return "unknown";
+}
+
+std::vector<RequestMetricsCollector::Snapshot>
+RequestMetricsCollector::GetSnapshot() const {
+  std::vector<Snapshot> snapshots;
+  auto add_snapshot = [&snapshots](const Entry& entry) {
+    Snapshot snapshot;
+    snapshot.host = entry.host;
+    snapshot.protocol = entry.protocol;
+    snapshot.requests = entry.requests.load(std::memory_order_relaxed);
+    if (snapshot.requests == 0)
+      return;
+    snapshot.failed = entry.failed.load(std::memory_order_relaxed);
+    snapshot.canceled = entry.canceled.load(std::memory_order_relaxed);
+    snapshot.socket_reused =
+        entry.socket_reused.load(std::memory_order_relaxed);
+    for (int i = 0; i < kNumPhases; ++i)
+      snapshot.phases_ms[i] = entry.phases_ms[i].GetSnapshot();
+    snapshot.sent_bytes = entry.sent_bytes.GetSnapshot();
+    snapshot.received_bytes = entry.received_bytes.GetSnapshot();
+    snapshots.push_back(std::move(snapshot));
+  };
+  for (const std::atomic<Entry*>& slot : entries_) {
+    if (const Entry* entry = slot.load(std::memory_order_acquire))
+      add_snapshot(*entry);
+  }
+  add_snapshot(*other_);
+  return snapshots;
+}
+
+std::string RequestMetricsCollector::GetSnapshotAsJson() const {
+  std::ostringstream out;
+  out << '[';
+  bool first = true;
+  for (const Snapshot& snapshot : GetSnapshot()) {
+    if (!first)
+      out << ',';
+    first = false;
+    out << "{\"host\":";
+    AppendJsonString(out, snapshot.host);
+    out << ",\"protocol\":";
+    AppendJsonString(out, snapshot.protocol);
+    out << ",\"requests\":" << snapshot.requests
+        << ",\"failed\":" << snapshot.failed
+        << ",\"canceled\":" << snapshot.canceled
+        << ",\"socket_reused\":" << snapshot.socket_reused
+        << ",\"phases_ms\":{";
+    for (int i = 0; i < kNumPhases; ++i) {
+      if (i)
+        out << ',';
+      out << '"' << GetPhaseName(static_cast<Phase>(i)) << "\":";
+      AppendJsonHistogram(out, snapshot.phases_ms[i]);
+    }
+    out << "},\"sent_bytes\":";
+    AppendJsonHistogram(out, snapshot.sent_bytes);
+    out << ",\"received_bytes\":";
+    AppendJsonHistogram(out, snapshot.received_bytes);
+    out << '}';
+  }
+  out << ']';
+  return out.str();
+}
+
+/* static */
+void RequestMetricsCollector::OnRequestFinished(
+    Cronet_RequestFinishedInfoListenerPtr self,
+    Cronet_RequestFinishedInfoPtr request_info,
+    Cronet_UrlResponseInfoPtr response_info,
+    Cronet_ErrorPtr error) {
+  static_cast<RequestMetricsCollector*>(
+      Cronet_RequestFinishedInfoListener_GetClientContext(self))
+      ->Record(request_info, response_info);
+}
+
+/* static */
+void RequestMetricsCollector::ExecuteDirectly(Cronet_ExecutorPtr self,
+                                              Cronet_RunnablePtr runnable) {
+  // Recording is cheap and lock-free, so it runs on the network thread
+  // instead of a thread hop per request.
+  Cronet_Runnable_Run(runnable);
+  Cronet_Runnable_Destroy(runnable);
+}
+
+void RequestMetricsCollector::Record(
+    Cronet_RequestFinishedInfoPtr request_info,
+    Cronet_UrlResponseInfoPtr response_info) {
+  std::string host = "unknown";
+  std::string protocol = "unknown";
+  if (response_info) {
+    host = GetHost(Cronet_UrlResponseInfo_url_get(response_info));
+    protocol = GetProtocol(
+        Cronet_UrlResponseInfo_negotiated_protocol_get(response_info));
+  }
+  Entry* entry = GetEntry(host, protocol);
+  entry->requests.fetch_add(1, std::memory_order_relaxed);
+  switch (Cronet_RequestFinishedInfo_finished_reason_get(request_info)) {
+    case Cronet_RequestFinishedInfo_FINISHED_REASON_FAILED:
+      entry->failed.fetch_add(1, std::memory_order_relaxed);
+      break;
+    case Cronet_RequestFinishedInfo_FINISHED_REASON_CANCELED:
+      entry->canceled.fetch_add(1, std::memory_order_relaxed);
+      break;
+    default:
+      break;
+  }
+
+  Cronet_MetricsPtr metrics =
+      Cronet_RequestFinishedInfo_metrics_get(request_info);
+  if (!metrics)
+    return;
+  if (Cronet_Metrics_socket_reused_get(metrics))
+    entry->socket_reused.fetch_add(1, std::memory_order_relaxed);
+
+  const int64_t request_start =
+      GetTime(Cronet_Metrics_request_start_get(metrics));
+  const int64_t response_start =
+      GetTime(Cronet_Metrics_response_start_get(metrics));
+  const int64_t request_end = GetTime(Cronet_Metrics_request_end_get(metrics));
+  RecordDuration(entry->phases_ms[kDns],
+                 GetTime(Cronet_Metrics_dns_start_get(metrics)),
+                 GetTime(Cronet_Metrics_dns_end_get(metrics)));
+  RecordDuration(entry->phases_ms[kConnect],
+                 GetTime(Cronet_Metrics_connect_start_get(metrics)),
+                 GetTime(Cronet_Metrics_connect_end_get(metrics)));
+  RecordDuration(entry->phases_ms[kSsl],
+                 GetTime(Cronet_Metrics_ssl_start_get(metrics)),
+                 GetTime(Cronet_Metrics_ssl_end_get(metrics)));
+  RecordDuration(entry->phases_ms[kSend],
+                 GetTime(Cronet_Metrics_sending_start_get(metrics)),
+                 GetTime(Cronet_Metrics_sending_end_get(metrics)));
+  RecordDuration(entry->phases_ms[kTimeToFirstByte], request_start,
+                 response_start);
+  RecordDuration(entry->phases_ms[kBody], response_start, request_end);
+  RecordDuration(entry->phases_ms[kTotal], request_start, request_end);
+
+  int64_t sent_bytes = Cronet_Metrics_sent_byte_count_get(metrics);
+  if (sent_bytes >= 0)
+    entry->sent_bytes.Record(static_cast<uint64_t>(sent_bytes));
+  int64_t received_bytes = Cronet_Metrics_received_byte_count_get(metrics);
+  if (received_bytes >= 0)
+    entry->received_bytes.Record(static_cast<uint64_t>(received_bytes));
+}
+
+RequestMetricsCollector::Entry* RequestMetricsCollector::GetEntry(
+    const std::string& host,
+    const std::string& protocol) {
+  size_t hash = std::hash<std::string>()(host) * 31 +
+                std::hash<std::string>()(protocol);
+  std::unique_ptr<Entry> new_entry;
+  for (size_t probe = 0; probe < kMaxEntries; ++probe) {
+    std::atomic<Entry*>& slot = entries_[(hash + probe) % kMaxEntries];
+    Entry* entry = slot.load(std::memory_order_acquire);
+    if (!entry) {
+      if (!new_entry)
+        new_entry = std::make_unique<Entry>(host, protocol);
+      if (slot.compare_exchange_strong(entry, new_entry.get(),
+                                       std::memory_order_acq_rel,
+                                       std::memory_order_acquire)) {
+        return new_entry.release();
+      }
+      // Another thread filled the slot, |entry| is its value now.
+    }
+    if (entry->host == host && entry->protocol == protocol)
+      return entry;
+  }
+  return other_.get();
+}
@@ -0,0 +1,150 @@
+#ifndef AKAMA_SDK_SAMPLE_DEMO_CRONET_REQUEST_METRICS_H_
+#define AKAMA_SDK_SAMPLE_DEMO_CRONET_REQUEST_METRICS_H_
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "cronet_c.h"
+
+// Histogram of non-negative values with log-linear buckets: every power of
+// two is split into 8 linear buckets, so a value is known to within 12.5%.
+// Recording is a few relaxed atomic increments and never blocks.
+class LogLinearHistogram {
+ public:
+  struct Snapshot {
+    uint64_t count = 0;
+    uint64_t sum = 0;
+    uint64_t max = 0;
+    // Upper bound of the bucket holding the percentile.
+    uint64_t p50 = 0;
+    uint64_t p90 = 0;
+    uint64_t p99 = 0;
+  };
+
+  LogLinearHistogram();
+  LogLinearHistogram(const LogLinearHistogram&) = delete;
+  LogLinearHistogram& operator=(const LogLinearHistogram&) = delete;
+  ~LogLinearHistogram();
+
+  // Values above 2^40 are recorded as 2^40.
+  void Record(uint64_t value);
+
+  // Values recorded concurrently may be partially included.
+  Snapshot GetSnapshot() const;
+  // Upper bound of the bucket holding |percentile|, in (0, 100]. 0 if
+  // nothing was recorded.
+  uint64_t GetPercentile(double percentile) const;
+
+ private:
+  static constexpr int kSubBucketBits = 3;
+  static constexpr int kMaxValueBits = 40;
+  static constexpr size_t kNumBuckets =
+      (kMaxValueBits - kSubBucketBits + 1) << kSubBucketBits;
+
+  using Counts = std::array<uint64_t, kNumBuckets>;
+
+  // Loads the count of every bucket into |counts| and returns their sum.
+  uint64_t LoadCounts(Counts* counts) const;
+  // Upper bound of the bucket holding |percentile| of the |count| values in
+  // |counts|, at most |max|. |count| must not be zero.
+  static uint64_t FindPercentile(const Counts& counts,
+                                 uint64_t count,
+                                 uint64_t max,
+                                 double percentile);
+  static size_t GetBucket(uint64_t value);
+  static uint64_t GetBucketUpperBound(size_t bucket);
+
+  std::array<std::atomic<uint64_t>, kNumBuckets> buckets_;
+  std::atomic<uint64_t> count_{0};
+  std::atomic<uint64_t> sum_{0};
+  std::atomic<uint64_t> max_{0};
+};
+
+// Collects the Cronet_Metrics of every finished request of an engine into
+// histograms per host and negotiated protocol (h1, h2, quic). Recording runs
+// directly on the network thread and takes no lock, so it can stay enabled.
+class RequestMetricsCollector {
+ public:
+  enum Phase {
+    kDns,
+    kConnect,
+    kSsl,
+    kSend,
+    // From the request start to the response headers.
+    kTimeToFirstByte,
+    // From the response headers to the end of the body.
+    kBody,
+    kTotal,
+    kNumPhases,
+  };
+
+  struct Snapshot {
+    Snapshot();
+    Snapshot(const Snapshot&);
+    ~Snapshot();
+
+    std::string host;
+    std::string protocol;
+    uint64_t requests = 0;
+    uint64_t failed = 0;
+    uint64_t canceled = 0;
+    uint64_t socket_reused = 0;
+    // Durations in milliseconds, indexed by Phase. Phases that did not
+    // happen, e.g. DNS on a reused socket, are not recorded.
+    std::array<LogLinearHistogram::Snapshot, kNumPhases> phases_ms;
+    LogLinearHistogram::Snapshot sent_bytes;
+    LogLinearHistogram::Snapshot received_bytes;
+  };
+
+  // Number of host and protocol pairs tracked separately. Further pairs are
+  // recorded under the host "other".
+  static constexpr size_t kMaxEntries = 128;
+
+  RequestMetricsCollector();
+  RequestMetricsCollector(const RequestMetricsCollector&) = delete;
+  RequestMetricsCollector& operator=(const RequestMetricsCollector&) = delete;
+  // Detaches from the engine if still attached.
+  ~RequestMetricsCollector();
+
+  // Starts collecting the requests of |engine|. Only one engine at a time.
+  void Attach(Cronet_EnginePtr engine);
+  // Stops collecting. Call when no request is in flight, usually right before
+  // Cronet_Engine_Shutdown().
+  void Detach();
+
+  static const char* GetPhaseName(Phase phase);
+
+  std::vector<Snapshot> GetSnapshot() const;
+  // Returns GetSnapshot() as a JSON array.
+  std::string GetSnapshotAsJson() const;
+
+ private:
+  struct Entry;
+
+  static void OnRequestFinished(Cronet_RequestFinishedInfoListenerPtr self,
+                                Cronet_RequestFinishedInfoPtr request_info,
+                                Cronet_UrlResponseInfoPtr response_info,
+                                Cronet_ErrorPtr error);
+  static void ExecuteDirectly(Cronet_ExecutorPtr self,
+                              Cronet_RunnablePtr runnable);
+
+  void Record(Cronet_RequestFinishedInfoPtr request_info,
+              Cronet_UrlResponseInfoPtr response_info);
+  // Finds or inserts the entry of |host| and |protocol|.
+  Entry* GetEntry(const std::string& host, const std::string& protocol);
+
+  Cronet_RequestFinishedInfoListenerPtr const listener_;
+  Cronet_ExecutorPtr const executor_;
+  Cronet_EnginePtr engine_ = nullptr;
+
+  // Open addressing table, slots are filled once and never cleared.
+  std::array<std::atomic<Entry*>, kMaxEntries> entries_;
+  std::unique_ptr<Entry> other_;
+};
+
+#endif  // AKAMA_SDK_SAMPLE_DEMO_CRONET_REQUEST_METRICS_H_
@@ -0,0 +1,38 @@
+#ifndef AKAMA_SDK_SAMPLE_DEMO_CRONET_RESPONSE_BODY_CONSUMER_H_
+#define AKAMA_SDK_SAMPLE_DEMO_CRONET_RESPONSE_BODY_CONSUMER_H_
+
+#include <cstdint>
+#include <functional>
+
+#include "cronet_c.h"
+
+// Receives the response body of a SampleUrlRequestCallback while it is read,
+// instead of the body being kept in memory. The consumer decides when the next
+// read is issued, so a slow consumer holds back the request instead of letting
+// data pile up.
+class ResponseBodyConsumer {
+ public:
+  // Issues the next read into |buffer|. May be called from any thread, and
+  // must be called exactly once per OnBodyRead(). Passing nullptr cancels the
+  // request instead. Does nothing but destroy |buffer| if the request is
+  // already done.
+  using ReadNext = std::function<void(Cronet_BufferPtr buffer)>;
+
+  virtual ~ResponseBodyConsumer() = default;
+
+  // Called once the response headers are received.
+  virtual void OnResponseStarted(Cronet_UrlResponseInfoPtr info) {}
+
+  // Called with |bytes_read| bytes of body in |buffer|. The consumer owns
+  // |buffer| from now on, and usually hands it back to |read_next| once the
+  // data is consumed.
+  virtual void OnBodyRead(Cronet_BufferPtr buffer,
+                          uint64_t bytes_read,
+                          ReadNext read_next) = 0;
+
+  // Called when the request succeeded, failed or was canceled. A read of the
+  // consumer may still be in progress at this point.
+  virtual void OnBodyComplete(bool success) {}
+};
+
+#endif  // AKAMA_SDK_SAMPLE_DEMO_CRONET_RESPONSE_BODY_CONSUMER_H_
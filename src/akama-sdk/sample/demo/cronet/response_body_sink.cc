@@ -0,0 +1,123 @@
+#include "response_body_sink.h"
+
+#include <algorithm>
+#include <cassert>
+
+#include "buffer_pool.h"
+
+namespace {
+
+void OnWindowDestroyed(Cronet_BufferCallbackPtr self, Cronet_BufferPtr buffer) {
+  // The memory belongs to the reserved block of the sink.
+}
+
+// Buffer callback of the windows into a reserved block. Shared by all sinks
+// and never destroyed.
+Cronet_BufferCallbackPtr GetWindowCallback() {
+  static Cronet_BufferCallbackPtr const callback =
+      Cronet_BufferCallback_CreateWith(OnWindowDestroyed);
+  return callback;
+}
+
+}  // namespace
+
+ResponseBodySink::ResponseBodySink() = default;
+
+ResponseBodySink::~ResponseBodySink() {
+  for (const Segment& segment : segments_)
+    Cronet_Buffer_Destroy(segment.buffer);
+}
+
+void ResponseBodySink::Reserve(size_t size) {
+  assert(size_ == 0 && !reserved_);
+  if (size == 0)
+    return;
+  // Not value-initialized, every byte gets written by a read.
+  reserved_.reset(new char[size]);
+  reserved_size_ = size;
+}
+
+Cronet_BufferPtr ResponseBodySink::PrepareReadBuffer(size_t max_size) {
+  if (reserved_used_ >= reserved_size_)
+    return BufferPool::GetInstance()->Acquire(max_size);
+
+  Cronet_BufferPtr buffer = Cronet_Buffer_Create();
+  size_t window_size = std::min(max_size, reserved_size_ - reserved_used_);
+  Cronet_Buffer_InitWithDataAndCallback(
+      buffer, reserved_.get() + reserved_used_, window_size,
+      GetWindowCallback());
+  reserved_window_ = buffer;
+  return buffer;
+}
+
+void ResponseBodySink::CommitRead(Cronet_BufferPtr buffer, size_t bytes_read) {
+  assert(!is_joined_);
+  size_ += bytes_read;
+
+  if (buffer == reserved_window_) {
+    reserved_used_ += bytes_read;
+    reserved_window_ = nullptr;
+    Cronet_Buffer_Destroy(buffer);
+    return;
+  }
+  if (bytes_read == 0) {
+    Cronet_Buffer_Destroy(buffer);
+    return;
+  }
+  segments_.push_back(
+      {buffer, static_cast<const char*>(Cronet_Buffer_GetData(buffer)),
+       bytes_read});
+}
+
+void ResponseBodySink::Join() {
+  if (is_contiguous())
+    return;
+  joined_.reserve(size_);
+  ForEachSegment(
+      [this](const char* data, size_t size) { joined_.append(data, size); });
+  for (const Segment& segment : segments_)
+    Cronet_Buffer_Destroy(segment.buffer);
+  segments_.clear();
+  reserved_.reset();
+  reserved_size_ = 0;
+  reserved_used_ = 0;
+  is_joined_ = true;
+}
+
+size_t ResponseBodySink::num_segments() const {
+  if (is_joined_)
+    return 1;
+  return (reserved_used_ ? 1 : 0) + segments_.size();
+}
+
+size_t ResponseBodySink::allocated_size() const {
+  if (is_joined_)
+    return joined_.capacity();
+  size_t allocated_size = reserved_size_;
+  for (const Segment& segment : segments_) {
+    allocated_size +=
+        static_cast<size_t>(Cronet_Buffer_GetSize(segment.buffer));
+  }
+  return allocated_size;
+}
+
+void ResponseBodySink::ForEachSegment(
+    const std::function<void(const char* data, size_t size)>& visitor) const {
+  if (is_joined_) {
+    visitor(joined_.data(), joined_.size());
+    return;
+  }
+  if (reserved_used_)
+    visitor(reserved_.get(), reserved_used_);
+  for (const Segment& segment : segments_)
+    visitor(segment.data, segment.size);
+}
+
+std::string_view ResponseBodySink::AsStringView() const {
+  assert(is_contiguous());
+  if (is_joined_)
+    return joined_;
+  if (segments_.empty())
+    return std::string_view(reserved_.get(), reserved_used_);
+  return std::string_view(segments_[0].data, segments_[0].size);
+}
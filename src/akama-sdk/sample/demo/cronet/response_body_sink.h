@@ -0,0 +1,88 @@
+#ifndef AKAMA_SDK_SAMPLE_DEMO_CRONET_RESPONSE_BODY_SINK_H_
+#define AKAMA_SDK_SAMPLE_DEMO_CRONET_RESPONSE_BODY_SINK_H_
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "cronet_c.h"
+
+// Response body made of the buffers it was read into.
+//
+// Completed reads are never copied: the buffer a read completed into is taken
+// over by the sink as a segment and the next read gets a new buffer. When the
+// body size is known up front, Reserve() allocates a single block and reads go
+// straight into consecutive parts of it, so the body ends up contiguous.
+// Bodies larger than the reservation continue in separate segments, backed by
+// blocks borrowed from BufferPool until the sink is destroyed or joined.
+//
+// Once the last read completed, Join() copies a body that is split into
+// several segments into one block. A joined sink is never modified again, so
+// it may be shared and read from any number of threads.
+class ResponseBodySink {
+ public:
+  ResponseBodySink();
+  ResponseBodySink(const ResponseBodySink&) = delete;
+  ResponseBodySink& operator=(const ResponseBodySink&) = delete;
+  ~ResponseBodySink();
+
+  // Reserves a contiguous block for the first |size| bytes of the body. Must
+  // be called before the first read.
+  void Reserve(size_t size);
+
+  // Returns a buffer for the next read of about |max_size| bytes.
+  Cronet_BufferPtr PrepareReadBuffer(size_t max_size);
+  // Takes over |buffer| after a read of |bytes_read| bytes completed into it.
+  void CommitRead(Cronet_BufferPtr buffer, size_t bytes_read);
+  // Joins the segments into one block and releases them. Must be called after
+  // the last read, before the sink is shared. Does nothing if the body is
+  // already contiguous.
+  void Join();
+
+  size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+  size_t num_segments() const;
+  // True if the body is in one piece, i.e. AsStringView() may be called.
+  bool is_contiguous() const { return num_segments() <= 1; }
+  // Bytes of memory held by the body, including the unused parts of its
+  // blocks and the joined copy made by AsStringView().
+  size_t allocated_size() const;
+
+  // Calls |visitor| for every segment of the body in order.
+  void ForEachSegment(
+      const std::function<void(const char* data, size_t size)>& visitor) const;
+
+  // Returns the whole body as one contiguous view. A body that is split into
+  // several segments must be joined first. The view is valid until the next
+  // read is committed or |this| is destroyed.
+  std::string_view AsStringView() const;
+  std::string ToString() const { return std::string(AsStringView()); }
+
+ private:
+  struct Segment {
+    // Owned buffer holding the data.
+    Cronet_BufferPtr buffer;
+    const char* data;
+    size_t size;
+  };
+
+  // Block allocated by Reserve() and number of bytes read into it.
+  std::unique_ptr<char[]> reserved_;
+  size_t reserved_size_ = 0;
+  size_t reserved_used_ = 0;
+  // Buffer wrapping the unused part of |reserved_| while a read is pending.
+  Cronet_BufferPtr reserved_window_ = nullptr;
+
+  // Segments read after |reserved_| was full.
+  std::vector<Segment> segments_;
+  size_t size_ = 0;
+
+  // The whole body once Join() copied it out of the segments.
+  std::string joined_;
+  bool is_joined_ = false;
+};
+
+#endif  // AKAMA_SDK_SAMPLE_DEMO_CRONET_RESPONSE_BODY_SINK_H_
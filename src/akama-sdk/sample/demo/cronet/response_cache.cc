@@ -0,0 +1,241 @@
+#include "response_cache.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cctype>
+#include <cstdlib>
+#include <functional>
+#include <utility>
+
+#include "response_body_sink.h"
+
+namespace {
+
+struct CacheControl {
+  bool no_store = false;
+  // Seconds the response stays fresh, 0 if it must always be revalidated.
+  int64_t max_age = 0;
+};
+
+std::string ToLower(std::string value) {
+  std::transform(value.begin(), value.end(), value.begin(), [](char c) {
+    return static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+  });
+  return value;
+}
+
+std::string TrimWhitespace(const std::string& value) {
+  size_t begin = value.find_first_not_of(" \t");
+  if (begin == std::string::npos)
+    return std::string();
+  size_t end = value.find_last_not_of(" \t");
+  return value.substr(begin, end - begin + 1);
+}
+
+// Parses the directives of Cache-Control that matter to a private cache.
+// Expires and heuristic freshness are not supported, such responses are
+// always revalidated.
+CacheControl ParseCacheControl(const ResponseHeaders& headers) {
+  CacheControl cache_control;
+  std::string value;
+  if (!FindResponseHeader(headers, "Cache-Control", &value))
+    return cache_control;
+
+  bool no_cache = false;
+  size_t begin = 0;
+  while (begin <= value.size()) {
+    size_t end = value.find(',', begin);
+    if (end == std::string::npos)
+      end = value.size();
+    std::string directive =
+        ToLower(TrimWhitespace(value.substr(begin, end - begin)));
+    if (directive == "no-store") {
+      cache_control.no_store = true;
+    } else if (directive == "no-cache") {
+      no_cache = true;
+    } else if (directive.compare(0, 8, "max-age=") == 0) {
+      char* parse_end = nullptr;
+      long long max_age = std::strtoll(directive.c_str() + 8, &parse_end, 10);
+      if (*parse_end == '\0' && max_age > 0)
+        cache_control.max_age = max_age;
+    }
+    begin = end + 1;
+  }
+  if (no_cache)
+    cache_control.max_age = 0;
+  return cache_control;
+}
+
+void AddRequestHeader(Cronet_UrlRequestParamsPtr request_params,
+                      const char* name,
+                      const std::string& value) {
+  Cronet_HttpHeaderPtr header = Cronet_HttpHeader_Create();
+  Cronet_HttpHeader_name_set(header, name);
+  Cronet_HttpHeader_value_set(header, value.c_str());
+  // The params keep a copy of the header.
+  Cronet_UrlRequestParams_request_headers_add(request_params, header);
+  Cronet_HttpHeader_Destroy(header);
+}
+
+// Charges the memory the joined body holds, not just the bytes read into
+// it.
+size_t GetCharge(const std::string& url,
+                 const ResponseCache::Entry& entry) {
+  size_t charge = url.size() + entry.body->allocated_size();
+  for (const auto& header : entry.headers)
+    charge += header.first.size() + header.second.size();
+  return charge;
+}
+
+}  // namespace
+
+ResponseCache::Entry::Entry() = default;
+ResponseCache::Entry::Entry(const Entry&) = default;
+ResponseCache::Entry::~Entry() = default;
+
+ResponseCache::ResponseCache(size_t max_bytes, size_t num_shards)
+    : max_bytes_(max_bytes),
+      shard_max_bytes_(max_bytes / std::max<size_t>(1, num_shards)) {
+  num_shards = std::max<size_t>(1, num_shards);
+  shards_.reserve(num_shards);
+  for (size_t i = 0; i < num_shards; ++i)
+    shards_.push_back(std::make_unique<Shard>());
+}
+
+ResponseCache::~ResponseCache() = default;
+
+ResponseCache::LookupResult ResponseCache::Lookup(const std::string& url) {
+  LookupResult result;
+  Shard& shard = GetShard(url);
+  std::lock_guard<std::mutex> lock(shard.lock);
+  auto it = shard.index.find(url);
+  if (it == shard.index.end()) {
+    ++shard.stats.misses;
+    return result;
+  }
+
+  shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+  result.entry = it->second->entry;
+  result.fresh = std::chrono::steady_clock::now() < result.entry->fresh_until;
+  if (result.fresh)
+    ++shard.stats.hits;
+  else
+    ++shard.stats.revalidations;
+  return result;
+}
+
+/* static */
+void ResponseCache::AddConditionalHeaders(
+    const Entry& entry,
+    Cronet_UrlRequestParamsPtr request_params) {
+  if (!entry.etag.empty())
+    AddRequestHeader(request_params, "If-None-Match", entry.etag);
+  if (!entry.last_modified.empty())
+    AddRequestHeader(request_params, "If-Modified-Since", entry.last_modified);
+}
+
+std::shared_ptr<const ResponseCache::Entry> ResponseCache::Update(
+    const std::string& url,
+    const std::shared_ptr<const Entry>& stale_entry,
+    int http_status_code,
+    const ResponseHeaders& headers,
+    std::shared_ptr<const ResponseBodySink> body) {
+  assert(body->is_contiguous());
+  CacheControl cache_control = ParseCacheControl(headers);
+  auto fresh_until = std::chrono::steady_clock::now() +
+                     std::chrono::seconds(cache_control.max_age);
+  Shard& shard = GetShard(url);
+
+  if (http_status_code == 304 && stale_entry) {
+    // The body is shared with |stale_entry|, only the metadata is renewed.
+    auto entry = std::make_shared<Entry>(*stale_entry);
+    entry->fresh_until = fresh_until;
+    std::string value;
+    if (FindResponseHeader(headers, "ETag", &value))
+      entry->etag = value;
+    if (FindResponseHeader(headers, "Last-Modified", &value))
+      entry->last_modified = value;
+
+    std::lock_guard<std::mutex> lock(shard.lock);
+    ++shard.stats.hits;
+    if (!cache_control.no_store)
+      Insert(shard, url, entry);
+    return entry;
+  }
+  if (http_status_code != 200)
+    return nullptr;
+
+  auto entry = std::make_shared<Entry>();
+  FindResponseHeader(headers, "ETag", &entry->etag);
+  FindResponseHeader(headers, "Last-Modified", &entry->last_modified);
+  bool cacheable = !cache_control.no_store &&
+                   (cache_control.max_age > 0 || !entry->etag.empty() ||
+                    !entry->last_modified.empty());
+
+  std::lock_guard<std::mutex> lock(shard.lock);
+  if (!cacheable) {
+    // Don't keep serving an entry the server no longer allows to be cached.
+    auto it = shard.index.find(url);
+    if (it != shard.index.end()) {
+      shard.stats.bytes -= it->second->charge;
+      shard.lru.erase(it->second);
+      shard.index.erase(it);
+    }
+    return nullptr;
+  }
+  entry->http_status_code = http_status_code;
+  entry->headers = headers;
+  entry->body = std::move(body);
+  entry->fresh_until = fresh_until;
+  Insert(shard, url, std::move(entry));
+  return nullptr;
+}
+
+void ResponseCache::Clear() {
+  for (const auto& shard : shards_) {
+    std::lock_guard<std::mutex> lock(shard->lock);
+    shard->lru.clear();
+    shard->index.clear();
+    shard->stats.bytes = 0;
+  }
+}
+
+std::vector<ResponseCache::ShardStats> ResponseCache::GetStats() const {
+  std::vector<ShardStats> stats;
+  stats.reserve(shards_.size());
+  for (const auto& shard : shards_) {
+    std::lock_guard<std::mutex> lock(shard->lock);
+    stats.push_back(shard->stats);
+    stats.back().entries = shard->lru.size();
+  }
+  return stats;
+}
+
+ResponseCache::Shard& ResponseCache::GetShard(const std::string& url) {
+  return *shards_[std::hash<std::string>()(url) % shards_.size()];
+}
+
+void ResponseCache::Insert(Shard& shard,
+                           const std::string& url,
+                           std::shared_ptr<const Entry> entry) {
+  size_t charge = GetCharge(url, *entry);
+  auto it = shard.index.find(url);
+  if (it != shard.index.end()) {
+    shard.stats.bytes -= it->second->charge;
+    shard.lru.erase(it->second);
+    shard.index.erase(it);
+  }
+  if (charge > shard_max_bytes_)
+    return;
+
+  shard.lru.push_front({url, std::move(entry), charge});
+  shard.index[url] = shard.lru.begin();
+  shard.stats.bytes += charge;
+  while (shard.stats.bytes > shard_max_bytes_) {
+    const Node& oldest = shard.lru.back();
+    shard.stats.bytes -= oldest.charge;
+    shard.index.erase(oldest.url);
+    shard.lru.pop_back();
+    ++shard.stats.evictions;
+  }
+}
@@ -0,0 +1,130 @@
+#ifndef AKAMA_SDK_SAMPLE_DEMO_CRONET_RESPONSE_CACHE_H_
+#define AKAMA_SDK_SAMPLE_DEMO_CRONET_RESPONSE_CACHE_H_
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "cronet_c.h"
+#include "response_headers.h"
+
+class ResponseBodySink;
+
+// In-process cache of GET responses keyed by URL, in front of the network.
+//
+// A fresh entry (Cache-Control: max-age) is served without a request. A stale
+// entry with an ETag or Last-Modified is revalidated with a conditional
+// request, and a 304 Not Modified reply is served from the cache as well.
+//
+// The cache is split into shards by URL hash, each with its own lock, LRU list
+// and an equal part of the byte budget, so lookups from many executor threads
+// rarely wait for each other.
+class ResponseCache {
+ public:
+  // A cached response. Immutable once stored, its body is joined, so it can
+  // be shared by any number of readers.
+  struct Entry {
+    Entry();
+    Entry(const Entry&);
+    ~Entry();
+
+    int http_status_code = 0;
+    ResponseHeaders headers;
+    // Never null.
+    std::shared_ptr<const ResponseBodySink> body;
+    // Validators sent when revalidating, empty if the response had none.
+    std::string etag;
+    std::string last_modified;
+    // The entry must be revalidated after this point.
+    std::chrono::steady_clock::time_point fresh_until;
+  };
+
+  struct LookupResult {
+    // Null on a miss.
+    std::shared_ptr<const Entry> entry;
+    // True if |entry| may be served without revalidation.
+    bool fresh = false;
+  };
+
+  struct ShardStats {
+    // Responses served from the cache, including revalidated ones.
+    uint64_t hits = 0;
+    // Lookups that found nothing.
+    uint64_t misses = 0;
+    // Lookups that found a stale entry to revalidate.
+    uint64_t revalidations = 0;
+    // Entries dropped to stay within the byte budget.
+    uint64_t evictions = 0;
+    size_t entries = 0;
+    size_t bytes = 0;
+  };
+
+  static constexpr size_t kDefaultNumShards = 16;
+
+  explicit ResponseCache(size_t max_bytes,
+                         size_t num_shards = kDefaultNumShards);
+  ResponseCache(const ResponseCache&) = delete;
+  ResponseCache& operator=(const ResponseCache&) = delete;
+  ~ResponseCache();
+
+  // Looks up |url| and marks the entry as recently used.
+  LookupResult Lookup(const std::string& url);
+
+  // Adds If-None-Match / If-Modified-Since of |entry| to |request_params|.
+  static void AddConditionalHeaders(const Entry& entry,
+                                    Cronet_UrlRequestParamsPtr request_params);
+
+  // Updates the cache with the response to a request for |url| that was sent
+  // after a Lookup() returned |stale_entry| (may be null). Returns the entry
+  // to serve instead of the response: the revalidated |stale_entry| for a
+  // 304, or null if the response is not served from the cache. A cacheable
+  // 200 response is stored, and replaces any previous entry. |body| must be
+  // joined, see ResponseBodySink::Join(), so its charge doesn't change later.
+  std::shared_ptr<const Entry> Update(
+      const std::string& url,
+      const std::shared_ptr<const Entry>& stale_entry,
+      int http_status_code,
+      const ResponseHeaders& headers,
+      std::shared_ptr<const ResponseBodySink> body);
+
+  // Drops all entries. The counters are kept.
+  void Clear();
+
+  std::vector<ShardStats> GetStats() const;
+  size_t max_bytes() const { return max_bytes_; }
+
+ private:
+  struct Node {
+    std::string url;
+    std::shared_ptr<const Entry> entry;
+    size_t charge;
+  };
+
+  struct Shard {
+    mutable std::mutex lock;
+    // Most recently used first.
+    std::list<Node> lru;
+    std::unordered_map<std::string, std::list<Node>::iterator> index;
+    ShardStats stats;
+  };
+
+  Shard& GetShard(const std::string& url);
+  // Inserts or replaces the entry of |url|, then evicts down to the budget.
+  // Must be called with |shard.lock| held.
+  void Insert(Shard& shard,
+              const std::string& url,
+              std::shared_ptr<const Entry> entry);
+
+  const size_t max_bytes_;
+  // Budget of every shard.
+  const size_t shard_max_bytes_;
+  std::vector<std::unique_ptr<Shard>> shards_;
+};
+
+#endif  // AKAMA_SDK_SAMPLE_DEMO_CRONET_RESPONSE_CACHE_H_
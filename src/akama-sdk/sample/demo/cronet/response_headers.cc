@@ -0,0 +1,70 @@
+#include "response_headers.h"
+
+#include <cctype>
+#include <cstdlib>
+
+namespace {
+
+bool EqualsCaseInsensitive(const char* a, const std::string& b) {
+  size_t i = 0;
+  for (; a[i] && i < b.size(); ++i) {
+    if (std::tolower(static_cast<unsigned char>(a[i])) !=
+        std::tolower(static_cast<unsigned char>(b[i]))) {
+      return false;
+    }
+  }
+  return !a[i] && i == b.size();
+}
+
+}  // namespace
+
+ResponseHeaders GetResponseHeaders(Cronet_UrlResponseInfoPtr info) {
+  ResponseHeaders headers;
+  uint32_t count = Cronet_UrlResponseInfo_all_headers_list_size(info);
+  headers.reserve(count);
+  for (uint32_t i = 0; i < count; ++i) {
+    Cronet_HttpHeaderPtr header =
+        Cronet_UrlResponseInfo_all_headers_list_at(info, i);
+    headers.emplace_back(Cronet_HttpHeader_name_get(header),
+                         Cronet_HttpHeader_value_get(header));
+  }
+  return headers;
+}
+
+bool FindResponseHeader(Cronet_UrlResponseInfoPtr info,
+                        const std::string& name,
+                        std::string* value) {
+  uint32_t count = Cronet_UrlResponseInfo_all_headers_list_size(info);
+  for (uint32_t i = 0; i < count; ++i) {
+    Cronet_HttpHeaderPtr header =
+        Cronet_UrlResponseInfo_all_headers_list_at(info, i);
+    if (EqualsCaseInsensitive(Cronet_HttpHeader_name_get(header), name)) {
+      *value = Cronet_HttpHeader_value_get(header);
+      return true;
+    }
+  }
+  return false;
+}
+
+bool FindResponseHeader(const ResponseHeaders& headers,
+                        const std::string& name,
+                        std::string* value) {
+  for (const auto& header : headers) {
+    if (EqualsCaseInsensitive(header.first.c_str(), name)) {
+      *value = header.second;
+      return true;
+    }
+  }
+  return false;
+}
+
+int64_t GetContentLength(Cronet_UrlResponseInfoPtr info) {
+  std::string value;
+  if (!FindResponseHeader(info, "Content-Length", &value) || value.empty())
+    return -1;
+  char* end = nullptr;
+  long long length = std::strtoll(value.c_str(), &end, 10);
+  if (*end != '\0' || length < 0)
+    return -1;
+  return length;
+}
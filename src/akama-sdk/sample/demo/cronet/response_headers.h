@@ -0,0 +1,29 @@
+#ifndef AKAMA_SDK_SAMPLE_DEMO_CRONET_RESPONSE_HEADERS_H_
+#define AKAMA_SDK_SAMPLE_DEMO_CRONET_RESPONSE_HEADERS_H_
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "cronet_c.h"
+
+// Name and value pairs in the order they were received.
+using ResponseHeaders = std::vector<std::pair<std::string, std::string>>;
+
+// Copies all headers of |info|, so they can be used after the callback.
+ResponseHeaders GetResponseHeaders(Cronet_UrlResponseInfoPtr info);
+
+// Finds the first response header named |name|, compared case-insensitively.
+// Returns false if there is none.
+bool FindResponseHeader(Cronet_UrlResponseInfoPtr info,
+                        const std::string& name,
+                        std::string* value);
+bool FindResponseHeader(const ResponseHeaders& headers,
+                        const std::string& name,
+                        std::string* value);
+
+// Returns the Content-Length of the response, or -1 if it is unknown.
+int64_t GetContentLength(Cronet_UrlResponseInfoPtr info);
+
+#endif  // AKAMA_SDK_SAMPLE_DEMO_CRONET_RESPONSE_HEADERS_H_
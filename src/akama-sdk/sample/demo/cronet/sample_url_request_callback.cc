@@ -5,6 +5,45 @@
 #include "sample_url_request_callback.h"
 
 #include <iostream>
+#include <mutex>
+
+#include "response_headers.h"
+
+namespace {
+
+// Bodies up to this size are read into one block reserved from Content-Length.
+constexpr int64_t kMaxReservedBodySize = 64 * 1024 * 1024;
+
+}  // namespace
+
+// Shared with the ReadNext callbacks handed to the body consumer, which may
+// run after the request is done and destroyed.
+class SampleUrlRequestCallback::ReadHandle {
+ public:
+  explicit ReadHandle(Cronet_UrlRequestPtr request) : request_(request) {}
+
+  void Read(Cronet_BufferPtr buffer) {
+    std::lock_guard<std::mutex> lock(lock_);
+    if (!request_) {
+      if (buffer)
+        Cronet_Buffer_Destroy(buffer);
+      return;
+    }
+    if (buffer)
+      Cronet_UrlRequest_Read(request_, buffer);
+    else
+      Cronet_UrlRequest_Cancel(request_);
+  }
+
+  void MarkDone() {
+    std::lock_guard<std::mutex> lock(lock_);
+    request_ = nullptr;
+  }
+
+ private:
+  std::mutex lock_;
+  Cronet_UrlRequestPtr request_;
+};
 
 SampleUrlRequestCallback::SampleUrlRequestCallback()
     : callback_(Cronet_UrlRequestCallback_CreateWith(
@@ -29,22 +68,40 @@ void SampleUrlRequestCallback::OnRedirectReceived(
     Cronet_UrlRequestPtr request,
     Cronet_UrlResponseInfoPtr info,
     Cronet_String newLocationUrl) {
-  std::cout << "OnRedirectReceived called: " << newLocationUrl << std::endl;
+  if (verbose_)
+    std::cout << "OnRedirectReceived called: " << newLocationUrl << std::endl;
   Cronet_UrlRequest_FollowRedirect(request);
 }
 
 void SampleUrlRequestCallback::OnResponseStarted(
     Cronet_UrlRequestPtr request,
     Cronet_UrlResponseInfoPtr info) {
-  std::cout << "OnResponseStarted called." << std::endl;
-  std::cout << "HTTP Status: "
-            << Cronet_UrlResponseInfo_http_status_code_get(info) << " "
-            << Cronet_UrlResponseInfo_http_status_text_get(info) << std::endl;
-  // Create and allocate 32kb buffer.
-  Cronet_BufferPtr buffer = Cronet_Buffer_Create();
-  Cronet_Buffer_InitWithAlloc(buffer, 32 * 1024);
+  http_status_code_ = Cronet_UrlResponseInfo_http_status_code_get(info);
+  was_cached_ = Cronet_UrlResponseInfo_was_cached_get(info);
+  response_headers_ = GetResponseHeaders(info);
+  if (verbose_) {
+    std::cout << "OnResponseStarted called." << std::endl;
+    std::cout << "HTTP Status: " << http_status_code_ << " "
+              << Cronet_UrlResponseInfo_http_status_text_get(info) << std::endl;
+  }
+  if (response_started_callback_)
+    response_started_callback_(info);
+  int64_t content_length = GetContentLength(info);
+  read_size_ = AdaptiveReadSize(content_length);
+  if (body_consumer_) {
+    read_handle_ = std::make_shared<ReadHandle>(request);
+    body_consumer_->OnResponseStarted(info);
+    Cronet_UrlRequest_Read(
+        request, BufferPool::GetInstance()->Acquire(read_size_.size()));
+    return;
+  }
+
+  // Read the whole body into one block if the server told us its size.
+  if (content_length > 0 && content_length <= kMaxReservedBodySize)
+    response_body_->Reserve(static_cast<size_t>(content_length));
   // Started reading the response.
-  Cronet_UrlRequest_Read(request, buffer);
+  Cronet_UrlRequest_Read(request,
+                         response_body_->PrepareReadBuffer(read_size_.size()));
 }
 
 void SampleUrlRequestCallback::OnReadCompleted(Cronet_UrlRequestPtr request,
@@ -53,34 +110,61 @@ void SampleUrlRequestCallback::OnReadCompleted(Cronet_UrlRequestPtr request,
                                                uint64_t bytes_read) {
   // std::cout << "OnReadCompleted called: " << bytes_read << " bytes read."
   //          << std::endl;
-  std::string last_read_data(
-      reinterpret_cast<char*>(Cronet_Buffer_GetData(buffer)), bytes_read);
-  response_as_string_ += last_read_data;
+  read_size_.OnReadCompleted(Cronet_Buffer_GetSize(buffer), bytes_read);
+  if (body_consumer_) {
+    std::shared_ptr<ReadHandle> read_handle = read_handle_;
+    body_consumer_->OnBodyRead(
+        buffer, bytes_read,
+        [read_handle](Cronet_BufferPtr next) { read_handle->Read(next); });
+    return;
+  }
+  // |buffer| becomes part of the body, the next read gets a new one.
+  response_body_->CommitRead(buffer, bytes_read);
   // Continue reading the response.
-  Cronet_UrlRequest_Read(request, buffer);
+  Cronet_UrlRequest_Read(request,
+                         response_body_->PrepareReadBuffer(read_size_.size()));
 }
 
 void SampleUrlRequestCallback::OnSucceeded(Cronet_UrlRequestPtr request,
                                            Cronet_UrlResponseInfoPtr info) {
-  std::cout << "OnSucceeded called." << std::endl;
+  if (verbose_)
+    std::cout << "OnSucceeded called." << std::endl;
   SignalDone(true);
 }
 
 void SampleUrlRequestCallback::OnFailed(Cronet_UrlRequestPtr request,
                                         Cronet_UrlResponseInfoPtr info,
                                         Cronet_ErrorPtr error) {
-  std::cout << "OnFailed called: " << Cronet_Error_message_get(error)
-            << std::endl;
   last_error_message_ = Cronet_Error_message_get(error);
+  if (verbose_)
+    std::cout << "OnFailed called: " << last_error_message_ << std::endl;
   SignalDone(false);
 }
 
 void SampleUrlRequestCallback::OnCanceled(Cronet_UrlRequestPtr request,
                                           Cronet_UrlResponseInfoPtr info) {
-  std::cout << "OnCanceled called." << std::endl;
+  if (verbose_)
+    std::cout << "OnCanceled called." << std::endl;
   SignalDone(false);
 }
 
+void SampleUrlRequestCallback::SignalDone(bool success) {
+  // No more reads, the body may be shared from here on.
+  response_body_->Join();
+  if (body_consumer_) {
+    if (read_handle_)
+      read_handle_->MarkDone();
+    body_consumer_->OnBodyComplete(success);
+  }
+  succeeded_ = success;
+  done_with_success_.set_value(success);
+  if (done_callback_) {
+    // |this| may be destroyed by the callback.
+    DoneCallback done_callback = std::move(done_callback_);
+    done_callback(success);
+  }
+}
+
 /* static */
 SampleUrlRequestCallback* SampleUrlRequestCallback::GetThis(
     Cronet_UrlRequestCallbackPtr self) {
@@ -7,17 +7,31 @@
 
 // Cronet sample is expected to be used outside of Chromium infrastructure,
 // and as such has to rely on STL directly instead of //base alternatives.
+#include <functional>
 #include <future>
 #include <memory>
 #include <string>
+#include <string_view>
 #include <utility>
 
+#include "buffer_pool.h"
 #include "cronet_c.h"
+#include "response_body_consumer.h"
+#include "response_body_sink.h"
+#include "response_headers.h"
 
 // Sample implementation of Cronet_UrlRequestCallback interface using static
 // methods to map C API into instance of C++ class.
 class SampleUrlRequestCallback {
  public:
+  // Invoked on the executor once the request is done. The request and |this|
+  // may be destroyed from within the callback.
+  using DoneCallback = std::function<void(bool success)>;
+  // Invoked on the executor when the response headers arrive, before the body
+  // is read.
+  using ResponseStartedCallback =
+      std::function<void(Cronet_UrlResponseInfoPtr info)>;
+
   SampleUrlRequestCallback();
   ~SampleUrlRequestCallback();
 
@@ -27,10 +41,45 @@ class SampleUrlRequestCallback {
   // Waits until request is done.
   void WaitForDone() { is_done_.wait(); }
 
+  // Sets |done_callback| to be run when the request is done, so the caller
+  // doesn't have to block in WaitForDone().
+  void set_done_callback(DoneCallback done_callback) {
+    done_callback_ = std::move(done_callback);
+  }
+  void set_response_started_callback(ResponseStartedCallback callback) {
+    response_started_callback_ = std::move(callback);
+  }
+  // Streams the body to |consumer| instead of keeping it in response_body().
+  // |consumer| must outlive the request.
+  void set_body_consumer(ResponseBodyConsumer* consumer) {
+    body_consumer_ = consumer;
+  }
+  // Disables printing of the callbacks, e.g. when running many requests.
+  void set_verbose(bool verbose) { verbose_ = verbose; }
+
+  // Returns true if OnSucceeded callback is invoked. Valid once the request
+  // is done.
+  bool succeeded() const { return succeeded_; }
   // Returns error message if OnFailed callback is invoked.
   std::string last_error_message() const { return last_error_message_; }
-  // Returns string representation of the received response.
-  std::string response_as_string() const { return response_as_string_; }
+  // Returns HTTP status code of the response, or 0 if there is none.
+  int http_status_code() const { return http_status_code_; }
+  // Returns true if the response was served from the HTTP cache.
+  bool was_cached() const { return was_cached_; }
+  // Returns the headers of the final response.
+  const ResponseHeaders& response_headers() const { return response_headers_; }
+  // Returns string representation of the received response. The body is
+  // joined into one piece once the request is done.
+  std::string_view response_as_string() const {
+    return response_body_->AsStringView();
+  }
+  const ResponseBodySink& response_body() const { return *response_body_; }
+  // Moves out the received response body, joined and safe to share once the
+  // request is done. An empty body is left in its place, so the accessors
+  // above return nothing afterwards.
+  std::unique_ptr<ResponseBodySink> TakeResponseBody() {
+    return std::exchange(response_body_, std::make_unique<ResponseBodySink>());
+  }
 
  protected:
   void OnRedirectReceived(Cronet_UrlRequestPtr request,
@@ -54,7 +103,10 @@ class SampleUrlRequestCallback {
 
   void OnCanceled(Cronet_UrlRequestPtr request, Cronet_UrlResponseInfoPtr info);
 
-  void SignalDone(bool success) { done_with_success_.set_value(success); }
+  void SignalDone(bool success);
+
+  // Lets |body_consumer_| issue reads until the request is done.
+  class ReadHandle;
 
   static SampleUrlRequestCallback* GetThis(Cronet_UrlRequestCallbackPtr self);
 
@@ -87,14 +139,30 @@ class SampleUrlRequestCallback {
                          Cronet_UrlRequestPtr request,
                          Cronet_UrlResponseInfoPtr info);
 
+  // Set before |done_with_success_|, so it is visible after WaitForDone().
+  bool succeeded_ = false;
   // Error message copied from |error| if OnFailed callback is invoked.
   std::string last_error_message_;
-  // Accumulated string representation of the received response.
-  std::string response_as_string_;
+  // HTTP status code copied from the response info in OnResponseStarted.
+  int http_status_code_ = 0;
+  bool was_cached_ = false;
+  ResponseHeaders response_headers_;
+  // Size of the next read, adapted to the body while it is received.
+  AdaptiveReadSize read_size_;
+  // Receives the body instead of |response_body_| if set.
+  ResponseBodyConsumer* body_consumer_ = nullptr;
+  std::shared_ptr<ReadHandle> read_handle_;
+  // Received response body.
+  std::unique_ptr<ResponseBodySink> response_body_ =
+      std::make_unique<ResponseBodySink>();
   // Promise that is set when request is done.
   std::promise<bool> done_with_success_;
   // Future that is signalled when request is done.
   std::future<bool> is_done_ = done_with_success_.get_future();
+  // Run after |done_with_success_| is set.
+  DoneCallback done_callback_;
+  ResponseStartedCallback response_started_callback_;
+  bool verbose_ = true;
 
   Cronet_UrlRequestCallbackPtr const callback_;
 };
@@ -0,0 +1,49 @@
+#include "task_runner_executor.h"
+
+#include <memory>
+#include <utility>
+
+#include "base/bind.h"
+#include "base/location.h"
+#include "base/task/thread_pool.h"
+
+namespace {
+
+struct RunnableDeleter {
+  void operator()(Cronet_RunnablePtr runnable) const {
+    Cronet_Runnable_Destroy(runnable);
+  }
+};
+
+// Destroys the runnable with the task, whether the task ran or was dropped.
+using ScopedRunnable = std::unique_ptr<Cronet_Runnable, RunnableDeleter>;
+
+void RunRunnable(ScopedRunnable runnable) {
+  Cronet_Runnable_Run(runnable.get());
+}
+
+}  // namespace
+
+TaskRunnerExecutor::TaskRunnerExecutor(
+    scoped_refptr<base::SequencedTaskRunner> task_runner)
+    : task_runner_(std::move(task_runner)),
+      executor_(Cronet_Executor_CreateWith(TaskRunnerExecutor::Execute)) {
+  Cronet_Executor_SetClientContext(executor_, this);
+}
+
+TaskRunnerExecutor::TaskRunnerExecutor(const base::TaskTraits& traits)
+    : TaskRunnerExecutor(base::ThreadPool::CreateSequencedTaskRunner(traits)) {
+}
+
+TaskRunnerExecutor::~TaskRunnerExecutor() {
+  Cronet_Executor_Destroy(executor_);
+}
+
+/* static */
+void TaskRunnerExecutor::Execute(Cronet_ExecutorPtr self,
+                                 Cronet_RunnablePtr runnable) {
+  auto* executor = static_cast<TaskRunnerExecutor*>(
+      Cronet_Executor_GetClientContext(self));
+  executor->task_runner_->PostTask(
+      FROM_HERE, base::BindOnce(&RunRunnable, ScopedRunnable(runnable)));
+}
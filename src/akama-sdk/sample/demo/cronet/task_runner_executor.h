@@ -0,0 +1,40 @@
+#ifndef AKAMA_SDK_SAMPLE_DEMO_CRONET_TASK_RUNNER_EXECUTOR_H_
+#define AKAMA_SDK_SAMPLE_DEMO_CRONET_TASK_RUNNER_EXECUTOR_H_
+
+#include "base/memory/scoped_refptr.h"
+#include "base/task/sequenced_task_runner.h"
+#include "base/task/task_traits.h"
+#include "cronet_c.h"
+
+// Cronet_Executor that posts the runnables to a base::SequencedTaskRunner, so
+// Cronet callbacks run on the ThreadPool with the traits of the rest of the
+// app instead of on a dedicated thread. The runnables of one executor run in
+// order, as a request requires.
+//
+// A runnable whose task is dropped, e.g. at shutdown, is destroyed without
+// being run.
+class TaskRunnerExecutor {
+ public:
+  // Posts to |task_runner|, e.g. the sequence of the caller.
+  explicit TaskRunnerExecutor(
+      scoped_refptr<base::SequencedTaskRunner> task_runner);
+  // Posts to a new ThreadPool sequence with |traits|. One such executor per
+  // request lets unrelated requests run in parallel.
+  explicit TaskRunnerExecutor(const base::TaskTraits& traits);
+  TaskRunnerExecutor(const TaskRunnerExecutor&) = delete;
+  TaskRunnerExecutor& operator=(const TaskRunnerExecutor&) = delete;
+  // Must outlive every request using the executor. Runnables already posted
+  // don't depend on |this|.
+  ~TaskRunnerExecutor();
+
+  Cronet_ExecutorPtr GetExecutor() { return executor_; }
+  base::SequencedTaskRunner* task_runner() const { return task_runner_.get(); }
+
+ private:
+  static void Execute(Cronet_ExecutorPtr self, Cronet_RunnablePtr runnable);
+
+  const scoped_refptr<base::SequencedTaskRunner> task_runner_;
+  Cronet_ExecutorPtr const executor_;
+};
+
+#endif  // AKAMA_SDK_SAMPLE_DEMO_CRONET_TASK_RUNNER_EXECUTOR_H_
@@ -0,0 +1,355 @@
+#include "work_stealing_executor.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+
+namespace {
+
+// Number of runnables a sequence runs before it goes back to the end of the
+// run queue, so one busy request can't starve the others.
+constexpr int kMaxRunnablesPerTurn = 32;
+// Number of rounds an idle worker looks for work before it goes to sleep.
+constexpr int kSpinRounds = 64;
+
+size_t RoundUpToPowerOfTwo(size_t value) {
+  size_t result = 1;
+  while (result < value)
+    result <<= 1;
+  return result;
+}
+
+}  // namespace
+
+// Bounded multi-producer/multi-consumer lock-free queue of sequences, see
+// https://www.1024cores.net/home/lock-free-algorithms/queues/bounded-mpmc-queue
+// A sequence is in at most one run queue at a time, so a queue with room for
+// every sequence can never overflow.
+class WorkStealingExecutor::RunQueue {
+ public:
+  explicit RunQueue(size_t capacity)
+      : mask_(RoundUpToPowerOfTwo(capacity) - 1),
+        cells_(new Cell[mask_ + 1]) {
+    for (size_t i = 0; i <= mask_; ++i)
+      cells_[i].position.store(i, std::memory_order_relaxed);
+  }
+  RunQueue(const RunQueue&) = delete;
+  RunQueue& operator=(const RunQueue&) = delete;
+
+  bool Push(Sequence* sequence) {
+    Cell* cell;
+    size_t position = enqueue_position_.load(std::memory_order_relaxed);
+    while (true) {
+      cell = &cells_[position & mask_];
+      size_t cell_position = cell->position.load(std::memory_order_acquire);
+      intptr_t diff =
+          static_cast<intptr_t>(cell_position) - static_cast<intptr_t>(position);
+      if (diff == 0) {
+        if (enqueue_position_.compare_exchange_weak(
+                position, position + 1, std::memory_order_relaxed)) {
+          break;
+        }
+      } else if (diff < 0) {
+        return false;
+      } else {
+        position = enqueue_position_.load(std::memory_order_relaxed);
+      }
+    }
+    cell->sequence = sequence;
+    cell->position.store(position + 1, std::memory_order_release);
+    return true;
+  }
+
+  Sequence* Pop() {
+    Cell* cell;
+    size_t position = dequeue_position_.load(std::memory_order_relaxed);
+    while (true) {
+      cell = &cells_[position & mask_];
+      size_t cell_position = cell->position.load(std::memory_order_acquire);
+      intptr_t diff = static_cast<intptr_t>(cell_position) -
+                      static_cast<intptr_t>(position + 1);
+      if (diff == 0) {
+        if (dequeue_position_.compare_exchange_weak(
+                position, position + 1, std::memory_order_relaxed)) {
+          break;
+        }
+      } else if (diff < 0) {
+        return nullptr;
+      } else {
+        position = dequeue_position_.load(std::memory_order_relaxed);
+      }
+    }
+    Sequence* sequence = cell->sequence;
+    cell->position.store(position + mask_ + 1, std::memory_order_release);
+    return sequence;
+  }
+
+  // May report a queue that is about to become (non-)empty. Only used to
+  // decide whether it is worth looking for work.
+  bool MaybeEmpty() const {
+    return enqueue_position_.load() == dequeue_position_.load();
+  }
+
+ private:
+  struct Cell {
+    std::atomic<size_t> position;
+    Sequence* sequence = nullptr;
+  };
+
+  const size_t mask_;
+  const std::unique_ptr<Cell[]> cells_;
+  alignas(64) std::atomic<size_t> enqueue_position_{0};
+  alignas(64) std::atomic<size_t> dequeue_position_{0};
+};
+
+// Ordered stream of runnables with its own Cronet_Executor. Runnables are kept
+// in a multi-producer/single-consumer lock-free linked queue, see
+// https://www.1024cores.net/home/lock-free-algorithms/queues/non-intrusive-mpsc-node-based-queue
+// |scheduled_| makes sure at most one worker consumes it at a time.
+class WorkStealingExecutor::Sequence {
+ public:
+  Sequence(WorkStealingExecutor* owner, size_t home_worker)
+      : owner_(owner),
+        home_worker_(home_worker),
+        head_(new Node),
+        tail_(head_.load()),
+        executor_(Cronet_Executor_CreateWith(WorkStealingExecutor::Execute)) {
+    Cronet_Executor_SetClientContext(executor_, this);
+  }
+  Sequence(const Sequence&) = delete;
+  Sequence& operator=(const Sequence&) = delete;
+  ~Sequence() {
+    DestroyPendingRunnables();
+    delete tail_;
+    Cronet_Executor_Destroy(executor_);
+  }
+
+  WorkStealingExecutor* owner() const { return owner_; }
+  size_t home_worker() const { return home_worker_; }
+  Cronet_ExecutorPtr executor() const { return executor_; }
+
+  // Adds |runnable| to the queue. Returns true if the caller has to schedule
+  // the sequence because nobody else is going to run it.
+  bool Push(Cronet_RunnablePtr runnable) {
+    Node* node = new Node;
+    node->runnable = runnable;
+    Node* previous = head_.exchange(node);
+    previous->next.store(node);
+    return !scheduled_.exchange(true);
+  }
+
+  // Runs a batch of runnables. Returns true if the sequence still has work
+  // and must be put back into a run queue.
+  bool RunBatch() {
+    for (int i = 0; i < kMaxRunnablesPerTurn; ++i) {
+      if (owner_->stopping())
+        return false;
+      Cronet_RunnablePtr runnable = Pop();
+      if (!runnable) {
+        // Unschedule, then look again: a producer that pushed after the Pop()
+        // above either sees |scheduled_| == false and schedules the sequence
+        // itself, or has already moved |head_| away from our |tail_|. Once
+        // unscheduled another worker may own the sequence, so only compare
+        // pointers here.
+        Node* tail = tail_;
+        scheduled_.store(false);
+        if (head_.load() == tail || scheduled_.exchange(true))
+          return false;
+        continue;
+      }
+      Cronet_Runnable_Run(runnable);
+      Cronet_Runnable_Destroy(runnable);
+    }
+    return true;
+  }
+
+  void DestroyPendingRunnables() {
+    while (Cronet_RunnablePtr runnable = Pop())
+      Cronet_Runnable_Destroy(runnable);
+  }
+
+ private:
+  struct Node {
+    std::atomic<Node*> next{nullptr};
+    Cronet_RunnablePtr runnable = nullptr;
+  };
+
+  // Only called by the worker that currently owns the sequence.
+  Cronet_RunnablePtr Pop() {
+    Node* tail = tail_;
+    Node* next = tail->next.load();
+    if (!next)
+      return nullptr;
+    tail_ = next;
+    Cronet_RunnablePtr runnable = next->runnable;
+    next->runnable = nullptr;
+    delete tail;
+    return runnable;
+  }
+
+  WorkStealingExecutor* const owner_;
+  // Worker whose run queue gets the sequence when it is scheduled from a
+  // non-worker thread, e.g. Cronet network thread.
+  const size_t home_worker_;
+  // Producers push at |head_|, the consumer pops at |tail_|.
+  std::atomic<Node*> head_;
+  Node* tail_;
+  std::atomic<bool> scheduled_{false};
+
+  Cronet_ExecutorPtr const executor_;
+};
+
+struct WorkStealingExecutor::Worker {
+  Worker(WorkStealingExecutor* owner, size_t index, size_t queue_capacity)
+      : owner(owner), index(index), run_queue(queue_capacity) {}
+
+  WorkStealingExecutor* const owner;
+  const size_t index;
+  RunQueue run_queue;
+  // Thread on which tasks are executed.
+  std::thread thread;
+};
+
+namespace {
+
+// Worker running on the current thread, if any. Lets runnables posted from a
+// callback stay on the same worker.
+thread_local void* g_current_worker = nullptr;
+
+}  // namespace
+
+WorkStealingExecutor::WorkStealingExecutor(size_t num_workers,
+                                           size_t num_sequences) {
+  if (num_workers == 0)
+    num_workers = std::max(1u, std::thread::hardware_concurrency());
+  if (num_sequences == 0)
+    num_sequences = num_workers * kSequencesPerWorker;
+
+  for (size_t i = 0; i < num_workers; ++i)
+    workers_.push_back(std::make_unique<Worker>(this, i, num_sequences));
+  for (size_t i = 0; i < num_sequences; ++i)
+    sequences_.push_back(std::make_unique<Sequence>(this, i % num_workers));
+  // Start threads once all workers exist, they steal from each other.
+  for (auto& worker : workers_)
+    worker->thread = std::thread(&WorkStealingExecutor::RunWorker, this,
+                                 worker.get());
+}
+
+WorkStealingExecutor::~WorkStealingExecutor() {
+  ShutdownExecutor();
+}
+
+Cronet_ExecutorPtr WorkStealingExecutor::GetExecutor() {
+  size_t index = next_sequence_.fetch_add(1, std::memory_order_relaxed);
+  return sequences_[index % sequences_.size()]->executor();
+}
+
+void WorkStealingExecutor::ShutdownExecutor() {
+  if (shut_down_)
+    return;
+  shut_down_ = true;
+
+  // Break tasks loops.
+  stopping_.store(true);
+  while (executes_in_flight_.load() > 0)
+    std::this_thread::yield();
+  {
+    std::lock_guard<std::mutex> lock(park_lock_);
+    parked_.notify_all();
+  }
+  // Wait for worker threads.
+  for (auto& worker : workers_)
+    worker->thread.join();
+
+  // Delete remaining tasks.
+  for (auto& sequence : sequences_)
+    sequence->DestroyPendingRunnables();
+}
+
+void WorkStealingExecutor::Schedule(Sequence* sequence) {
+  Worker* worker = static_cast<Worker*>(g_current_worker);
+  if (!worker || worker->owner != this)
+    worker = workers_[sequence->home_worker()].get();
+  bool pushed = worker->run_queue.Push(sequence);
+  assert(pushed);
+  (void)pushed;
+  WakeUpWorker();
+}
+
+void WorkStealingExecutor::WakeUpWorker() {
+  // Pairs with the fence in RunWorker(): either the sleeping worker sees the
+  // newly queued sequence, or we see it in |num_parked_|.
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (num_parked_.load() == 0)
+    return;
+  std::lock_guard<std::mutex> lock(park_lock_);
+  parked_.notify_one();
+}
+
+WorkStealingExecutor::Sequence* WorkStealingExecutor::FindWork(
+    Worker* worker) {
+  if (Sequence* sequence = worker->run_queue.Pop())
+    return sequence;
+  const size_t count = workers_.size();
+  for (size_t i = 1; i < count; ++i) {
+    Worker* victim = workers_[(worker->index + i) % count].get();
+    if (Sequence* sequence = victim->run_queue.Pop())
+      return sequence;
+  }
+  return nullptr;
+}
+
+bool WorkStealingExecutor::HasWork() const {
+  for (const auto& worker : workers_) {
+    if (!worker->run_queue.MaybeEmpty())
+      return true;
+  }
+  return false;
+}
+
+void WorkStealingExecutor::RunWorker(Worker* worker) {
+  g_current_worker = worker;
+  int idle_rounds = 0;
+  while (!stopping()) {
+    Sequence* sequence = FindWork(worker);
+    if (sequence) {
+      idle_rounds = 0;
+      if (sequence->RunBatch())
+        worker->run_queue.Push(sequence);
+      continue;
+    }
+
+    if (++idle_rounds < kSpinRounds) {
+      std::this_thread::yield();
+      continue;
+    }
+
+    // Wait for a task to run or stop signal.
+    std::unique_lock<std::mutex> lock(park_lock_);
+    num_parked_.fetch_add(1);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (!HasWork() && !stopping())
+      parked_.wait(lock);
+    num_parked_.fetch_sub(1);
+    idle_rounds = 0;
+  }
+  g_current_worker = nullptr;
+}
+
+/* static */
+void WorkStealingExecutor::Execute(Cronet_ExecutorPtr self,
+                                   Cronet_RunnablePtr runnable) {
+  auto* sequence =
+      static_cast<Sequence*>(Cronet_Executor_GetClientContext(self));
+  WorkStealingExecutor* executor = sequence->owner();
+
+  executor->executes_in_flight_.fetch_add(1);
+  if (executor->stopping()) {
+    executor->executes_in_flight_.fetch_sub(1);
+    Cronet_Runnable_Destroy(runnable);
+    return;
+  }
+  if (sequence->Push(runnable))
+    executor->Schedule(sequence);
+  executor->executes_in_flight_.fetch_sub(1);
+}
@@ -0,0 +1,89 @@
+#ifndef AKAMA_SDK_SAMPLE_DEMO_CRONET_WORK_STEALING_EXECUTOR_H_
+#define AKAMA_SDK_SAMPLE_DEMO_CRONET_WORK_STEALING_EXECUTOR_H_
+
+// Like SampleExecutor this relies on STL only, so it can be used outside of
+// Chromium infrastructure as well.
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "cronet_c.h"
+
+// Implementation of Cronet_Executor interface that runs runnables on a pool of
+// worker threads.
+//
+// Runnables are posted to sequences. Runnables of one sequence run one at a
+// time in posting order, different sequences run in parallel. Every worker
+// owns a lock-free run queue of ready sequences, and a worker that runs out of
+// work steals sequences from the other workers before going to sleep. Workers
+// are only woken up when some of them are actually sleeping.
+//
+// GetExecutor() hands out the sequences round robin. As long as a request
+// keeps using the Cronet_ExecutorPtr it was initialized with, all of its
+// callbacks run in order.
+class WorkStealingExecutor {
+ public:
+  // |num_workers| == 0 means std::thread::hardware_concurrency() workers.
+  // |num_sequences| == 0 means kSequencesPerWorker sequences per worker.
+  explicit WorkStealingExecutor(size_t num_workers = 0,
+                                size_t num_sequences = 0);
+  WorkStealingExecutor(const WorkStealingExecutor&) = delete;
+  WorkStealingExecutor& operator=(const WorkStealingExecutor&) = delete;
+  ~WorkStealingExecutor();
+
+  // Gets the Cronet_ExecutorPtr of the next sequence. The pointer stays valid
+  // until |this| is destroyed.
+  Cronet_ExecutorPtr GetExecutor();
+
+  // Shuts down the executor, so all pending tasks are destroyed without
+  // getting executed.
+  void ShutdownExecutor();
+
+  size_t num_workers() const { return workers_.size(); }
+  size_t num_sequences() const { return sequences_.size(); }
+
+  static constexpr size_t kSequencesPerWorker = 4;
+
+ private:
+  class RunQueue;
+  class Sequence;
+  struct Worker;
+
+  // Makes |sequence| ready to run on some worker.
+  void Schedule(Sequence* sequence);
+  // Wakes up one sleeping worker, if any.
+  void WakeUpWorker();
+  // Returns a ready sequence from |worker| or from another worker's queue.
+  Sequence* FindWork(Worker* worker);
+  bool HasWork() const;
+  bool stopping() const { return stopping_.load(); }
+
+  void RunWorker(Worker* worker);
+
+  // Implementation of Cronet_Executor methods.
+  static void Execute(Cronet_ExecutorPtr self, Cronet_RunnablePtr runnable);
+
+  std::vector<std::unique_ptr<Worker>> workers_;
+  std::vector<std::unique_ptr<Sequence>> sequences_;
+  // Index of the sequence returned by the next GetExecutor() call.
+  std::atomic<size_t> next_sequence_{0};
+
+  // Set to true to stop running tasks.
+  std::atomic<bool> stopping_{false};
+  // Number of Execute() calls that passed the |stopping_| check but did not
+  // finish queueing yet. ShutdownExecutor() waits for them before draining.
+  std::atomic<int> executes_in_flight_{0};
+
+  // Sleeping workers wait on |parked_| under |park_lock_|.
+  std::mutex park_lock_;
+  std::condition_variable parked_;
+  std::atomic<int> num_parked_{0};
+
+  bool shut_down_ = false;
+};
+
+#endif  // AKAMA_SDK_SAMPLE_DEMO_CRONET_WORK_STEALING_EXECUTOR_H_
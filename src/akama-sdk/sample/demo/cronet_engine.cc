@@ -0,0 +1,365 @@
+#include "cronet_engine.h"
+
+#include <utility>
+
+#include "base/command_line.h"
+#include "base/files/file_util.h"
+#include "base/json/json_reader.h"
+#include "base/json/json_writer.h"
+#include "base/logging.h"
+#include "base/strings/string_number_conversions.h"
+#include "base/strings/string_piece.h"
+#include "base/strings/string_split.h"
+#include "base/values.h"
+
+namespace {
+
+constexpr char kEngineConfigSwitch[] = "engine-config";
+constexpr char kUserAgentSwitch[] = "user-agent";
+constexpr char kStoragePathSwitch[] = "storage-path";
+constexpr char kHttpCacheSwitch[] = "http-cache";
+constexpr char kHttpCacheSizeSwitch[] = "http-cache-size";
+constexpr char kDisableHttp2Switch[] = "disable-http2";
+constexpr char kDisableQuicSwitch[] = "disable-quic";
+constexpr char kEnableBrotliSwitch[] = "enable-brotli";
+constexpr char kQuicHintsSwitch[] = "quic-hints";
+constexpr char kExperimentalOptionsSwitch[] = "experimental-options";
+constexpr char kWarmUpOriginsSwitch[] = "warm-up-origins";
+constexpr char kWarmUpQuicHintsSwitch[] = "warm-up-quic-hints";
+constexpr char kPersistNetworkStateSwitch[] = "persist-network-state";
+
+// QUIC server configs kept in the persisted server properties.
+constexpr int kMaxQuicServerConfigsPersisted = 32;
+// Delay to batch host cache updates before they are written to disk.
+constexpr int kHostCachePersistDelayMs = 5000;
+
+bool ParseHttpCacheMode(const std::string& value,
+                        EngineProfile::HttpCacheMode* mode) {
+  if (value == "disabled")
+    *mode = EngineProfile::HttpCacheMode::kDisabled;
+  else if (value == "memory")
+    *mode = EngineProfile::HttpCacheMode::kInMemory;
+  else if (value == "disk-no-http")
+    *mode = EngineProfile::HttpCacheMode::kDiskNoHttp;
+  else if (value == "disk")
+    *mode = EngineProfile::HttpCacheMode::kDisk;
+  else
+    return false;
+  return true;
+}
+
+// Parses "host:port:alternate_port".
+bool ParseQuicHint(const std::string& value, EngineProfile::QuicHint* hint) {
+  std::vector<std::string> parts = base::SplitString(
+      value, ":", base::TRIM_WHITESPACE, base::SPLIT_WANT_ALL);
+  if (parts.size() != 3 || parts[0].empty() ||
+      !base::StringToInt(parts[1], &hint->port) ||
+      !base::StringToInt(parts[2], &hint->alternate_port)) {
+    return false;
+  }
+  hint->host = parts[0];
+  return true;
+}
+
+// Returns the QUIC hint for an "https://host[:port]" origin.
+bool GetQuicHintForOrigin(const std::string& origin,
+                          EngineProfile::QuicHint* hint) {
+  constexpr char kHttpsPrefix[] = "https://";
+  if (origin.compare(0, sizeof(kHttpsPrefix) - 1, kHttpsPrefix) != 0)
+    return false;
+  std::string host_port = origin.substr(sizeof(kHttpsPrefix) - 1);
+  host_port = host_port.substr(0, host_port.find('/'));
+  size_t colon = host_port.rfind(':');
+  // Not a port separator if it is part of a bracketed IPv6 address.
+  if (colon != std::string::npos &&
+      host_port.find(']', colon) == std::string::npos) {
+    if (!base::StringToInt(host_port.substr(colon + 1), &hint->port))
+      return false;
+    host_port.resize(colon);
+  }
+  if (host_port.empty())
+    return false;
+  hint->host = host_port;
+  hint->alternate_port = hint->port;
+  return true;
+}
+
+// Sets |key| in |dict| unless the user already did.
+void SetDefault(base::Value::Dict* dict,
+                base::StringPiece key,
+                base::Value value) {
+  if (!dict->Find(key))
+    dict->Set(key, std::move(value));
+}
+
+// Returns the dictionary at |key|, adding an empty one if needed.
+base::Value::Dict* EnsureDict(base::Value::Dict* dict, base::StringPiece key) {
+  if (base::Value::Dict* child = dict->FindDict(key))
+    return child;
+  return dict->Set(key, base::Value::Dict())->GetIfDict();
+}
+
+// Returns the experimental options of |profile|, with the options that
+// persist the network state added if enabled.
+bool GetExperimentalOptions(const EngineProfile& profile,
+                            bool persist_network_state,
+                            std::string* experimental_options) {
+  if (!persist_network_state) {
+    *experimental_options = profile.experimental_options;
+    return true;
+  }
+
+  base::Value::Dict options;
+  if (!profile.experimental_options.empty()) {
+    absl::optional<base::Value> value =
+        base::JSONReader::Read(profile.experimental_options);
+    if (!value || !value->is_dict()) {
+      LOG(ERROR) << "Experimental options are not a JSON dictionary";
+      return false;
+    }
+    options = std::move(value->GetDict());
+  }
+  base::Value::Dict* quic = EnsureDict(&options, "QUIC");
+  SetDefault(quic, "store_server_configs_in_properties", base::Value(true));
+  SetDefault(quic, "max_server_configs_stored_in_properties",
+             base::Value(kMaxQuicServerConfigsPersisted));
+  base::Value::Dict* stale_dns = EnsureDict(&options, "StaleDNS");
+  SetDefault(stale_dns, "enable", base::Value(true));
+  SetDefault(stale_dns, "persist_to_disk", base::Value(true));
+  SetDefault(stale_dns, "persist_delay_ms",
+             base::Value(kHostCachePersistDelayMs));
+  return base::JSONWriter::Write(base::Value(std::move(options)),
+                                 experimental_options);
+}
+
+bool IsDiskCacheMode(EngineProfile::HttpCacheMode mode) {
+  return mode == EngineProfile::HttpCacheMode::kDiskNoHttp ||
+         mode == EngineProfile::HttpCacheMode::kDisk;
+}
+
+Cronet_EngineParams_HTTP_CACHE_MODE ToCronetHttpCacheMode(
+    EngineProfile::HttpCacheMode mode) {
+  switch (mode) {
+    case EngineProfile::HttpCacheMode::kDisabled:
+      return Cronet_EngineParams_HTTP_CACHE_MODE_DISABLED;
+    case EngineProfile::HttpCacheMode::kInMemory:
+      return Cronet_EngineParams_HTTP_CACHE_MODE_IN_MEMORY;
+    case EngineProfile::HttpCacheMode::kDiskNoHttp:
+      return Cronet_EngineParams_HTTP_CACHE_MODE_DISK_NO_HTTP;
+    case EngineProfile::HttpCacheMode::kDisk:
+      return Cronet_EngineParams_HTTP_CACHE_MODE_DISK;
+  }
+  return Cronet_EngineParams_HTTP_CACHE_MODE_DISABLED;
+}
+
+}  // namespace
+
+EngineProfile::EngineProfile() = default;
+EngineProfile::EngineProfile(const EngineProfile&) = default;
+EngineProfile& EngineProfile::operator=(const EngineProfile&) = default;
+EngineProfile::~EngineProfile() = default;
+
+/* static */
+bool EngineProfile::FromCommandLine(const base::CommandLine& command_line,
+                                    EngineProfile* profile) {
+  if (command_line.HasSwitch(kEngineConfigSwitch) &&
+      !FromConfigFile(command_line.GetSwitchValuePath(kEngineConfigSwitch),
+                      profile)) {
+    return false;
+  }
+
+  if (command_line.HasSwitch(kUserAgentSwitch))
+    profile->user_agent = command_line.GetSwitchValueASCII(kUserAgentSwitch);
+  if (command_line.HasSwitch(kStoragePathSwitch))
+    profile->storage_path = command_line.GetSwitchValuePath(kStoragePathSwitch);
+  if (command_line.HasSwitch(kHttpCacheSwitch) &&
+      !ParseHttpCacheMode(command_line.GetSwitchValueASCII(kHttpCacheSwitch),
+                          &profile->http_cache_mode)) {
+    LOG(ERROR) << "Invalid --" << kHttpCacheSwitch;
+    return false;
+  }
+  if (command_line.HasSwitch(kHttpCacheSizeSwitch) &&
+      !base::StringToInt64(
+          command_line.GetSwitchValueASCII(kHttpCacheSizeSwitch),
+          &profile->http_cache_max_size)) {
+    LOG(ERROR) << "Invalid --" << kHttpCacheSizeSwitch;
+    return false;
+  }
+  if (command_line.HasSwitch(kDisableHttp2Switch))
+    profile->enable_http2 = false;
+  if (command_line.HasSwitch(kDisableQuicSwitch))
+    profile->enable_quic = false;
+  if (command_line.HasSwitch(kEnableBrotliSwitch))
+    profile->enable_brotli = true;
+  if (command_line.HasSwitch(kQuicHintsSwitch)) {
+    for (const std::string& value : base::SplitString(
+             command_line.GetSwitchValueASCII(kQuicHintsSwitch), ",",
+             base::TRIM_WHITESPACE, base::SPLIT_WANT_NONEMPTY)) {
+      QuicHint hint;
+      if (!ParseQuicHint(value, &hint)) {
+        LOG(ERROR) << "Invalid QUIC hint: " << value;
+        return false;
+      }
+      profile->quic_hints.push_back(std::move(hint));
+    }
+  }
+  if (command_line.HasSwitch(kExperimentalOptionsSwitch)) {
+    profile->experimental_options =
+        command_line.GetSwitchValueASCII(kExperimentalOptionsSwitch);
+  }
+  if (command_line.HasSwitch(kWarmUpOriginsSwitch)) {
+    profile->warm_up_origins = base::SplitString(
+        command_line.GetSwitchValueASCII(kWarmUpOriginsSwitch), ",",
+        base::TRIM_WHITESPACE, base::SPLIT_WANT_NONEMPTY);
+  }
+  if (command_line.HasSwitch(kWarmUpQuicHintsSwitch))
+    profile->warm_up_quic_hints = true;
+  if (command_line.HasSwitch(kPersistNetworkStateSwitch))
+    profile->persist_network_state = true;
+  return true;
+}
+
+/* static */
+bool EngineProfile::FromConfigFile(const base::FilePath& path,
+                                   EngineProfile* profile) {
+  std::string contents;
+  if (!base::ReadFileToString(path, &contents)) {
+    LOG(ERROR) << "Failed to read engine config " << path;
+    return false;
+  }
+  absl::optional<base::Value> value = base::JSONReader::Read(contents);
+  if (!value || !value->is_dict()) {
+    LOG(ERROR) << "Engine config is not a JSON dictionary: " << path;
+    return false;
+  }
+  const base::Value::Dict& config = value->GetDict();
+
+  if (const std::string* user_agent = config.FindString("user_agent"))
+    profile->user_agent = *user_agent;
+  if (const std::string* storage_path = config.FindString("storage_path"))
+    profile->storage_path = base::FilePath::FromUTF8Unsafe(*storage_path);
+  if (const base::Value::Dict* http_cache = config.FindDict("http_cache")) {
+    const std::string* mode = http_cache->FindString("mode");
+    if (mode && !ParseHttpCacheMode(*mode, &profile->http_cache_mode)) {
+      LOG(ERROR) << "Invalid http_cache.mode: " << *mode;
+      return false;
+    }
+    if (absl::optional<double> max_size = http_cache->FindDouble("max_size"))
+      profile->http_cache_max_size = static_cast<int64_t>(*max_size);
+  }
+  profile->enable_http2 =
+      config.FindBool("enable_http2").value_or(profile->enable_http2);
+  profile->enable_quic =
+      config.FindBool("enable_quic").value_or(profile->enable_quic);
+  profile->enable_brotli =
+      config.FindBool("enable_brotli").value_or(profile->enable_brotli);
+  if (const base::Value::List* quic_hints = config.FindList("quic_hints")) {
+    for (const base::Value& item : *quic_hints) {
+      const base::Value::Dict* dict = item.GetIfDict();
+      const std::string* host = dict ? dict->FindString("host") : nullptr;
+      if (!host) {
+        LOG(ERROR) << "Invalid quic_hints entry";
+        return false;
+      }
+      QuicHint hint;
+      hint.host = *host;
+      hint.port = dict->FindInt("port").value_or(hint.port);
+      hint.alternate_port =
+          dict->FindInt("alternate_port").value_or(hint.port);
+      profile->quic_hints.push_back(std::move(hint));
+    }
+  }
+  if (const base::Value::Dict* options =
+          config.FindDict("experimental_options")) {
+    base::JSONWriter::Write(base::Value(options->Clone()),
+                            &profile->experimental_options);
+  }
+  if (const base::Value::List* origins = config.FindList("warm_up_origins")) {
+    profile->warm_up_origins.clear();
+    for (const base::Value& origin : *origins) {
+      if (!origin.is_string()) {
+        LOG(ERROR) << "Invalid warm_up_origins entry";
+        return false;
+      }
+      profile->warm_up_origins.push_back(origin.GetString());
+    }
+  }
+  profile->warm_up_quic_hints = config.FindBool("warm_up_quic_hints")
+                                    .value_or(profile->warm_up_quic_hints);
+  profile->persist_network_state =
+      config.FindBool("persist_network_state")
+          .value_or(profile->persist_network_state);
+  return true;
+}
+
+Cronet_EnginePtr CreateCronetEngine(const EngineProfile& profile) {
+  EngineProfile::HttpCacheMode http_cache_mode = profile.http_cache_mode;
+  if (!profile.storage_path.empty() &&
+      !base::CreateDirectory(profile.storage_path)) {
+    LOG(ERROR) << "Failed to create storage path " << profile.storage_path;
+    return nullptr;
+  }
+  if (IsDiskCacheMode(http_cache_mode) && profile.storage_path.empty()) {
+    LOG(WARNING) << "Disk cache needs a storage path, using memory cache";
+    http_cache_mode = EngineProfile::HttpCacheMode::kInMemory;
+  }
+  bool persist_network_state = profile.persist_network_state;
+  if (persist_network_state && profile.storage_path.empty()) {
+    LOG(WARNING) << "Persisting the network state needs a storage path";
+    persist_network_state = false;
+  }
+  std::string experimental_options;
+  if (!GetExperimentalOptions(profile, persist_network_state,
+                              &experimental_options)) {
+    return nullptr;
+  }
+
+  Cronet_EnginePtr cronet_engine = Cronet_Engine_Create();
+  Cronet_EngineParamsPtr engine_params = Cronet_EngineParams_Create();
+  Cronet_EngineParams_user_agent_set(engine_params,
+                                     profile.user_agent.c_str());
+  if (!profile.storage_path.empty()) {
+    Cronet_EngineParams_storage_path_set(
+        engine_params, profile.storage_path.AsUTF8Unsafe().c_str());
+  }
+  Cronet_EngineParams_http_cache_mode_set(
+      engine_params, ToCronetHttpCacheMode(http_cache_mode));
+  if (profile.http_cache_max_size > 0) {
+    Cronet_EngineParams_http_cache_max_size_set(engine_params,
+                                                profile.http_cache_max_size);
+  }
+  Cronet_EngineParams_enable_http2_set(engine_params, profile.enable_http2);
+  Cronet_EngineParams_enable_quic_set(engine_params, profile.enable_quic);
+  Cronet_EngineParams_enable_brotli_set(engine_params, profile.enable_brotli);
+  std::vector<EngineProfile::QuicHint> quic_hints = profile.quic_hints;
+  if (profile.enable_quic && profile.warm_up_quic_hints) {
+    for (const std::string& origin : profile.warm_up_origins) {
+      EngineProfile::QuicHint hint;
+      if (GetQuicHintForOrigin(origin, &hint))
+        quic_hints.push_back(std::move(hint));
+    }
+  }
+  for (const EngineProfile::QuicHint& hint : quic_hints) {
+    // The params keep a copy of the hint.
+    Cronet_QuicHintPtr quic_hint = Cronet_QuicHint_Create();
+    Cronet_QuicHint_host_set(quic_hint, hint.host.c_str());
+    Cronet_QuicHint_port_set(quic_hint, hint.port);
+    Cronet_QuicHint_alternate_port_set(quic_hint, hint.alternate_port);
+    Cronet_EngineParams_quic_hints_add(engine_params, quic_hint);
+    Cronet_QuicHint_Destroy(quic_hint);
+  }
+  if (!experimental_options.empty()) {
+    Cronet_EngineParams_experimental_options_set(engine_params,
+                                                 experimental_options.c_str());
+  }
+
+  Cronet_RESULT result =
+      Cronet_Engine_StartWithParams(cronet_engine, engine_params);
+  Cronet_EngineParams_Destroy(engine_params);
+  if (result != Cronet_RESULT_SUCCESS) {
+    LOG(ERROR) << "Failed to start Cronet engine: " << result;
+    Cronet_Engine_Destroy(cronet_engine);
+    return nullptr;
+  }
+  return cronet_engine;
+}
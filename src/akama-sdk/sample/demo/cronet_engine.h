@@ -0,0 +1,106 @@
+#ifndef AKAMA_SDK_SAMPLE_DEMO_CRONET_ENGINE_H_
+#define AKAMA_SDK_SAMPLE_DEMO_CRONET_ENGINE_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "base/files/file_path.h"
+#include "components/cronet/native/include/cronet_c.h"
+
+namespace base {
+class CommandLine;
+}  // namespace base
+
+// Settings of the Cronet engine. Filled from a JSON config file and/or command
+// line switches, see FromCommandLine().
+struct EngineProfile {
+  enum class HttpCacheMode {
+    kDisabled,
+    kInMemory,
+    // Disk cache that doesn't store HTTP data, only other persistent state.
+    kDiskNoHttp,
+    kDisk,
+  };
+
+  struct QuicHint {
+    std::string host;
+    int port = 443;
+    int alternate_port = 443;
+  };
+
+  EngineProfile();
+  EngineProfile(const EngineProfile&);
+  EngineProfile& operator=(const EngineProfile&);
+  ~EngineProfile();
+
+  // Reads --engine-config first, then applies the other switches on top:
+  //   --engine-config=<path>        JSON config file, see FromConfigFile().
+  //   --user-agent=<string>
+  //   --storage-path=<dir>          Created if it doesn't exist.
+  //   --http-cache=disabled|memory|disk-no-http|disk
+  //   --http-cache-size=<bytes>
+  //   --disable-http2
+  //   --disable-quic
+  //   --enable-brotli
+  //   --quic-hints=<host:port:alternate_port>,...
+  //   --experimental-options=<json dictionary>
+  //   --warm-up-origins=<origin>,...
+  //   --warm-up-quic-hints
+  //   --persist-network-state
+  // Returns false and leaves |profile| partially updated on invalid input.
+  static bool FromCommandLine(const base::CommandLine& command_line,
+                              EngineProfile* profile);
+
+  // Reads a JSON file like:
+  //   {
+  //     "user_agent": "CronetSample/1",
+  //     "storage_path": "/tmp/cronet",
+  //     "http_cache": { "mode": "disk", "max_size": 52428800 },
+  //     "enable_http2": true,
+  //     "enable_quic": true,
+  //     "enable_brotli": true,
+  //     "quic_hints": [ { "host": "www.example.com", "port": 443,
+  //                       "alternate_port": 443 } ],
+  //     "experimental_options": { "AsyncDNS": { "enable": true } },
+  //     "warm_up_origins": [ "https://www.example.com" ],
+  //     "warm_up_quic_hints": true,
+  //     "persist_network_state": true
+  //   }
+  // All keys are optional.
+  static bool FromConfigFile(const base::FilePath& path,
+                             EngineProfile* profile);
+
+  std::string user_agent = "CronetSample/1";
+  // Directory for the disk cache and other persistent state. Required by the
+  // disk cache modes.
+  base::FilePath storage_path;
+  HttpCacheMode http_cache_mode = HttpCacheMode::kDisabled;
+  // 0 lets Cronet pick the size.
+  int64_t http_cache_max_size = 0;
+  bool enable_http2 = true;
+  bool enable_quic = true;
+  bool enable_brotli = false;
+  std::vector<QuicHint> quic_hints;
+  // JSON dictionary passed through as Cronet experimental options.
+  std::string experimental_options;
+  // Origins to warm up right after the engine started, see EngineWarmUp.
+  std::vector<std::string> warm_up_origins;
+  // Adds a QUIC hint for every https origin in |warm_up_origins|, so the
+  // warm-up already tries QUIC. Only for servers known to support it, a
+  // failed QUIC attempt costs a fallback to TCP.
+  bool warm_up_quic_hints = false;
+  // Keeps what the engine learned about servers in |storage_path| across
+  // restarts: HTTP server properties (QUIC and HTTP/2 support, alternative
+  // services), QUIC server configs for 0-RTT and the host cache. Cronet
+  // loads the state asynchronously at startup and writes it back in batches
+  // on its file thread. TLS session tickets are not persisted by Cronet.
+  bool persist_network_state = false;
+};
+
+// Creates and starts the Cronet engine used by the samples. Returns nullptr
+// if the engine fails to start.
+Cronet_EnginePtr CreateCronetEngine(
+    const EngineProfile& profile = EngineProfile());
+
+#endif  // AKAMA_SDK_SAMPLE_DEMO_CRONET_ENGINE_H_
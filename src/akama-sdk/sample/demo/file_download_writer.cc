@@ -0,0 +1,128 @@
+#include "file_download_writer.h"
+
+#include <utility>
+
+#include "base/bind.h"
+#include "base/files/file.h"
+#include "base/memory/ref_counted.h"
+#include "base/sequence_checker.h"
+#include "base/task/sequenced_task_runner.h"
+#include "base/task/task_traits.h"
+#include "base/task/thread_pool.h"
+#include "cronet/response_headers.h"
+
+class FileDownloadWriter::Core : public base::RefCountedThreadSafe<Core> {
+ public:
+  Core(const base::FilePath& path,
+       int64_t offset,
+       bool truncate,
+       ProgressCallback progress_callback)
+      : task_runner_(base::ThreadPool::CreateSequencedTaskRunner(
+            {base::MayBlock(), base::TaskPriority::USER_VISIBLE,
+             base::TaskShutdownBehavior::BLOCK_SHUTDOWN})),
+        path_(path),
+        offset_(offset),
+        truncate_(truncate),
+        progress_callback_(std::move(progress_callback)) {
+    DETACH_FROM_SEQUENCE(sequence_checker_);
+  }
+  Core(const Core&) = delete;
+  Core& operator=(const Core&) = delete;
+
+  base::SequencedTaskRunner* task_runner() const { return task_runner_.get(); }
+
+  void Open() {
+    DCHECK_CALLED_ON_VALID_SEQUENCE(sequence_checker_);
+    file_.Initialize(path_, base::File::FLAG_OPEN_ALWAYS |
+                                base::File::FLAG_WRITE);
+    if (file_.IsValid() && truncate_ && !file_.SetLength(offset_))
+      file_.Close();
+    start_time_ = base::TimeTicks::Now();
+  }
+
+  void SetTotalBytes(int64_t total_bytes) {
+    DCHECK_CALLED_ON_VALID_SEQUENCE(sequence_checker_);
+    progress_.total_bytes = total_bytes;
+  }
+
+  void Write(Cronet_BufferPtr buffer, uint64_t bytes_read, ReadNext read_next) {
+    DCHECK_CALLED_ON_VALID_SEQUENCE(sequence_checker_);
+    int size = static_cast<int>(bytes_read);
+    if (!file_.IsValid() ||
+        file_.Write(offset_ + progress_.bytes_written,
+                    static_cast<const char*>(Cronet_Buffer_GetData(buffer)),
+                    size) != size) {
+      // Cancels the request, OnBodyComplete() follows.
+      Cronet_Buffer_Destroy(buffer);
+      read_next(nullptr);
+      return;
+    }
+    progress_.bytes_written += size;
+    ReportProgress();
+    // The buffer is free again, read the next part into it.
+    read_next(buffer);
+  }
+
+  void Finish(bool success) {
+    DCHECK_CALLED_ON_VALID_SEQUENCE(sequence_checker_);
+    progress_.success = success && file_.IsValid();
+    file_.Close();
+    progress_.done = true;
+    ReportProgress();
+  }
+
+ private:
+  friend class base::RefCountedThreadSafe<Core>;
+  ~Core() = default;
+
+  void ReportProgress() {
+    progress_.elapsed = base::TimeTicks::Now() - start_time_;
+    if (progress_callback_)
+      progress_callback_.Run(progress_);
+  }
+
+  const scoped_refptr<base::SequencedTaskRunner> task_runner_;
+  const base::FilePath path_;
+  const int64_t offset_;
+  const bool truncate_;
+  const ProgressCallback progress_callback_;
+
+  base::File file_;
+  base::TimeTicks start_time_;
+  Progress progress_;
+
+  SEQUENCE_CHECKER(sequence_checker_);
+};
+
+FileDownloadWriter::FileDownloadWriter(const base::FilePath& path,
+                                       int64_t offset,
+                                       bool truncate,
+                                       ProgressCallback progress_callback)
+    : core_(base::MakeRefCounted<Core>(path,
+                                       offset,
+                                       truncate,
+                                       std::move(progress_callback))) {
+  core_->task_runner()->PostTask(FROM_HERE,
+                                 base::BindOnce(&Core::Open, core_));
+}
+
+FileDownloadWriter::~FileDownloadWriter() = default;
+
+void FileDownloadWriter::OnResponseStarted(Cronet_UrlResponseInfoPtr info) {
+  core_->task_runner()->PostTask(
+      FROM_HERE,
+      base::BindOnce(&Core::SetTotalBytes, core_, GetContentLength(info)));
+}
+
+void FileDownloadWriter::OnBodyRead(Cronet_BufferPtr buffer,
+                                    uint64_t bytes_read,
+                                    ReadNext read_next) {
+  core_->task_runner()->PostTask(
+      FROM_HERE, base::BindOnce(&Core::Write, core_, buffer, bytes_read,
+                                std::move(read_next)));
+}
+
+void FileDownloadWriter::OnBodyComplete(bool success) {
+  core_->task_runner()->PostTask(
+      FROM_HERE, base::BindOnce(&Core::Finish, core_, success));
+}
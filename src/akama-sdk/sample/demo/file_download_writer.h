@@ -0,0 +1,62 @@
+#ifndef AKAMA_SDK_SAMPLE_DEMO_FILE_DOWNLOAD_WRITER_H_
+#define AKAMA_SDK_SAMPLE_DEMO_FILE_DOWNLOAD_WRITER_H_
+
+#include <cstdint>
+
+#include "base/callback.h"
+#include "base/files/file_path.h"
+#include "base/memory/scoped_refptr.h"
+#include "base/time/time.h"
+#include "cronet/response_body_consumer.h"
+
+// Streams a response body into a file instead of keeping it in memory.
+//
+// Every completed read is written at its offset with a positional write on a
+// MayBlock ThreadPool sequence, and the next read is only issued once the
+// write finished. A download therefore holds one read buffer at a time, no
+// matter how large the file is.
+class FileDownloadWriter : public ResponseBodyConsumer {
+ public:
+  struct Progress {
+    int64_t bytes_written = 0;
+    // Content-Length of the response, or -1 if it is unknown.
+    int64_t total_bytes = -1;
+    base::TimeDelta elapsed;
+    // Set for the last report, once the file is closed.
+    bool done = false;
+    bool success = false;
+
+    double bytes_per_second() const {
+      return elapsed.is_zero() ? 0 : bytes_written / elapsed.InSecondsF();
+    }
+  };
+  // Run on the file sequence after every write and once more when done.
+  using ProgressCallback = base::RepeatingCallback<void(const Progress&)>;
+
+  // Writes the body to |path| starting at |offset|. With |truncate| the file
+  // is cut to |offset| bytes when it is opened, otherwise the rest of the file
+  // is kept, e.g. when several requests write parts of it.
+  FileDownloadWriter(const base::FilePath& path,
+                     int64_t offset,
+                     bool truncate,
+                     ProgressCallback progress_callback);
+  FileDownloadWriter(const FileDownloadWriter&) = delete;
+  FileDownloadWriter& operator=(const FileDownloadWriter&) = delete;
+  ~FileDownloadWriter() override;
+
+  // ResponseBodyConsumer:
+  void OnResponseStarted(Cronet_UrlResponseInfoPtr info) override;
+  void OnBodyRead(Cronet_BufferPtr buffer,
+                  uint64_t bytes_read,
+                  ReadNext read_next) override;
+  void OnBodyComplete(bool success) override;
+
+ private:
+  // Lives on the file sequence. Ref counted, so pending writes can finish
+  // after |this| is gone.
+  class Core;
+
+  scoped_refptr<Core> core_;
+};
+
+#endif  // AKAMA_SDK_SAMPLE_DEMO_FILE_DOWNLOAD_WRITER_H_
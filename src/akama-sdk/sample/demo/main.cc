@@ -1,10 +1,17 @@
+#include <atomic>
 #include <iostream>
+#include <memory>
+#include <vector>
 
 #include "base/strings/string_number_conversions.h"
 #include "base/time/time.h"
 
 #include "base/bind.h"
+#include "base/command_line.h"
+#include "base/files/file_path.h"
+#include "base/files/file_util.h"
 #include "base/run_loop.h"
+#include "base/synchronization/waitable_event.h"
 #include "base/task/single_thread_task_executor.h"
 #include "base/task/task_traits.h"
 #include "base/task/thread_pool.h"
@@ -15,51 +22,459 @@
 #include "base/threading/thread_task_runner_handle.h"
 
 #include "components/cronet/native/include/cronet_c.h"
+#include "cronet_engine.h"
+#include "cronet/body_processor.h"
+#include "cronet/buffer_pool.h"
+#include "cronet/bulk_fetcher.h"
+#include "cronet/deadline_timer.h"
+#include "cronet/engine_warm_up.h"
+#include "cronet/flow_controlled_body_stream.h"
+#include "cronet/memory_budget.h"
+#include "cronet/response_body_sink.h"
+#include "cronet/request_coalescer.h"
+#include "cronet/request_metrics.h"
+#include "cronet/response_cache.h"
 #include "cronet/sample_executor.h"
 #include "cronet/sample_url_request_callback.h"
+#include "cronet/task_runner_executor.h"
+#include "cronet/work_stealing_executor.h"
+#include "file_download_writer.h"
+#include "range_downloader.h"
+#include "upload_data_provider.h"
 
 Cronet_EnginePtr g_cronet_engine = nullptr;
 
-Cronet_EnginePtr CreateCronetEngine() {
-  Cronet_EnginePtr cronet_engine = Cronet_Engine_Create();
-  Cronet_EngineParamsPtr engine_params = Cronet_EngineParams_Create();
-  Cronet_EngineParams_user_agent_set(engine_params, "CronetSample/1");
-  Cronet_EngineParams_enable_quic_set(engine_params, true);
-
-  Cronet_Engine_StartWithParams(cronet_engine, engine_params);
-  Cronet_EngineParams_Destroy(engine_params);
-  return cronet_engine;
-}
-
+// |response_cache|不为空时，新鲜的缓存直接返回，过期的带上ETag/Last-Modified做条件请求，
+// 服务器返回304时使用缓存的body
+// |timeout|不为0时，超时后cancel请求，WaitForDone不会一直阻塞
 void PerformRequest(Cronet_EnginePtr cronet_engine,
                     const std::string& url,
-                    Cronet_ExecutorPtr executor) {
+                    Cronet_ExecutorPtr executor,
+                    ResponseCache* response_cache = nullptr,
+                    base::TimeDelta timeout = base::TimeDelta()) {
+  ResponseCache::LookupResult cached;
+  if (response_cache)
+    cached = response_cache->Lookup(url);
+  if (cached.fresh) {
+    std::cout << "served from response cache, bytes: "
+              << cached.entry->body->size() << std::endl;
+    return;
+  }
+
   SampleUrlRequestCallback url_request_callback;
   Cronet_UrlRequestPtr request = Cronet_UrlRequest_Create();
   Cronet_UrlRequestParamsPtr request_params = Cronet_UrlRequestParams_Create();
   Cronet_UrlRequestParams_http_method_set(request_params, "GET");
+  if (cached.entry)
+    ResponseCache::AddConditionalHeaders(*cached.entry, request_params);
 
   Cronet_UrlRequest_InitWithParams(
       request, cronet_engine, url.c_str(), request_params,
       url_request_callback.GetUrlRequestCallback(), executor);
   Cronet_UrlRequestParams_Destroy(request_params);
 
+  // 重启后第一个请求的ttfb可以看出持久化的网络状态（--persist-network-state）是否生效
+  base::TimeTicks start_time = base::TimeTicks::Now();
+  base::TimeDelta time_to_first_byte;
+  url_request_callback.set_response_started_callback(
+      [start_time, &time_to_first_byte](Cronet_UrlResponseInfoPtr info) {
+        time_to_first_byte = base::TimeTicks::Now() - start_time;
+      });
   Cronet_UrlRequest_Start(request);
+  // 所有请求的超时共用一个DeadlineTimer线程，而不是每个请求一个定时器
+  std::atomic<bool> timed_out(false);
+  DeadlineTimer::TimerId timeout_timer_id = DeadlineTimer::kInvalidTimerId;
+  if (!timeout.is_zero()) {
+    timeout_timer_id = DeadlineTimer::GetInstance()->Schedule(
+        std::chrono::steady_clock::now() +
+            std::chrono::microseconds(timeout.InMicroseconds()),
+        [request, &timed_out] {
+          timed_out = true;
+          Cronet_UrlRequest_Cancel(request);
+        });
+  }
   url_request_callback.WaitForDone();
+  // 定时器回调可能正在执行，Cancel会等它返回，之后才能销毁request
+  DeadlineTimer::GetInstance()->Cancel(timeout_timer_id);
   Cronet_UrlRequest_Destroy(request);
+  std::cout << "was cached: " << url_request_callback.was_cached()
+            << " time to first byte: " << time_to_first_byte.InMilliseconds()
+            << "ms" << (timed_out ? " timed out" : "") << std::endl;
+
+  // 只有OnSucceeded才算成功，失败、超时或取消的请求body可能不完整，不能更新缓存
+  bool success = url_request_callback.succeeded();
+  if (response_cache && success) {
+    std::shared_ptr<const ResponseCache::Entry> entry = response_cache->Update(
+        url, cached.entry, url_request_callback.http_status_code(),
+        url_request_callback.response_headers(),
+        url_request_callback.TakeResponseBody());
+    if (entry) {
+      std::cout << "revalidated response cache, bytes: "
+                << entry->body->size() << std::endl;
+    }
+  }
 
   //std::cout << "Response Data:" << std::endl
   //          << url_request_callback.response_as_string() << std::endl;
 }
 
+// 上传：|upload|把数据直接读进cronet的buffer，文件通过内存映射按需加载，不会整个读进堆内存
+void PerformUpload(Cronet_EnginePtr cronet_engine,
+                   const std::string& url,
+                   Cronet_ExecutorPtr executor,
+                   const std::string& method,
+                   scoped_refptr<UploadDataProvider> upload,
+                   const std::string& content_type) {
+  SampleUrlRequestCallback url_request_callback;
+  Cronet_UrlRequestPtr request = Cronet_UrlRequest_Create();
+  Cronet_UrlRequestParamsPtr request_params = Cronet_UrlRequestParams_Create();
+  Cronet_UrlRequestParams_http_method_set(request_params, method.c_str());
+  // 有body的请求cronet要求必须有Content-Type
+  Cronet_HttpHeaderPtr header = Cronet_HttpHeader_Create();
+  Cronet_HttpHeader_name_set(header, "Content-Type");
+  Cronet_HttpHeader_value_set(header, content_type.c_str());
+  Cronet_UrlRequestParams_request_headers_add(request_params, header);
+  Cronet_HttpHeader_Destroy(header);
+  upload->AttachTo(request_params, executor);
+
+  Cronet_UrlRequest_InitWithParams(
+      request, cronet_engine, url.c_str(), request_params,
+      url_request_callback.GetUrlRequestCallback(), executor);
+  Cronet_UrlRequestParams_Destroy(request_params);
+
+  Cronet_UrlRequest_Start(request);
+  url_request_callback.WaitForDone();
+  Cronet_UrlRequest_Destroy(request);
+  std::cout << method << " " << url
+            << " status:" << url_request_callback.http_status_code()
+            << " response bytes:" << url_request_callback.response_body().size()
+            << std::endl;
+}
+
+// 下载到文件：每次read的数据在ThreadPool的MayBlock序列上写入文件，写完才继续read，
+// 内存占用只有一个buffer，与文件大小无关
+void PerformDownload(Cronet_EnginePtr cronet_engine,
+                     const std::string& url,
+                     Cronet_ExecutorPtr executor,
+                     const base::FilePath& path) {
+  base::WaitableEvent file_closed;
+  FileDownloadWriter writer(
+      path, 0, true,
+      base::BindRepeating(
+          [](base::WaitableEvent* file_closed,
+             const FileDownloadWriter::Progress& progress) {
+            if (!progress.done)
+              return;
+            std::cout << "download " << (progress.success ? "done" : "failed")
+                      << " bytes:" << progress.bytes_written << "/"
+                      << progress.total_bytes
+                      << " time:" << progress.elapsed.InMilliseconds() << "ms"
+                      << " speed:" << progress.bytes_per_second() / 1024
+                      << "KB/s" << std::endl;
+            file_closed->Signal();
+          },
+          &file_closed));
+
+  SampleUrlRequestCallback url_request_callback;
+  url_request_callback.set_body_consumer(&writer);
+  Cronet_UrlRequestPtr request = Cronet_UrlRequest_Create();
+  Cronet_UrlRequestParamsPtr request_params = Cronet_UrlRequestParams_Create();
+  Cronet_UrlRequestParams_http_method_set(request_params, "GET");
+
+  Cronet_UrlRequest_InitWithParams(
+      request, cronet_engine, url.c_str(), request_params,
+      url_request_callback.GetUrlRequestCallback(), executor);
+  Cronet_UrlRequestParams_Destroy(request_params);
+
+  Cronet_UrlRequest_Start(request);
+  url_request_callback.WaitForDone();
+  Cronet_UrlRequest_Destroy(request);
+  // 等待最后的写入完成并关闭文件
+  file_closed.Wait();
+}
+
+// 边接收边处理body：每次read的数据依次经过|chain|的各个stage（解压、按行切分、校验等），
+// 处理完buffer马上用于下一次read，body不需要整个缓存在内存里
+void PerformProcessedRequest(Cronet_EnginePtr cronet_engine,
+                             const std::string& url,
+                             Cronet_ExecutorPtr executor,
+                             BodyProcessorChain* chain) {
+  SampleUrlRequestCallback url_request_callback;
+  url_request_callback.set_verbose(false);
+  url_request_callback.set_body_consumer(chain);
+  Cronet_UrlRequestPtr request = Cronet_UrlRequest_Create();
+  Cronet_UrlRequestParamsPtr request_params = Cronet_UrlRequestParams_Create();
+  Cronet_UrlRequestParams_http_method_set(request_params, "GET");
+
+  Cronet_UrlRequest_InitWithParams(
+      request, cronet_engine, url.c_str(), request_params,
+      url_request_callback.GetUrlRequestCallback(), executor);
+  Cronet_UrlRequestParams_Destroy(request_params);
+
+  Cronet_UrlRequest_Start(request);
+  url_request_callback.WaitForDone();
+  Cronet_UrlRequest_Destroy(request);
+}
+
+// 多个请求共用一个内存预算，每个body由ThreadPool上的慢速consumer处理。consumer跟不上时
+// 暂停read，积压的数据不超过高水位，所有请求占用的buffer加起来不超过|budget|
+void PerformFlowControlledRequests(Cronet_EnginePtr cronet_engine,
+                                   const std::string& url,
+                                   Cronet_ExecutorPtr executor,
+                                   int num_requests,
+                                   MemoryBudget* budget) {
+  FlowControlledBodyStream::Options options;
+  options.high_water_mark = 256 * 1024;
+  options.low_water_mark = 64 * 1024;
+  options.budget = budget;
+
+  struct Stream {
+    std::unique_ptr<FlowControlledBodyStream> body;
+    SampleUrlRequestCallback callback;
+    Cronet_UrlRequestPtr request = nullptr;
+    base::WaitableEvent consumed;
+    uint64_t bytes = 0;
+  };
+  std::vector<std::unique_ptr<Stream>> streams;
+  for (int i = 0; i < num_requests; ++i) {
+    auto stream = std::make_unique<Stream>();
+    stream->body = std::make_unique<FlowControlledBodyStream>(options, nullptr);
+    stream->callback.set_verbose(false);
+    stream->callback.set_body_consumer(stream->body.get());
+    stream->request = Cronet_UrlRequest_Create();
+    Cronet_UrlRequestParamsPtr request_params =
+        Cronet_UrlRequestParams_Create();
+    Cronet_UrlRequestParams_http_method_set(request_params, "GET");
+    Cronet_UrlRequest_InitWithParams(
+        stream->request, cronet_engine, url.c_str(), request_params,
+        stream->callback.GetUrlRequestCallback(), executor);
+    Cronet_UrlRequestParams_Destroy(request_params);
+
+    // 每个chunk处理完马上释放，不能拿着chunk等下一个，否则预算用完后不会再释放
+    base::ThreadPool::PostTask(
+        FROM_HERE, {base::MayBlock()},
+        base::BindOnce(
+            [](Stream* stream) {
+              FlowControlledBodyStream::Chunk chunk;
+              while (stream->body->Pop(&chunk)) {
+                stream->bytes += chunk.size();
+                chunk.Reset();
+                base::PlatformThread::Sleep(base::Milliseconds(1));
+              }
+              stream->consumed.Signal();
+            },
+            stream.get()));
+    Cronet_UrlRequest_Start(stream->request);
+    streams.push_back(std::move(stream));
+  }
+
+  for (const std::unique_ptr<Stream>& stream : streams) {
+    stream->callback.WaitForDone();
+    stream->consumed.Wait();
+    Cronet_UrlRequest_Destroy(stream->request);
+    FlowControlledBodyStream::Stats stats = stream->body->GetStats();
+    std::cout << "flow controlled body "
+              << (stream->body->succeeded() ? "done" : "failed")
+              << " bytes:" << stream->bytes
+              << " peak buffered:" << stats.peak_buffered_bytes
+              << " pauses:" << stats.pauses
+              << " budget waits:" << stats.budget_waits << std::endl;
+  }
+  MemoryBudget::Stats budget_stats = budget->GetStats();
+  std::cout << "memory budget peak:" << budget_stats.peak << "/"
+            << budget_stats.limit << " waits:" << budget_stats.waits
+            << std::endl;
+}
+
+// 大文件分段下载：HEAD探测Accept-Ranges和长度，预分配文件后每段一个Range请求并发下载，
+// 直接写入文件中对应的位置，失败的段单独重试。服务器不支持Range时退化为一个普通GET
+void PerformRangeDownload(Cronet_EnginePtr cronet_engine,
+                          const std::string& url,
+                          Cronet_ExecutorPtr executor,
+                          const base::FilePath& path) {
+  RangeDownloader::Options options;
+  options.max_concurrency = 4;
+  options.segment_size = 4 * 1024 * 1024;
+  RangeDownloader downloader(cronet_engine, executor, options);
+  downloader.Start(
+      url, path, base::BindOnce([](const RangeDownloader::Result& result) {
+        std::cout << "range download " << (result.success ? "done" : "failed")
+                  << " ranges:" << result.used_ranges
+                  << " bytes:" << result.total_bytes
+                  << " segments:" << result.num_segments
+                  << " retries:" << result.num_retries
+                  << " time:" << result.elapsed.InMilliseconds() << "ms "
+                  << result.sha256 << result.error_message << std::endl;
+      }));
+  downloader.WaitForDone();
+}
+
 void TestCronet() {
   std::cout << "Cronet version: "
             << Cronet_Engine_GetVersionString(g_cronet_engine) << std::endl;
 
   std::string url("http://www.baidu.com");
   std::cout << "URL: " << url << std::endl;
-  SampleExecutor executor;
+  // 多个worker线程执行cronet回调，同一个request的回调按顺序执行
+  WorkStealingExecutor executor;
+  PerformRequest(g_cronet_engine, url, executor.GetExecutor(), nullptr,
+                 base::Seconds(10));
+  // 开启http cache（--http-cache=memory|disk）后，可缓存的资源第二次请求直接从本地返回
   PerformRequest(g_cronet_engine, url, executor.GetExecutor());
+  // cronet回调直接post到ThreadPool的序列上执行，和其他base代码共用调度和task traits，
+  // 不需要额外的线程和线程切换
+  TaskRunnerExecutor task_runner_executor({base::TaskPriority::USER_VISIBLE});
+  PerformRequest(g_cronet_engine, url, task_runner_executor.GetExecutor());
+
+  // 应用层的response cache，按url hash分片加锁，LRU淘汰
+  ResponseCache response_cache(16 * 1024 * 1024);
+  PerformRequest(g_cronet_engine, url, executor.GetExecutor(), &response_cache);
+  PerformRequest(g_cronet_engine, url, executor.GetExecutor(), &response_cache);
+  ResponseCache::ShardStats total;
+  for (const ResponseCache::ShardStats& stats : response_cache.GetStats()) {
+    total.hits += stats.hits;
+    total.misses += stats.misses;
+    total.revalidations += stats.revalidations;
+    total.evictions += stats.evictions;
+  }
+  std::cout << "response cache hits:" << total.hits
+            << " misses:" << total.misses
+            << " revalidations:" << total.revalidations
+            << " evictions:" << total.evictions << std::endl;
+
+  base::FilePath temp_dir;
+  if (base::GetTempDir(&temp_dir)) {
+    PerformDownload(g_cronet_engine, url, executor.GetExecutor(),
+                    temp_dir.AppendASCII("akama-sdk-download.html"));
+    PerformRangeDownload(g_cronet_engine, url, executor.GetExecutor(),
+                         temp_dir.AppendASCII("akama-sdk-range-download.html"));
+  }
+
+  // 按行处理response并计算crc32，gzip文件等cronet不会自动解压的内容可以在前面加
+  // InflateProcessor
+  BodyProcessorChain chain;
+  LineSplitter* lines = chain.AddStage<LineSplitter>(
+      [](std::string_view line) { return true; });
+  Crc32Checksum* crc32 = chain.AddStage<Crc32Checksum>();
+  PerformProcessedRequest(g_cronet_engine, url, executor.GetExecutor(), &chain);
+  std::cout << "processed body " << (chain.succeeded() ? "done" : "failed")
+            << " lines:" << lines->num_lines() << " bytes:" << crc32->size()
+            << " crc32:" << std::hex << crc32->value() << std::dec << " "
+            << chain.error_message() << std::endl;
+
+  // 4个请求共用512KB的预算
+  MemoryBudget budget(512 * 1024);
+  PerformFlowControlledRequests(g_cronet_engine, url, executor.GetExecutor(), 4,
+                                &budget);
+}
+
+void TestUpload() {
+  WorkStealingExecutor executor;
+  const std::string url("https://httpbin.org/anything");
+
+  // 内存映射文件上传，长度已知，重定向时可以rewind
+  base::FilePath upload_path;
+  if (base::CreateTemporaryFile(&upload_path) &&
+      base::WriteFile(upload_path, std::string(1024 * 1024, 'a'))) {
+    base::WaitableEvent file_unmapped;
+    scoped_refptr<SegmentsUploadDataProvider> file_upload =
+        SegmentsUploadDataProvider::CreateFromFile(
+            upload_path, base::BindOnce(&base::WaitableEvent::Signal,
+                                        base::Unretained(&file_unmapped)));
+    if (file_upload) {
+      PerformUpload(g_cronet_engine, url, executor.GetExecutor(), "PUT",
+                    std::move(file_upload), "application/octet-stream");
+      // 请求结束后cronet才关闭provider，解除映射以后才能删除文件
+      file_unmapped.Wait();
+    }
+    base::DeleteFile(upload_path);
+  }
+
+  // 长度未知时用chunked编码，数据可以在请求过程中从任意线程追加
+  scoped_refptr<ChunkedUploadDataProvider> chunked_upload =
+      ChunkedUploadDataProvider::Create();
+  base::ThreadPool::PostTask(
+      FROM_HERE, base::BindOnce(
+                     [](scoped_refptr<ChunkedUploadDataProvider> upload) {
+                       for (int i = 0; i < 4; ++i)
+                         upload->Append("chunk " + base::NumberToString(i));
+                       upload->Finish();
+                     },
+                     chunked_upload));
+  PerformUpload(g_cronet_engine, url, executor.GetExecutor(), "POST",
+                std::move(chunked_upload), "text/plain");
+}
+
+void TestBulkFetch() {
+  std::vector<std::string> urls;
+  for (int i = 0; i < 8; ++i)
+    urls.push_back("http://www.baidu.com/?q=" + base::NumberToString(i));
+
+  // 最多同时有4个请求，每个请求结束时通过回调通知结果，不阻塞调用者
+  WorkStealingExecutor executor;
+  ResponseCache response_cache(16 * 1024 * 1024);
+  BulkFetcher fetcher(g_cronet_engine, &executor, 4);
+  fetcher.set_response_cache(&response_cache);
+  // 单个请求5秒超时，整批15秒超时；请求耗时超过已完成请求的p90时再发一个相同的请求，
+  // 先完成的生效，另一个被cancel，少数慢请求不会拖长整批的耗时
+  fetcher.set_request_timeout(std::chrono::seconds(5));
+  fetcher.set_batch_timeout(std::chrono::seconds(15));
+  fetcher.set_hedging(90, 4);
+  fetcher.Fetch(
+      std::move(urls),
+      [](BulkFetcher::Result result) {
+        std::cout << "fetched " << result.url
+                  << " status:" << result.http_status_code
+                  << " cached:" << result.was_cached
+                  << " response cache:" << result.from_response_cache
+                  << " timed out:" << result.timed_out
+                  << " hedged:" << result.hedged
+                  << " hedge won:" << result.hedge_won
+                  << " bytes:" << result.body->size() << " latency:"
+                  << std::chrono::duration_cast<std::chrono::milliseconds>(
+                         result.latency)
+                         .count()
+                  << "ms " << result.error_message << std::endl;
+      },
+      []() { std::cout << "bulk fetch done" << std::endl; });
+  fetcher.WaitForDone();
+
+  // 读取response用的buffer来自进程级的BufferPool
+  BufferPool::Stats stats = BufferPool::GetInstance()->GetStats();
+  std::cout << "buffer pool hit rate:" << stats.hit_rate()
+            << " outstanding buffers:" << stats.outstanding_buffers
+            << " outstanding bytes:" << stats.outstanding_bytes
+            << " cached bytes:" << stats.cached_bytes << std::endl;
+}
+
+void TestCoalescing() {
+  // 同一个url的并发GET合并成一个cronet请求，所有调用者共享同一个response（不拷贝body）
+  WorkStealingExecutor executor;
+  RequestCoalescer::Options options;
+  options.key_headers.push_back("Accept-Language");
+  RequestCoalescer coalescer(g_cronet_engine, &executor, options);
+
+  const int kNumRequests = 8;
+  base::WaitableEvent all_done;
+  std::atomic<int> num_pending(kNumRequests);
+  for (int i = 0; i < kNumRequests; ++i) {
+    coalescer.Get(
+        "http://www.baidu.com", {{"Accept-Language", "zh-CN"}},
+        [&all_done, &num_pending](
+            std::shared_ptr<const RequestCoalescer::Response> response) {
+          std::cout << "coalesced response status:"
+                    << response->http_status_code
+                    << " bytes:" << response->body->size() << std::endl;
+          if (--num_pending == 0)
+            all_done.Signal();
+        });
+  }
+  all_done.Wait();
+
+  RequestCoalescer::Stats stats = coalescer.GetStats();
+  std::cout << "coalescer requests:" << stats.requests
+            << " flights:" << stats.flights << " saved:" << stats.coalesced
+            << std::endl;
 }
 
 // Callback
@@ -227,7 +642,39 @@ void TestThread() {
 int main(int argc, char *argv[]) {
   std::cout << "start demo:" << base::Time::Now() << std::endl;
 
-  g_cronet_engine = CreateCronetEngine();
+  // engine配置来自命令行参数或者--engine-config指定的json文件，见EngineProfile
+  base::CommandLine::Init(argc, argv);
+  EngineProfile engine_profile;
+  if (!EngineProfile::FromCommandLine(*base::CommandLine::ForCurrentProcess(),
+                                      &engine_profile)) {
+    return 1;
+  }
+  g_cronet_engine = CreateCronetEngine(engine_profile);
+  if (!g_cronet_engine)
+    return 1;
+  // 统计每个请求的dns/connect/ssl/ttfb等耗时，按host和协议汇总到无锁直方图
+  RequestMetricsCollector request_metrics;
+  request_metrics.Attach(g_cronet_engine);
+
+  // 预热：engine启动后并行请求--warm-up-origins中的每个origin，提前完成dns、建连和tls握手，
+  // 后面的请求复用连接。最多等待2秒，超时后预热在后台继续
+  WorkStealingExecutor warm_up_executor;
+  EngineWarmUp warm_up(g_cronet_engine, &warm_up_executor);
+  if (!engine_profile.warm_up_origins.empty()) {
+    warm_up.Start(engine_profile.warm_up_origins);
+    bool finished = warm_up.WaitUntil(std::chrono::steady_clock::now() +
+                                      std::chrono::seconds(2));
+    for (const EngineWarmUp::OriginResult& result : warm_up.GetResults()) {
+      std::cout << "warm up " << result.origin << " "
+                << (result.success ? "done" : "failed") << " in "
+                << std::chrono::duration_cast<std::chrono::milliseconds>(
+                       result.latency)
+                       .count()
+                << "ms" << std::endl;
+    }
+    if (!finished)
+      std::cout << "warm up timed out" << std::endl;
+  }
 
   // ThreadPool
   // cronet会初始化线程池，这里不自己做初始化了
@@ -237,6 +684,12 @@ int main(int argc, char *argv[]) {
   std::cout << std::endl << "***********************" << std::endl << std::endl;
   TestCronet();
   std::cout << std::endl << "***********************" << std::endl << std::endl;
+  TestBulkFetch();
+  std::cout << std::endl << "***********************" << std::endl << std::endl;
+  TestUpload();
+  std::cout << std::endl << "***********************" << std::endl << std::endl;
+  TestCoalescing();
+  std::cout << std::endl << "***********************" << std::endl << std::endl;
   TestCallback();
   std::cout << std::endl << "***********************" << std::endl << std::endl;
   TestThread();
@@ -261,6 +714,10 @@ int main(int argc, char *argv[]) {
   
   run_loop.Run();
 
+  std::cout << "request metrics:" << request_metrics.GetSnapshotAsJson()
+            << std::endl;
+  warm_up.Cancel();
+  request_metrics.Detach();
   Cronet_Engine_Shutdown(g_cronet_engine);
   Cronet_Engine_Destroy(g_cronet_engine);
 
@@ -0,0 +1,502 @@
+#include "range_downloader.h"
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <utility>
+
+#include "base/bind.h"
+#include "base/files/file.h"
+#include "base/strings/number_conversions.h"
+#include "base/strings/string_util.h"
+#include "base/task/task_traits.h"
+#include "base/task/thread_pool.h"
+#include "crypto/secure_hash.h"
+#include "crypto/sha2.h"
+#include "cronet/response_body_consumer.h"
+#include "cronet/response_headers.h"
+#include "cronet/sample_url_request_callback.h"
+#include "file_download_writer.h"
+
+namespace {
+
+// Size of the reads of the checksum.
+constexpr int kChecksumReadSize = 1024 * 1024;
+
+void AddRequestHeader(Cronet_UrlRequestParamsPtr request_params,
+                      const std::string& name,
+                      const std::string& value) {
+  Cronet_HttpHeaderPtr header = Cronet_HttpHeader_Create();
+  Cronet_HttpHeader_name_set(header, name.c_str());
+  Cronet_HttpHeader_value_set(header, value.c_str());
+  Cronet_UrlRequestParams_request_headers_add(request_params, header);
+  Cronet_HttpHeader_Destroy(header);
+}
+
+}  // namespace
+
+// Only looks at the headers, the body of a HEAD response is empty.
+struct RangeDownloader::Probe : public ResponseBodyConsumer {
+  Probe() : request(Cronet_UrlRequest_Create()) {}
+  Probe(const Probe&) = delete;
+  Probe& operator=(const Probe&) = delete;
+  ~Probe() override { Cronet_UrlRequest_Destroy(request); }
+
+  // ResponseBodyConsumer:
+  void OnResponseStarted(Cronet_UrlResponseInfoPtr info) override {
+    content_length = GetContentLength(info);
+    std::string value;
+    // The length of an encoded body is not the one the ranges address.
+    encoded = FindResponseHeader(info, "Content-Encoding", &value) &&
+              !base::EqualsCaseInsensitiveASCII(value, "identity");
+    accepts_ranges =
+        FindResponseHeader(info, "Accept-Ranges", &value) &&
+        base::ToLowerASCII(value).find("bytes") != std::string::npos;
+    // If-Range only takes a strong ETag or a date.
+    if (FindResponseHeader(info, "ETag", &value) &&
+        !base::StartsWith(value, "W/")) {
+      validator = value;
+    } else if (FindResponseHeader(info, "Last-Modified", &value)) {
+      validator = value;
+    }
+  }
+  void OnBodyRead(Cronet_BufferPtr buffer,
+                  uint64_t bytes_read,
+                  ReadNext read_next) override {
+    read_next(buffer);
+  }
+
+  SampleUrlRequestCallback callback;
+  Cronet_UrlRequestPtr const request;
+  int64_t content_length = -1;
+  bool encoded = false;
+  bool accepts_ranges = false;
+  std::string validator;
+};
+
+// Streams one range into the file through a FileDownloadWriter. Done once
+// both the request and the writer are, the Cronet request is destroyed as
+// soon as it is done, from its own callback.
+class RangeDownloader::SegmentRequest : public ResponseBodyConsumer {
+ public:
+  SegmentRequest(RangeDownloader* owner,
+                 size_t index,
+                 const Segment& segment,
+                 bool use_range,
+                 const base::FilePath& path)
+      : owner_(owner),
+        index_(index),
+        offset_(segment.offset),
+        length_(segment.length),
+        use_range_(use_range),
+        writer_(path,
+                segment.offset,
+                false,
+                base::BindRepeating(&SegmentRequest::OnWriteProgress,
+                                    base::Unretained(this))),
+        callback_(std::make_unique<SampleUrlRequestCallback>()),
+        request_(Cronet_UrlRequest_Create()) {
+    callback_->set_verbose(false);
+    callback_->set_body_consumer(this);
+    callback_->set_done_callback(
+        [this](bool success) { OnRequestDone(success); });
+  }
+  SegmentRequest(const SegmentRequest&) = delete;
+  SegmentRequest& operator=(const SegmentRequest&) = delete;
+  ~SegmentRequest() override = default;
+
+  size_t index() const { return index_; }
+  // Set if the attempt failed.
+  const std::string& error_message() const { return error_message_; }
+
+  void Start(Cronet_EnginePtr engine,
+             Cronet_ExecutorPtr executor,
+             const std::string& url,
+             const std::string& validator) {
+    Cronet_UrlRequestParamsPtr request_params =
+        Cronet_UrlRequestParams_Create();
+    Cronet_UrlRequestParams_http_method_set(request_params, "GET");
+    if (use_range_) {
+      AddRequestHeader(request_params, "Range",
+                       "bytes=" + base::NumberToString(offset_) + "-" +
+                           base::NumberToString(offset_ + length_ - 1));
+      if (!validator.empty())
+        AddRequestHeader(request_params, "If-Range", validator);
+    }
+
+    base::AutoLock auto_lock(lock_);
+    Cronet_UrlRequest_InitWithParams(request_, engine, url.c_str(),
+                                     request_params,
+                                     callback_->GetUrlRequestCallback(),
+                                     executor);
+    Cronet_UrlRequestParams_Destroy(request_params);
+    Cronet_UrlRequest_Start(request_);
+  }
+
+  void Cancel() {
+    base::AutoLock auto_lock(lock_);
+    if (request_)
+      Cronet_UrlRequest_Cancel(request_);
+  }
+
+  // ResponseBodyConsumer:
+  void OnResponseStarted(Cronet_UrlResponseInfoPtr info) override {
+    // A 200 to a range request carries the whole object, which must not be
+    // written at the offset of the segment.
+    const int http_status_code =
+        Cronet_UrlResponseInfo_http_status_code_get(info);
+    if (http_status_code != (use_range_ ? 206 : 200)) {
+      error_message_ =
+          "Unexpected HTTP status " + base::NumberToString(http_status_code);
+      return;
+    }
+    writer_.OnResponseStarted(info);
+  }
+
+  void OnBodyRead(Cronet_BufferPtr buffer,
+                  uint64_t bytes_read,
+                  ReadNext read_next) override {
+    bytes_received_ += static_cast<int64_t>(bytes_read);
+    if (error_message_.empty() && length_ >= 0 && bytes_received_ > length_)
+      error_message_ = "Response longer than the segment";
+    if (!error_message_.empty()) {
+      Cronet_Buffer_Destroy(buffer);
+      read_next(nullptr);
+      return;
+    }
+    writer_.OnBodyRead(buffer, bytes_read, std::move(read_next));
+  }
+
+  void OnBodyComplete(bool success) override {
+    // Closes the file in any case.
+    writer_.OnBodyComplete(success && error_message_.empty());
+  }
+
+ private:
+  void OnRequestDone(bool success) {
+    if (error_message_.empty() && !success) {
+      error_message_ = callback_->last_error_message().empty()
+                           ? "Canceled"
+                           : callback_->last_error_message();
+    }
+    {
+      base::AutoLock auto_lock(lock_);
+      Cronet_UrlRequest_Destroy(request_);
+      request_ = nullptr;
+    }
+    // Allowed from within its callback.
+    callback_.reset();
+    OnPartDone();
+  }
+
+  void OnWriteProgress(const FileDownloadWriter::Progress& progress) {
+    if (!progress.done)
+      return;
+    write_success_ = progress.success;
+    bytes_written_ = progress.bytes_written;
+    OnPartDone();
+  }
+
+  // Called once by the request and once by the writer, in any order and on
+  // different threads.
+  void OnPartDone() {
+    if (--num_parts_pending_ != 0)
+      return;
+    if (error_message_.empty() && !write_success_)
+      error_message_ = "Write failed";
+    if (error_message_.empty() && length_ >= 0 && bytes_written_ != length_)
+      error_message_ = "Response shorter than the segment";
+    // Deletes |this|.
+    owner_->OnSegmentRequestDone(this, error_message_.empty());
+  }
+
+  RangeDownloader* const owner_;
+  const size_t index_;
+  const int64_t offset_;
+  const int64_t length_;
+  const bool use_range_;
+  FileDownloadWriter writer_;
+  std::unique_ptr<SampleUrlRequestCallback> callback_;
+
+  // Guards |request_| between Cancel() and its destruction.
+  base::Lock lock_;
+  Cronet_UrlRequestPtr request_ GUARDED_BY(lock_);
+
+  // Written by the Cronet callbacks, which run in order.
+  std::string error_message_;
+  int64_t bytes_received_ = 0;
+  // Written on the file sequence.
+  bool write_success_ = false;
+  int64_t bytes_written_ = 0;
+  // Orders the writes above before OnPartDone() of the last part.
+  std::atomic<int> num_parts_pending_{2};
+};
+
+RangeDownloader::Options::Options() = default;
+RangeDownloader::Options::Options(const Options&) = default;
+RangeDownloader::Options::~Options() = default;
+
+RangeDownloader::Result::Result() = default;
+RangeDownloader::Result::Result(const Result&) = default;
+RangeDownloader::Result& RangeDownloader::Result::operator=(const Result&) =
+    default;
+RangeDownloader::Result::~Result() = default;
+
+RangeDownloader::RangeDownloader(Cronet_EnginePtr engine,
+                                 Cronet_ExecutorPtr executor,
+                                 const Options& options)
+    : engine_(engine), executor_(executor), options_(options) {}
+
+RangeDownloader::~RangeDownloader() {
+  if (!started_)
+    return;
+  Cancel();
+  WaitForDone();
+}
+
+void RangeDownloader::Start(const std::string& url,
+                            const base::FilePath& path,
+                            DoneCallback done_callback) {
+  DCHECK(!started_);
+  started_ = true;
+  url_ = url;
+  path_ = path;
+  done_callback_ = std::move(done_callback);
+  start_time_ = base::TimeTicks::Now();
+
+  // Deleted by its done callback.
+  Probe* probe = new Probe;
+  probe->callback.set_verbose(false);
+  probe->callback.set_body_consumer(probe);
+  probe->callback.set_done_callback(
+      [this, probe](bool success) { OnProbeDone(probe, success); });
+
+  Cronet_UrlRequestParamsPtr request_params = Cronet_UrlRequestParams_Create();
+  Cronet_UrlRequestParams_http_method_set(request_params, "HEAD");
+  // The Range requests are sent without compression, the probe must see the
+  // length of the same representation.
+  AddRequestHeader(request_params, "Accept-Encoding", "identity");
+  Cronet_UrlRequest_InitWithParams(probe->request, engine_, url_.c_str(),
+                                   request_params,
+                                   probe->callback.GetUrlRequestCallback(),
+                                   executor_);
+  Cronet_UrlRequestParams_Destroy(request_params);
+
+  base::AutoLock auto_lock(lock_);
+  probe_request_ = probe->request;
+  Cronet_UrlRequest_Start(probe->request);
+}
+
+void RangeDownloader::Cancel() {
+  base::AutoLock auto_lock(lock_);
+  canceled_ = true;
+  if (probe_request_)
+    Cronet_UrlRequest_Cancel(probe_request_);
+  for (SegmentRequest* request : in_flight_)
+    request->Cancel();
+}
+
+void RangeDownloader::WaitForDone() {
+  done_.Wait();
+}
+
+void RangeDownloader::OnProbeDone(Probe* probe, bool success) {
+  const int http_status_code = probe->callback.http_status_code();
+  std::string error_message = probe->callback.last_error_message();
+  int64_t total_bytes = -1;
+  bool use_ranges = false;
+  // A server that still encoded the response gets a single GET of unknown
+  // length.
+  if (success && http_status_code / 100 == 2 && !probe->encoded) {
+    total_bytes = probe->content_length;
+    use_ranges = probe->accepts_ranges && total_bytes > 0;
+    validator_ = probe->validator;
+  }
+  {
+    base::AutoLock auto_lock(lock_);
+    probe_request_ = nullptr;
+  }
+  // Destroys the request from within its callback.
+  delete probe;
+
+  bool failed;
+  {
+    base::AutoLock auto_lock(lock_);
+    // Servers refusing HEAD may still serve the object with a plain GET, only
+    // a network error fails the download.
+    failed = canceled_ || (!success && http_status_code == 0);
+    if (failed) {
+      result_.error_message = canceled_ ? "Canceled" : error_message;
+      finishing_ = true;
+    } else {
+      result_.used_ranges = use_ranges;
+      result_.total_bytes = total_bytes;
+      if (use_ranges) {
+        const int64_t segment_size =
+            std::max<int64_t>(1, options_.segment_size);
+        for (int64_t offset = 0; offset < total_bytes;
+             offset += segment_size) {
+          Segment segment;
+          segment.offset = offset;
+          segment.length = std::min(segment_size, total_bytes - offset);
+          segments_.push_back(segment);
+        }
+      } else {
+        Segment segment;
+        segment.length = total_bytes;
+        segments_.push_back(segment);
+      }
+      result_.num_segments = segments_.size();
+      for (size_t i = 0; i < segments_.size(); ++i)
+        pending_segments_.push_back(i);
+    }
+  }
+  if (failed) {
+    Finish();
+    return;
+  }
+  base::ThreadPool::PostTask(
+      FROM_HERE, {base::MayBlock(), base::TaskPriority::USER_VISIBLE},
+      base::BindOnce(&RangeDownloader::PreallocateAndStart,
+                     base::Unretained(this), total_bytes));
+}
+
+void RangeDownloader::PreallocateAndStart(int64_t total_bytes) {
+  // Every segment then writes into its own slot, and a full disk fails here
+  // rather than halfway through the download.
+  base::File file(path_,
+                  base::File::FLAG_CREATE_ALWAYS | base::File::FLAG_WRITE);
+  if (!file.IsValid() || !file.SetLength(std::max<int64_t>(0, total_bytes))) {
+    base::AutoLock auto_lock(lock_);
+    result_.error_message = "Can't create " + path_.AsUTF8Unsafe();
+  }
+  file.Close();
+  StartSegments();
+}
+
+void RangeDownloader::StartSegments() {
+  std::vector<SegmentRequest*> requests;
+  bool finish = false;
+  {
+    base::AutoLock auto_lock(lock_);
+    while (!canceled_ && result_.error_message.empty() &&
+           in_flight_.size() < std::max<size_t>(1, options_.max_concurrency) &&
+           !pending_segments_.empty()) {
+      const size_t index = pending_segments_.front();
+      pending_segments_.pop_front();
+      Segment& segment = segments_[index];
+      ++segment.attempts;
+      SegmentRequest* request = new SegmentRequest(
+          this, index, segment, result_.used_ranges, path_);
+      in_flight_.push_back(request);
+      requests.push_back(request);
+    }
+    if (in_flight_.empty() && !finishing_) {
+      finishing_ = true;
+      finish = true;
+    }
+  }
+
+  for (SegmentRequest* request : requests)
+    request->Start(engine_, executor_, url_, validator_);
+  if (!requests.empty()) {
+    // Cancel() may have run before the requests were started.
+    base::AutoLock auto_lock(lock_);
+    if (canceled_) {
+      for (SegmentRequest* request : requests) {
+        if (std::find(in_flight_.begin(), in_flight_.end(), request) !=
+            in_flight_.end()) {
+          request->Cancel();
+        }
+      }
+    }
+  }
+  if (finish)
+    Finish();
+}
+
+void RangeDownloader::OnSegmentRequestDone(SegmentRequest* request,
+                                           bool success) {
+  {
+    base::AutoLock auto_lock(lock_);
+    in_flight_.erase(
+        std::find(in_flight_.begin(), in_flight_.end(), request));
+    const size_t index = request->index();
+    if (success) {
+      ++num_done_segments_;
+    } else if (canceled_) {
+      if (result_.error_message.empty())
+        result_.error_message = "Canceled";
+    } else if (!result_.error_message.empty()) {
+      // Canceled because the download already failed, not a retry.
+    } else if (segments_[index].attempts <= options_.max_retries_per_segment) {
+      // Retried before the segments not started yet, the download can't end
+      // without it.
+      pending_segments_.push_front(index);
+      ++result_.num_retries;
+    } else if (result_.error_message.empty()) {
+      result_.error_message = "Segment " + base::NumberToString(index) +
+                              " failed: " + request->error_message();
+      // The download can't succeed any more.
+      for (SegmentRequest* other : in_flight_)
+        other->Cancel();
+    }
+  }
+  delete request;
+  StartSegments();
+}
+
+void RangeDownloader::Finish() {
+  Result result;
+  {
+    base::AutoLock auto_lock(lock_);
+    result_.success = result_.error_message.empty() &&
+                      num_done_segments_ == segments_.size();
+    result = result_;
+  }
+  if (!result.success || options_.expected_sha256.empty()) {
+    Report(std::move(result));
+    return;
+  }
+  // Hashing a large file would hold up a Cronet callback thread.
+  base::ThreadPool::PostTask(
+      FROM_HERE, {base::MayBlock(), base::TaskPriority::USER_VISIBLE},
+      base::BindOnce(&RangeDownloader::VerifyChecksumAndReport,
+                     base::Unretained(this), std::move(result)));
+}
+
+void RangeDownloader::VerifyChecksumAndReport(Result result) {
+  base::File file(path_, base::File::FLAG_OPEN | base::File::FLAG_READ);
+  std::unique_ptr<crypto::SecureHash> hash =
+      crypto::SecureHash::Create(crypto::SecureHash::SHA256);
+  std::vector<char> buffer(kChecksumReadSize);
+  int bytes_read = -1;
+  while (file.IsValid()) {
+    bytes_read = file.ReadAtCurrentPos(buffer.data(), kChecksumReadSize);
+    if (bytes_read <= 0)
+      break;
+    hash->Update(buffer.data(), bytes_read);
+  }
+  if (bytes_read < 0) {
+    result.success = false;
+    result.error_message = "Can't read " + path_.AsUTF8Unsafe();
+    Report(std::move(result));
+    return;
+  }
+
+  uint8_t digest[crypto::kSHA256Length];
+  hash->Finish(digest, sizeof(digest));
+  result.sha256 = base::ToLowerASCII(base::HexEncode(digest, sizeof(digest)));
+  if (result.sha256 != base::ToLowerASCII(options_.expected_sha256)) {
+    result.success = false;
+    result.error_message = "SHA-256 mismatch";
+  }
+  Report(std::move(result));
+}
+
+void RangeDownloader::Report(Result result) {
+  result.elapsed = base::TimeTicks::Now() - start_time_;
+  if (done_callback_)
+    std::move(done_callback_).Run(result);
+  done_.Signal();
+}
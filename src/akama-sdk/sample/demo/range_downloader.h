@@ -0,0 +1,144 @@
+#ifndef AKAMA_SDK_SAMPLE_DEMO_RANGE_DOWNLOADER_H_
+#define AKAMA_SDK_SAMPLE_DEMO_RANGE_DOWNLOADER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "base/callback.h"
+#include "base/containers/circular_deque.h"
+#include "base/files/file_path.h"
+#include "base/synchronization/lock.h"
+#include "base/synchronization/waitable_event.h"
+#include "base/thread_annotations.h"
+#include "base/time/time.h"
+#include "components/cronet/native/include/cronet_c.h"
+
+// Downloads one large object over several concurrent byte-range requests on
+// a shared engine, so it is not limited by the throughput of one stream.
+//
+// A HEAD request first checks the Accept-Ranges and the length of the object.
+// The output file is then preallocated, the object is split into segments and
+// every segment is streamed by a FileDownloadWriter straight into its slot of
+// the file. A failed segment is retried on its own. The segment requests
+// carry If-Range with the validator of the probe, so an object changing
+// during the download fails it instead of mixing two versions. Servers
+// without range support, or that encode the response to the probe despite its
+// Accept-Encoding: identity, get a single plain GET.
+class RangeDownloader {
+ public:
+  struct Options {
+    Options();
+    Options(const Options&);
+    ~Options();
+
+    size_t max_concurrency = 4;
+    int64_t segment_size = 8 * 1024 * 1024;
+    // Attempts of a segment after the first one before the download fails.
+    int max_retries_per_segment = 3;
+    // SHA-256 of the whole object in hex, checked once the file is written.
+    // Empty to skip the check.
+    std::string expected_sha256;
+  };
+
+  struct Result {
+    Result();
+    Result(const Result&);
+    Result& operator=(const Result&);
+    ~Result();
+
+    bool success = false;
+    // False if the server does not support ranges and the object was fetched
+    // with one request.
+    bool used_ranges = false;
+    // Length of the object, or -1 if it is unknown.
+    int64_t total_bytes = -1;
+    size_t num_segments = 0;
+    size_t num_retries = 0;
+    // SHA-256 of the file in hex, computed only if one was expected.
+    std::string sha256;
+    std::string error_message;
+    base::TimeDelta elapsed;
+  };
+  // Run once on a ThreadPool or executor thread.
+  using DoneCallback = base::OnceCallback<void(const Result& result)>;
+
+  // |engine| and |executor| must outlive |this|.
+  RangeDownloader(Cronet_EnginePtr engine,
+                  Cronet_ExecutorPtr executor,
+                  const Options& options);
+  RangeDownloader(const RangeDownloader&) = delete;
+  RangeDownloader& operator=(const RangeDownloader&) = delete;
+  // Cancels the download and waits for it.
+  ~RangeDownloader();
+
+  // Downloads |url| to |path|, replacing the file. Can be called once, before
+  // Cancel().
+  void Start(const std::string& url,
+             const base::FilePath& path,
+             DoneCallback done_callback);
+
+  // Cancels the requests in flight. The download completes as failed.
+  void Cancel();
+
+  // Waits until the done callback returned.
+  void WaitForDone();
+
+ private:
+  // One attempt at one segment.
+  class SegmentRequest;
+
+  struct Segment {
+    int64_t offset = 0;
+    // -1 for the whole object of unknown length.
+    int64_t length = -1;
+    int attempts = 0;
+  };
+
+  // The HEAD request sent by Start().
+  struct Probe;
+
+  void OnProbeDone(Probe* probe, bool success);
+  // Runs on a MayBlock ThreadPool sequence, then starts the segments.
+  void PreallocateAndStart(int64_t total_bytes);
+  // Starts segments until |options_.max_concurrency| are in flight.
+  void StartSegments();
+  void OnSegmentRequestDone(SegmentRequest* request, bool success);
+  // Checks the hash if asked to, then reports the result.
+  void Finish();
+  // Runs on a MayBlock ThreadPool sequence.
+  void VerifyChecksumAndReport(Result result);
+  void Report(Result result);
+
+  Cronet_EnginePtr const engine_;
+  Cronet_ExecutorPtr const executor_;
+  const Options options_;
+
+  // Set by Start().
+  bool started_ = false;
+  std::string url_;
+  base::FilePath path_;
+  DoneCallback done_callback_;
+  base::TimeTicks start_time_;
+  // ETag or Last-Modified of the probe, sent in If-Range.
+  std::string validator_;
+
+  base::Lock lock_;
+  Result result_ GUARDED_BY(lock_);
+  // HEAD request while it runs.
+  Cronet_UrlRequestPtr probe_request_ GUARDED_BY(lock_) = nullptr;
+  std::vector<Segment> segments_ GUARDED_BY(lock_);
+  // Indices of the segments waiting to be started, retries first.
+  base::circular_deque<size_t> pending_segments_ GUARDED_BY(lock_);
+  std::vector<SegmentRequest*> in_flight_ GUARDED_BY(lock_);
+  // Segments written completely.
+  size_t num_done_segments_ GUARDED_BY(lock_) = 0;
+  bool canceled_ GUARDED_BY(lock_) = false;
+  // Set once the outcome is known and no request is left.
+  bool finishing_ GUARDED_BY(lock_) = false;
+
+  base::WaitableEvent done_;
+};
+
+#endif  // AKAMA_SDK_SAMPLE_DEMO_RANGE_DOWNLOADER_H_
@@ -0,0 +1,235 @@
+#include "upload_data_provider.h"
+
+#include <algorithm>
+#include <cstring>
+#include <utility>
+
+#include "base/logging.h"
+
+UploadDataProvider::UploadDataProvider()
+    : provider_(Cronet_UploadDataProvider_CreateWith(
+          UploadDataProvider::GetLength,
+          UploadDataProvider::Read,
+          UploadDataProvider::Rewind,
+          UploadDataProvider::Close)) {
+  Cronet_UploadDataProvider_SetClientContext(provider_, this);
+}
+
+UploadDataProvider::~UploadDataProvider() {
+  Cronet_UploadDataProvider_Destroy(provider_);
+}
+
+void UploadDataProvider::AttachTo(Cronet_UrlRequestParamsPtr request_params,
+                                  Cronet_ExecutorPtr executor) {
+  // Released in Close().
+  AddRef();
+  Cronet_UrlRequestParams_upload_data_provider_set(request_params, provider_);
+  Cronet_UrlRequestParams_upload_data_provider_executor_set(request_params,
+                                                            executor);
+}
+
+/* static */
+UploadDataProvider* UploadDataProvider::GetThis(
+    Cronet_UploadDataProviderPtr self) {
+  return static_cast<UploadDataProvider*>(
+      Cronet_UploadDataProvider_GetClientContext(self));
+}
+
+/* static */
+int64_t UploadDataProvider::GetLength(Cronet_UploadDataProviderPtr self) {
+  return GetThis(self)->GetLength();
+}
+
+/* static */
+void UploadDataProvider::Read(Cronet_UploadDataProviderPtr self,
+                              Cronet_UploadDataSinkPtr sink,
+                              Cronet_BufferPtr buffer) {
+  GetThis(self)->Read(sink, buffer);
+}
+
+/* static */
+void UploadDataProvider::Rewind(Cronet_UploadDataProviderPtr self,
+                                Cronet_UploadDataSinkPtr sink) {
+  GetThis(self)->Rewind(sink);
+}
+
+/* static */
+void UploadDataProvider::Close(Cronet_UploadDataProviderPtr self) {
+  UploadDataProvider* provider = GetThis(self);
+  provider->OnClosed();
+  provider->Release();
+}
+
+/* static */
+scoped_refptr<SegmentsUploadDataProvider> SegmentsUploadDataProvider::Create(
+    std::vector<base::span<const uint8_t>> segments,
+    base::OnceClosure on_closed) {
+  return base::WrapRefCounted(new SegmentsUploadDataProvider(
+      std::move(segments), std::move(on_closed)));
+}
+
+/* static */
+scoped_refptr<SegmentsUploadDataProvider>
+SegmentsUploadDataProvider::CreateFromFile(const base::FilePath& path,
+                                           base::OnceClosure on_closed) {
+  auto mapped_file = std::make_unique<base::MemoryMappedFile>();
+  if (!mapped_file->Initialize(path)) {
+    LOG(ERROR) << "Failed to map " << path;
+    return nullptr;
+  }
+  std::vector<base::span<const uint8_t>> segments;
+  segments.emplace_back(mapped_file->data(), mapped_file->length());
+  scoped_refptr<SegmentsUploadDataProvider> provider =
+      Create(std::move(segments), std::move(on_closed));
+  provider->mapped_file_ = std::move(mapped_file);
+  return provider;
+}
+
+SegmentsUploadDataProvider::SegmentsUploadDataProvider(
+    std::vector<base::span<const uint8_t>> segments,
+    base::OnceClosure on_closed)
+    : segments_(std::move(segments)), on_closed_(std::move(on_closed)) {
+  for (const base::span<const uint8_t>& segment : segments_)
+    length_ += segment.size();
+}
+
+SegmentsUploadDataProvider::~SegmentsUploadDataProvider() = default;
+
+int64_t SegmentsUploadDataProvider::GetLength() {
+  return length_;
+}
+
+void SegmentsUploadDataProvider::Read(Cronet_UploadDataSinkPtr sink,
+                                      Cronet_BufferPtr buffer) {
+  uint8_t* dest = static_cast<uint8_t*>(Cronet_Buffer_GetData(buffer));
+  const size_t size = Cronet_Buffer_GetSize(buffer);
+  size_t bytes_read = 0;
+  while (bytes_read < size && segment_index_ < segments_.size()) {
+    base::span<const uint8_t> segment = segments_[segment_index_];
+    size_t n = std::min(size - bytes_read, segment.size() - segment_offset_);
+    memcpy(dest + bytes_read, segment.data() + segment_offset_, n);
+    bytes_read += n;
+    segment_offset_ += n;
+    if (segment_offset_ == segment.size()) {
+      ++segment_index_;
+      segment_offset_ = 0;
+    }
+  }
+  Cronet_UploadDataSink_OnReadSucceeded(sink, bytes_read, false);
+}
+
+void SegmentsUploadDataProvider::Rewind(Cronet_UploadDataSinkPtr sink) {
+  segment_index_ = 0;
+  segment_offset_ = 0;
+  Cronet_UploadDataSink_OnRewindSucceeded(sink);
+}
+
+void SegmentsUploadDataProvider::OnClosed() {
+  // Unmap right away instead of whenever the last reference goes.
+  mapped_file_.reset();
+  segments_.clear();
+  if (on_closed_)
+    std::move(on_closed_).Run();
+}
+
+/* static */
+scoped_refptr<ChunkedUploadDataProvider> ChunkedUploadDataProvider::Create() {
+  return base::WrapRefCounted(new ChunkedUploadDataProvider());
+}
+
+ChunkedUploadDataProvider::ChunkedUploadDataProvider() = default;
+
+ChunkedUploadDataProvider::~ChunkedUploadDataProvider() = default;
+
+void ChunkedUploadDataProvider::Append(std::string data) {
+  if (data.empty())
+    return;
+  Cronet_UploadDataSinkPtr sink;
+  uint64_t bytes_read;
+  bool final_chunk;
+  {
+    base::AutoLock auto_lock(lock_);
+    if (finished_)
+      return;
+    chunks_.push_back(std::move(data));
+    if (!FillPendingRead(&sink, &bytes_read, &final_chunk))
+      return;
+  }
+  Cronet_UploadDataSink_OnReadSucceeded(sink, bytes_read, final_chunk);
+}
+
+void ChunkedUploadDataProvider::Finish() {
+  Cronet_UploadDataSinkPtr sink;
+  uint64_t bytes_read;
+  bool final_chunk;
+  {
+    base::AutoLock auto_lock(lock_);
+    finished_ = true;
+    if (!FillPendingRead(&sink, &bytes_read, &final_chunk))
+      return;
+  }
+  Cronet_UploadDataSink_OnReadSucceeded(sink, bytes_read, final_chunk);
+}
+
+int64_t ChunkedUploadDataProvider::GetLength() {
+  return -1;
+}
+
+void ChunkedUploadDataProvider::Read(Cronet_UploadDataSinkPtr sink,
+                                     Cronet_BufferPtr buffer) {
+  uint64_t bytes_read;
+  bool final_chunk;
+  {
+    base::AutoLock auto_lock(lock_);
+    DCHECK(!pending_sink_);
+    pending_sink_ = sink;
+    pending_buffer_ = buffer;
+    if (!FillPendingRead(&sink, &bytes_read, &final_chunk))
+      return;
+  }
+  Cronet_UploadDataSink_OnReadSucceeded(sink, bytes_read, final_chunk);
+}
+
+void ChunkedUploadDataProvider::Rewind(Cronet_UploadDataSinkPtr sink) {
+  Cronet_UploadDataSink_OnRewindError(sink,
+                                      "Chunked upload can't be rewound");
+}
+
+void ChunkedUploadDataProvider::OnClosed() {
+  // The request is gone, a pending read must not be completed anymore.
+  base::AutoLock auto_lock(lock_);
+  finished_ = true;
+  chunks_.clear();
+  pending_sink_ = nullptr;
+  pending_buffer_ = nullptr;
+}
+
+bool ChunkedUploadDataProvider::FillPendingRead(
+    Cronet_UploadDataSinkPtr* sink,
+    uint64_t* bytes_read,
+    bool* final_chunk) {
+  if (!pending_sink_ || (chunks_.empty() && !finished_))
+    return false;
+
+  char* dest = static_cast<char*>(Cronet_Buffer_GetData(pending_buffer_));
+  const size_t size = Cronet_Buffer_GetSize(pending_buffer_);
+  size_t copied = 0;
+  while (copied < size && !chunks_.empty()) {
+    const std::string& chunk = chunks_.front();
+    size_t n = std::min(size - copied, chunk.size() - front_offset_);
+    memcpy(dest + copied, chunk.data() + front_offset_, n);
+    copied += n;
+    front_offset_ += n;
+    if (front_offset_ == chunk.size()) {
+      chunks_.pop_front();
+      front_offset_ = 0;
+    }
+  }
+
+  *sink = pending_sink_;
+  *bytes_read = copied;
+  *final_chunk = finished_ && chunks_.empty();
+  pending_sink_ = nullptr;
+  pending_buffer_ = nullptr;
+  return true;
+}
@@ -0,0 +1,149 @@
+#ifndef AKAMA_SDK_SAMPLE_DEMO_UPLOAD_DATA_PROVIDER_H_
+#define AKAMA_SDK_SAMPLE_DEMO_UPLOAD_DATA_PROVIDER_H_
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "base/callback.h"
+#include "base/containers/circular_deque.h"
+#include "base/containers/span.h"
+#include "base/files/file_path.h"
+#include "base/files/memory_mapped_file.h"
+#include "base/memory/ref_counted.h"
+#include "base/synchronization/lock.h"
+#include "base/thread_annotations.h"
+#include "components/cronet/native/include/cronet_c.h"
+
+// Request body of a POST or PUT, implementing Cronet_UploadDataProvider.
+//
+// Cronet reads the body into its own buffers in pieces of its choice, so the
+// data is copied exactly once, from its source into the network buffer, and
+// never held on the heap as a whole.
+//
+// The provider is ref counted: AttachTo() passes a reference to Cronet,
+// which releases it when it closes the provider after the request is done.
+class UploadDataProvider
+    : public base::RefCountedThreadSafe<UploadDataProvider> {
+ public:
+  UploadDataProvider(const UploadDataProvider&) = delete;
+  UploadDataProvider& operator=(const UploadDataProvider&) = delete;
+
+  // Sets |this| as the body of the request built from |request_params|.
+  // Cronet calls the provider on |executor|.
+  void AttachTo(Cronet_UrlRequestParamsPtr request_params,
+                Cronet_ExecutorPtr executor);
+
+ protected:
+  friend class base::RefCountedThreadSafe<UploadDataProvider>;
+
+  UploadDataProvider();
+  virtual ~UploadDataProvider();
+
+  // Returns the body size, or -1 for a chunked upload.
+  virtual int64_t GetLength() = 0;
+  // Fills |buffer| and reports the result to |sink|, possibly later and from
+  // another thread.
+  virtual void Read(Cronet_UploadDataSinkPtr sink, Cronet_BufferPtr buffer) = 0;
+  // Restarts the body from the beginning, e.g. after a redirect.
+  virtual void Rewind(Cronet_UploadDataSinkPtr sink) = 0;
+  // Called once Cronet no longer uses the provider.
+  virtual void OnClosed() {}
+
+ private:
+  static UploadDataProvider* GetThis(Cronet_UploadDataProviderPtr self);
+  static int64_t GetLength(Cronet_UploadDataProviderPtr self);
+  static void Read(Cronet_UploadDataProviderPtr self,
+                   Cronet_UploadDataSinkPtr sink,
+                   Cronet_BufferPtr buffer);
+  static void Rewind(Cronet_UploadDataProviderPtr self,
+                     Cronet_UploadDataSinkPtr sink);
+  static void Close(Cronet_UploadDataProviderPtr self);
+
+  Cronet_UploadDataProviderPtr const provider_;
+};
+
+// Uploads a sequence of memory segments, e.g. a memory-mapped file or buffers
+// owned by the caller. Supports rewind.
+class SegmentsUploadDataProvider : public UploadDataProvider {
+ public:
+  // Uploads |segments| in order. The caller keeps them alive until
+  // |on_closed| is run, on the upload executor.
+  static scoped_refptr<SegmentsUploadDataProvider> Create(
+      std::vector<base::span<const uint8_t>> segments,
+      base::OnceClosure on_closed);
+
+  // Uploads the file at |path| through a read-only mapping, so pages are
+  // loaded on demand and multi-gigabyte files never hit the heap. The file is
+  // unmapped before |on_closed| is run. Returns null if the file can't be
+  // mapped.
+  static scoped_refptr<SegmentsUploadDataProvider> CreateFromFile(
+      const base::FilePath& path,
+      base::OnceClosure on_closed = base::OnceClosure());
+
+ protected:
+  ~SegmentsUploadDataProvider() override;
+
+  // UploadDataProvider:
+  int64_t GetLength() override;
+  void Read(Cronet_UploadDataSinkPtr sink, Cronet_BufferPtr buffer) override;
+  void Rewind(Cronet_UploadDataSinkPtr sink) override;
+  void OnClosed() override;
+
+ private:
+  SegmentsUploadDataProvider(std::vector<base::span<const uint8_t>> segments,
+                             base::OnceClosure on_closed);
+
+  // Set if the segment is a file mapped by CreateFromFile().
+  std::unique_ptr<base::MemoryMappedFile> mapped_file_;
+  std::vector<base::span<const uint8_t>> segments_;
+  int64_t length_ = 0;
+  // Read position. Cronet never reads concurrently.
+  size_t segment_index_ = 0;
+  size_t segment_offset_ = 0;
+  base::OnceClosure on_closed_;
+};
+
+// Uploads a body of unknown length with chunked transfer encoding. The body
+// is appended from any thread while the request runs. A read waits until data
+// is appended or the body is finished. Can't be rewound, so a redirect that
+// keeps the body fails the request.
+class ChunkedUploadDataProvider : public UploadDataProvider {
+ public:
+  static scoped_refptr<ChunkedUploadDataProvider> Create();
+
+  // Queues |data| to be sent. Ignored after Finish().
+  void Append(std::string data);
+  // Marks the end of the body.
+  void Finish();
+
+ protected:
+  ~ChunkedUploadDataProvider() override;
+
+  // UploadDataProvider:
+  int64_t GetLength() override;
+  void Read(Cronet_UploadDataSinkPtr sink, Cronet_BufferPtr buffer) override;
+  void Rewind(Cronet_UploadDataSinkPtr sink) override;
+  void OnClosed() override;
+
+ private:
+  ChunkedUploadDataProvider();
+
+  // Completes the pending read if there is data or the body is finished.
+  // Returns true with the read to report once |lock_| is released.
+  bool FillPendingRead(Cronet_UploadDataSinkPtr* sink,
+                       uint64_t* bytes_read,
+                       bool* final_chunk) EXCLUSIVE_LOCKS_REQUIRED(lock_);
+
+  base::Lock lock_;
+  base::circular_deque<std::string> chunks_ GUARDED_BY(lock_);
+  // Bytes of the front chunk already sent.
+  size_t front_offset_ GUARDED_BY(lock_) = 0;
+  bool finished_ GUARDED_BY(lock_) = false;
+  // Read waiting for data.
+  Cronet_UploadDataSinkPtr pending_sink_ GUARDED_BY(lock_) = nullptr;
+  Cronet_BufferPtr pending_buffer_ GUARDED_BY(lock_) = nullptr;
+};
+
+#endif  // AKAMA_SDK_SAMPLE_DEMO_UPLOAD_DATA_PROVIDER_H_
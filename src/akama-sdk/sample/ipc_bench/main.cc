@@ -0,0 +1,752 @@
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "akama-sdk/sample/ipc_bench/mojom/bench_server.mojom.h"
+#include "akama-sdk/sample/ipc_mojo_base/mojom/logger.mojom.h"
+#include "akama-sdk/sample/ipc_mojo_cpp_bindings_api/mojom/keep_alive.mojom.h"
+#include "base/bind.h"
+#include "base/command_line.h"
+#include "base/containers/span.h"
+#include "base/files/file_path.h"
+#include "base/files/file_util.h"
+#include "base/json/json_writer.h"
+#include "base/message_loop/message_pump_type.h"
+#include "base/notreached.h"
+#include "base/process/launch.h"
+#include "base/process/process.h"
+#include "base/run_loop.h"
+#include "base/strings/string_number_conversions.h"
+#include "base/strings/string_piece.h"
+#include "base/strings/string_split.h"
+#include "base/task/single_thread_task_executor.h"
+#include "base/task/thread_pool/thread_pool_instance.h"
+#include "base/threading/sequence_bound.h"
+#include "base/threading/thread.h"
+#include "base/time/time.h"
+#include "base/values.h"
+#include "mojo/public/c/system/functions.h"
+#include "mojo/public/cpp/base/big_buffer.h"
+#include "mojo/public/cpp/bindings/pending_receiver.h"
+#include "mojo/public/cpp/bindings/pending_remote.h"
+#include "mojo/public/cpp/bindings/receiver.h"
+#include "mojo/public/cpp/bindings/receiver_set.h"
+#include "mojo/public/cpp/bindings/remote.h"
+#include "mojo/public/cpp/platform/platform_channel.h"
+#include "mojo/public/cpp/system/data_pipe.h"
+#include "mojo/public/cpp/system/data_pipe_drainer.h"
+#include "mojo/public/cpp/system/data_pipe_producer.h"
+#include "mojo/public/cpp/system/invitation.h"
+#include "mojo/public/cpp/system/string_data_source.h"
+#include "third_party/abseil-cpp/absl/types/optional.h"
+
+// clang-format off
+// akama-sdk-ipc-bench：测量sample.mojom.Logger和ipc.mojom.KeepAlive的Mojo IPC开销，输出JSON格式的结果，
+// 方便回归对比。服务端只做最少的处理（Logger只扫描收到的数据），测的是消息传输本身而不是LoggerImpl
+//
+// 测试项：
+// Logger.Log          单向吞吐，每发送一个窗口（最多kMaxLogInFlight条、kMaxLogInFlightBytes字节）
+//                     用GetTail等待处理完再发下一个窗口，测的是IPC吞吐而不是pipe里的积压
+// Logger.GetTail      往返延迟，每次回复最新一行（payload大小），收到回复才发下一次
+// KeepAlive.Heartbeat 单向吞吐，用BenchServer.WaitForHeartbeats等待全部处理完
+// 大块payload分别用Log（string，拷贝进消息）、LogPayload（BigBuffer，超过64KB放在共享内存里）
+// 和LogStream（data pipe）发送，对比吞吐。每次最多发送kMaxLargeInFlight个再等待处理完，
+// 三种方式等待的次数相同，占用的内存也有上限。服务端都会扫描一遍收到的数据
+//
+// 参数：
+// --messages=N          每组单向测试的消息数，默认20000
+// --round-trips=N       每组往返测试的次数，默认5000
+// --payload-sizes=a,b   Log和GetTail的payload大小，默认16,1024,65536
+// --large-messages=N    每组大块payload测试的消息数，默认100
+// --large-payload-sizes=a,b  大块payload的大小，默认65536,1048576,8388608
+// --setups=a,b          服务端的位置，默认same_thread,cross_thread,cross_process
+//                       same_thread：和客户端同一线程
+//                       cross_thread：同一进程的另一个线程
+//                       cross_process：通过PlatformChannel和OutgoingInvitation连接的子进程
+// --output=path         JSON结果另外写入文件
+// clang-format on
+
+namespace {
+
+constexpr char kMessagesSwitch[] = "messages";
+constexpr char kRoundTripsSwitch[] = "round-trips";
+constexpr char kPayloadSizesSwitch[] = "payload-sizes";
+constexpr char kLargeMessagesSwitch[] = "large-messages";
+constexpr char kLargePayloadSizesSwitch[] = "large-payload-sizes";
+constexpr char kSetupsSwitch[] = "setups";
+constexpr char kOutputSwitch[] = "output";
+// 子进程运行BenchServer
+constexpr char kServerSwitch[] = "bench-server";
+
+constexpr char kServerPipeName[] = "bench_server_pipe";
+
+// Log单向测试每个窗口的消息数和字节数上限
+constexpr size_t kMaxLogInFlight = 256;
+constexpr size_t kMaxLogInFlightBytes = 4 * 1024 * 1024;
+constexpr size_t kMaxLargeInFlight = 8;
+constexpr uint32_t kStreamCapacity = 1024 * 1024;
+
+size_t GetSizeSwitch(const base::CommandLine& command_line,
+                     const char* name,
+                     size_t default_value) {
+  size_t value;
+  if (!base::StringToSizeT(command_line.GetSwitchValueASCII(name), &value))
+    return default_value;
+  return value;
+}
+
+std::vector<std::string> GetListSwitch(const base::CommandLine& command_line,
+                                       const char* name,
+                                       const std::string& default_value) {
+  std::string value = command_line.GetSwitchValueASCII(name);
+  return base::SplitString(value.empty() ? default_value : value, ",",
+                           base::TRIM_WHITESPACE, base::SPLIT_WANT_NONEMPTY);
+}
+
+// Returns the |percentile| (0-1) of the sorted |values|.
+double GetPercentile(const std::vector<double>& values, double percentile) {
+  if (values.empty())
+    return 0;
+  size_t rank = static_cast<size_t>(std::ceil(percentile * values.size()));
+  return values[std::min(values.size(), std::max<size_t>(rank, 1)) - 1];
+}
+
+uint64_t CountLines(base::StringPiece data) {
+  return std::count(data.begin(), data.end(), '\n');
+}
+
+// 读完data pipe后回复，和Log、LogPayload一样扫描一遍收到的数据
+class StreamCounter : public mojo::DataPipeDrainer::Client {
+ public:
+  // |done|可以删除|this|
+  using DoneCallback =
+      base::OnceCallback<void(uint64_t num_bytes, uint64_t num_lines)>;
+
+  StreamCounter(mojo::ScopedDataPipeConsumerHandle stream, DoneCallback done)
+      : done_(std::move(done)), drainer_(this, std::move(stream)) {}
+  StreamCounter(const StreamCounter&) = delete;
+  StreamCounter& operator=(const StreamCounter&) = delete;
+  ~StreamCounter() override {}
+
+ private:
+  // mojo::DataPipeDrainer::Client:
+  void OnDataAvailable(const void* data, size_t num_bytes) override {
+    num_bytes_ += num_bytes;
+    num_lines_ += CountLines(
+        base::StringPiece(static_cast<const char*>(data), num_bytes));
+  }
+
+  void OnDataComplete() override {
+    std::move(done_).Run(num_bytes_, num_lines_);
+  }
+
+  DoneCallback done_;
+  mojo::DataPipeDrainer drainer_;
+  uint64_t num_bytes_ = 0;
+  uint64_t num_lines_ = 0;
+};
+
+// 被测接口的最小实现，所有receiver都在构造它的线程上
+class BenchServerImpl : public bench::mojom::BenchServer,
+                        public sample::mojom::Logger,
+                        public ipc::mojom::KeepAlive {
+ public:
+  // BenchServer的pipe断开时运行|disconnect_handler|
+  BenchServerImpl(mojo::PendingReceiver<bench::mojom::BenchServer> receiver,
+                  base::OnceClosure disconnect_handler)
+      : receiver_(this, std::move(receiver)) {
+    if (disconnect_handler)
+      receiver_.set_disconnect_handler(std::move(disconnect_handler));
+  }
+  BenchServerImpl(const BenchServerImpl&) = delete;
+  BenchServerImpl& operator=(const BenchServerImpl&) = delete;
+  ~BenchServerImpl() override {}
+
+  // bench::mojom::BenchServer:
+  void BindLogger(
+      mojo::PendingReceiver<sample::mojom::Logger> receiver) override {
+    logger_receivers_.Add(this, std::move(receiver));
+  }
+
+  void BindKeepAlive(
+      mojo::PendingReceiver<ipc::mojom::KeepAlive> receiver) override {
+    keep_alive_receivers_.Add(this, std::move(receiver));
+  }
+
+  void WaitForHeartbeats(uint64_t count,
+                         WaitForHeartbeatsCallback callback) override {
+    if (heartbeats_ >= count) {
+      std::move(callback).Run();
+      return;
+    }
+    heartbeat_waiters_.emplace_back(count, std::move(callback));
+  }
+
+  // sample::mojom::Logger:
+  void Log(const std::string& message) override {
+    num_lines_ += CountLines(message);
+    last_line_size_ = message.size();
+  }
+
+  void LogBatch(const std::vector<std::string>& messages) override {
+    for (const std::string& message : messages)
+      Log(message);
+  }
+
+  void LogPayload(mojo_base::BigBuffer payload) override {
+    num_lines_ += CountLines(base::StringPiece(
+        reinterpret_cast<const char*>(payload.data()), payload.size()));
+  }
+
+  void LogStream(mojo::ScopedDataPipeConsumerHandle stream,
+                 LogStreamCallback callback) override {
+    const uint64_t id = next_stream_id_++;
+    stream_counters_[id] = std::make_unique<StreamCounter>(
+        std::move(stream),
+        base::BindOnce(&BenchServerImpl::OnStreamDone, base::Unretained(this),
+                       id, std::move(callback)));
+  }
+
+  // 共享内存ring不经过消息传输，不在这里测
+  void OpenRing(base::UnsafeSharedMemoryRegion region,
+                mojo::PendingReceiver<sample::mojom::LogRing> ring) override {}
+
+  void GetTail(uint32_t count, GetTailCallback callback) override {
+    std::vector<std::string> tail;
+    if (count > 0 && last_line_size_)
+      tail.emplace_back(*last_line_size_, 'x');
+    std::move(callback).Run(std::move(tail));
+  }
+
+  void ReadSince(uint64_t sequence,
+                 uint32_t max_count,
+                 ReadSinceCallback callback) override {
+    std::move(callback).Run(0, 0, {});
+  }
+
+  // ipc::mojom::KeepAlive:
+  void Heartbeat(int32_t process_id) override {
+    ++heartbeats_;
+    auto it = std::partition(
+        heartbeat_waiters_.begin(), heartbeat_waiters_.end(),
+        [this](const auto& waiter) { return waiter.first > heartbeats_; });
+    std::vector<std::pair<uint64_t, WaitForHeartbeatsCallback>> done;
+    std::move(it, heartbeat_waiters_.end(), std::back_inserter(done));
+    heartbeat_waiters_.erase(it, heartbeat_waiters_.end());
+    for (auto& waiter : done)
+      std::move(waiter.second).Run();
+  }
+
+ private:
+  void OnStreamDone(uint64_t id,
+                    LogStreamCallback callback,
+                    uint64_t num_bytes,
+                    uint64_t num_lines) {
+    num_lines_ += num_lines;
+    std::move(callback).Run(num_bytes);
+    stream_counters_.erase(id);
+  }
+
+  mojo::Receiver<bench::mojom::BenchServer> receiver_;
+  mojo::ReceiverSet<sample::mojom::Logger> logger_receivers_;
+  mojo::ReceiverSet<ipc::mojom::KeepAlive> keep_alive_receivers_;
+  // GetTail按最后一行的大小回复
+  absl::optional<size_t> last_line_size_;
+  uint64_t num_lines_ = 0;
+  std::map<uint64_t, std::unique_ptr<StreamCounter>> stream_counters_;
+  uint64_t next_stream_id_ = 0;
+  uint64_t heartbeats_ = 0;
+  std::vector<std::pair<uint64_t, WaitForHeartbeatsCallback>>
+      heartbeat_waiters_;
+};
+
+// 大块payload的发送方式
+enum class LargeTransport {
+  kString,
+  kBigBuffer,
+  kDataPipe,
+};
+
+const char* GetLargeTransportMethod(LargeTransport transport) {
+  switch (transport) {
+    case LargeTransport::kString:
+      return "Log";
+    case LargeTransport::kBigBuffer:
+      return "LogPayload";
+    case LargeTransport::kDataPipe:
+      return "LogStream";
+  }
+  NOTREACHED();
+  return "";
+}
+
+// 客户端，在当前线程上依次运行各项测试
+class BenchClient {
+ public:
+  explicit BenchClient(mojo::PendingRemote<bench::mojom::BenchServer> server)
+      : server_(std::move(server)) {
+    server_->BindLogger(logger_.BindNewPipeAndPassReceiver());
+    server_->BindKeepAlive(keep_alive_.BindNewPipeAndPassReceiver());
+    // Unretained is safe, the remotes are owned by |this|.
+    server_.set_disconnect_handler(base::BindOnce(
+        &BenchClient::OnDisconnect, base::Unretained(this)));
+    logger_.set_disconnect_handler(base::BindOnce(
+        &BenchClient::OnDisconnect, base::Unretained(this)));
+    keep_alive_.set_disconnect_handler(base::BindOnce(
+        &BenchClient::OnDisconnect, base::Unretained(this)));
+  }
+  BenchClient(const BenchClient&) = delete;
+  BenchClient& operator=(const BenchClient&) = delete;
+  ~BenchClient() = default;
+
+  // 等服务端建好连接，子进程的启动不计入测试。服务端断开时下面的函数都返回false
+  bool WaitForConnected() {
+    return WaitForLogged() && WaitForHeartbeats();
+  }
+
+  bool MeasureLog(size_t payload_size, size_t count, base::Value::Dict* run) {
+    const std::string payload(payload_size, 'x');
+    const size_t window = std::clamp<size_t>(
+        kMaxLogInFlightBytes / std::max<size_t>(payload_size, 1), 1,
+        kMaxLogInFlight);
+    base::TimeTicks start = base::TimeTicks::Now();
+    for (size_t sent = 0; sent < count;) {
+      const size_t batch = std::min(count - sent, window);
+      for (size_t i = 0; i < batch; ++i)
+        logger_->Log(payload);
+      if (!WaitForLogged())
+        return false;
+      sent += batch;
+    }
+    SetThroughput(base::TimeTicks::Now() - start, count, payload_size, run);
+    run->Set("max_in_flight", static_cast<int>(window));
+    return true;
+  }
+
+  bool MeasureGetTail(size_t payload_size,
+                      size_t count,
+                      base::Value::Dict* run) {
+    logger_->Log(std::string(payload_size, 'x'));
+    latencies_us_.clear();
+    latencies_us_.reserve(count);
+    round_trips_left_ = count;
+
+    base::RunLoop run_loop;
+    round_trips_done_ = run_loop.QuitClosure();
+    base::TimeTicks start = base::TimeTicks::Now();
+    if (count > 0) {
+      SendGetTail();
+      if (!Wait(&run_loop))
+        return false;
+    }
+    base::TimeDelta elapsed = base::TimeTicks::Now() - start;
+
+    std::sort(latencies_us_.begin(), latencies_us_.end());
+    base::Value::Dict latency;
+    latency.Set("p50", GetPercentile(latencies_us_, 0.5));
+    latency.Set("p90", GetPercentile(latencies_us_, 0.9));
+    latency.Set("p99", GetPercentile(latencies_us_, 0.99));
+    latency.Set("p999", GetPercentile(latencies_us_, 0.999));
+    latency.Set("max", latencies_us_.empty() ? 0 : latencies_us_.back());
+
+    double seconds = elapsed.InSecondsF();
+    run->Set("round_trips", static_cast<int>(count));
+    run->Set("duration_ms", elapsed.InMillisecondsF());
+    run->Set("round_trips_per_second", seconds > 0 ? count / seconds : 0);
+    run->Set("latency_us", std::move(latency));
+    return true;
+  }
+
+  bool MeasureLarge(LargeTransport transport,
+                    size_t payload_size,
+                    size_t count,
+                    base::Value::Dict* run) {
+    const std::string payload(payload_size, 'x');
+    base::TimeTicks start = base::TimeTicks::Now();
+    for (size_t sent = 0; sent < count;) {
+      const size_t batch = std::min(count - sent, kMaxLargeInFlight);
+      if (transport == LargeTransport::kDataPipe) {
+        if (!SendStreams(payload, batch))
+          return false;
+      } else {
+        for (size_t i = 0; i < batch; ++i) {
+          if (transport == LargeTransport::kString) {
+            logger_->Log(payload);
+          } else {
+            logger_->LogPayload(
+                mojo_base::BigBuffer(base::as_bytes(base::make_span(payload))));
+          }
+        }
+        if (!WaitForLogged())
+          return false;
+      }
+      sent += batch;
+    }
+    SetThroughput(base::TimeTicks::Now() - start, count, payload_size, run);
+    run->Set("max_in_flight", static_cast<int>(kMaxLargeInFlight));
+    return true;
+  }
+
+  bool MeasureHeartbeat(size_t count, base::Value::Dict* run) {
+    const int32_t process_id = base::Process::Current().Pid();
+    base::TimeTicks start = base::TimeTicks::Now();
+    for (size_t i = 0; i < count; ++i)
+      keep_alive_->Heartbeat(process_id);
+    heartbeats_sent_ += count;
+    if (!WaitForHeartbeats())
+      return false;
+    SetThroughput(base::TimeTicks::Now() - start, count, sizeof(process_id),
+                  run);
+    return true;
+  }
+
+ private:
+  static void SetThroughput(base::TimeDelta elapsed,
+                            size_t count,
+                            size_t payload_size,
+                            base::Value::Dict* run) {
+    double seconds = elapsed.InSecondsF();
+    run->Set("messages", static_cast<int>(count));
+    run->Set("duration_ms", elapsed.InMillisecondsF());
+    run->Set("messages_per_second", seconds > 0 ? count / seconds : 0);
+    run->Set("bytes_per_second",
+             seconds > 0 ? count * static_cast<double>(payload_size) / seconds
+                         : 0);
+  }
+
+  // 同一个pipe上的消息按顺序处理，GetTail的回复到达时之前的Log都已处理完
+  bool WaitForLogged() {
+    base::RunLoop run_loop;
+    logger_->GetTail(0, base::BindOnce(
+                            [](base::OnceClosure quit,
+                               const std::vector<std::string>& tail) {
+                              std::move(quit).Run();
+                            },
+                            run_loop.QuitClosure()));
+    return Wait(&run_loop);
+  }
+
+  bool WaitForHeartbeats() {
+    base::RunLoop run_loop;
+    server_->WaitForHeartbeats(heartbeats_sent_, run_loop.QuitClosure());
+    return Wait(&run_loop);
+  }
+
+  // 发送|count|个LogStream，等服务端全部读完。|payload|在读完之前一直有效，
+  // DataPipeProducer直接从它写入pipe
+  bool SendStreams(const std::string& payload, size_t count) {
+    base::RunLoop run_loop;
+    streams_done_ = run_loop.QuitClosure();
+    for (size_t i = 0; i < count; ++i) {
+      const MojoCreateDataPipeOptions options = {
+          sizeof(MojoCreateDataPipeOptions), MOJO_CREATE_DATA_PIPE_FLAG_NONE,
+          1, kStreamCapacity};
+      mojo::ScopedDataPipeProducerHandle producer_handle;
+      mojo::ScopedDataPipeConsumerHandle consumer_handle;
+      if (mojo::CreateDataPipe(&options, producer_handle, consumer_handle) !=
+          MOJO_RESULT_OK) {
+        return false;
+      }
+      // producer写完后随回调删除
+      auto producer =
+          std::make_unique<mojo::DataPipeProducer>(std::move(producer_handle));
+      mojo::DataPipeProducer* producer_ptr = producer.get();
+      producer_ptr->Write(
+          std::make_unique<mojo::StringDataSource>(
+              base::make_span(payload),
+              mojo::StringDataSource::AsyncWritingMode::
+                  STRING_STAYS_VALID_UNTIL_COMPLETION),
+          base::BindOnce(
+              [](std::unique_ptr<mojo::DataPipeProducer> producer,
+                 MojoResult result) {},
+              std::move(producer)));
+      ++pending_streams_;
+      logger_->LogStream(std::move(consumer_handle),
+                         base::BindOnce(&BenchClient::OnStreamLogged,
+                                        base::Unretained(this)));
+    }
+    return Wait(&run_loop);
+  }
+
+  void OnStreamLogged(uint64_t num_bytes) {
+    if (--pending_streams_ == 0)
+      std::move(streams_done_).Run();
+  }
+
+  void SendGetTail() {
+    sent_time_ = base::TimeTicks::Now();
+    logger_->GetTail(1, base::BindOnce(&BenchClient::OnGetTail,
+                                       base::Unretained(this)));
+  }
+
+  void OnGetTail(const std::vector<std::string>& tail) {
+    latencies_us_.push_back(
+        (base::TimeTicks::Now() - sent_time_).InMicrosecondsF());
+    if (--round_trips_left_ > 0)
+      SendGetTail();
+    else
+      std::move(round_trips_done_).Run();
+  }
+
+  // 运行到|run_loop|退出或者连接断开
+  bool Wait(base::RunLoop* run_loop) {
+    if (disconnected_)
+      return false;
+    run_loop_ = run_loop;
+    run_loop->Run();
+    run_loop_ = nullptr;
+    return !disconnected_;
+  }
+
+  void OnDisconnect() {
+    disconnected_ = true;
+    if (run_loop_)
+      run_loop_->Quit();
+  }
+
+  mojo::Remote<bench::mojom::BenchServer> server_;
+  mojo::Remote<sample::mojom::Logger> logger_;
+  mojo::Remote<ipc::mojom::KeepAlive> keep_alive_;
+  base::RunLoop* run_loop_ = nullptr;
+  bool disconnected_ = false;
+  uint64_t heartbeats_sent_ = 0;
+
+  // GetTail往返测试的状态
+  size_t round_trips_left_ = 0;
+  base::TimeTicks sent_time_;
+  std::vector<double> latencies_us_;
+  base::OnceClosure round_trips_done_;
+
+  // LogStream测试的状态
+  size_t pending_streams_ = 0;
+  base::OnceClosure streams_done_;
+};
+
+base::Value::Dict NewRun(const std::string& setup,
+                         const char* interface_name,
+                         const char* method,
+                         const char* mode,
+                         size_t payload_size) {
+  base::Value::Dict run;
+  run.Set("setup", setup);
+  run.Set("interface", interface_name);
+  run.Set("method", method);
+  run.Set("mode", mode);
+  run.Set("payload_bytes", static_cast<double>(payload_size));
+  return run;
+}
+
+struct BenchConfig {
+  size_t messages;
+  size_t round_trips;
+  std::vector<size_t> payload_sizes;
+  size_t large_messages;
+  std::vector<size_t> large_payload_sizes;
+};
+
+// 连接断开时返回false，已经完成的测试结果仍然保留在|runs|里
+bool RunBenchmarks(const std::string& setup,
+                   mojo::PendingRemote<bench::mojom::BenchServer> server,
+                   const BenchConfig& config,
+                   base::Value::List* runs) {
+  BenchClient client(std::move(server));
+  if (!client.WaitForConnected())
+    return false;
+
+  for (size_t payload_size : config.payload_sizes) {
+    base::Value::Dict log =
+        NewRun(setup, "Logger", "Log", "one_way", payload_size);
+    if (!client.MeasureLog(payload_size, config.messages, &log))
+      return false;
+    runs->Append(std::move(log));
+
+    base::Value::Dict get_tail =
+        NewRun(setup, "Logger", "GetTail", "round_trip", payload_size);
+    if (!client.MeasureGetTail(payload_size, config.round_trips, &get_tail))
+      return false;
+    runs->Append(std::move(get_tail));
+  }
+
+  for (size_t payload_size : config.large_payload_sizes) {
+    for (LargeTransport transport :
+         {LargeTransport::kString, LargeTransport::kBigBuffer,
+          LargeTransport::kDataPipe}) {
+      base::Value::Dict large =
+          NewRun(setup, "Logger", GetLargeTransportMethod(transport),
+                 "one_way", payload_size);
+      if (!client.MeasureLarge(transport, payload_size, config.large_messages,
+                               &large)) {
+        return false;
+      }
+      runs->Append(std::move(large));
+    }
+  }
+
+  base::Value::Dict heartbeat =
+      NewRun(setup, "KeepAlive", "Heartbeat", "one_way", sizeof(int32_t));
+  if (!client.MeasureHeartbeat(config.messages, &heartbeat))
+    return false;
+  runs->Append(std::move(heartbeat));
+  return true;
+}
+
+bool RunSameThread(const BenchConfig& config, base::Value::List* runs) {
+  mojo::PendingRemote<bench::mojom::BenchServer> server;
+  BenchServerImpl server_impl(server.InitWithNewPipeAndPassReceiver(),
+                              base::OnceClosure());
+  return RunBenchmarks("same_thread", std::move(server), config, runs);
+}
+
+bool RunCrossThread(const BenchConfig& config, base::Value::List* runs) {
+  base::Thread server_thread("bench_server");
+  server_thread.StartWithOptions(
+      base::Thread::Options(base::MessagePumpType::IO, 0));
+
+  // BenchServerImpl在server_thread上创建和销毁
+  mojo::PendingRemote<bench::mojom::BenchServer> server;
+  base::SequenceBound<BenchServerImpl> server_impl(
+      server_thread.task_runner(), server.InitWithNewPipeAndPassReceiver(),
+      base::OnceClosure());
+  bool ok = RunBenchmarks("cross_thread", std::move(server), config, runs);
+  server_impl.Reset();
+  server_thread.Stop();
+  return ok;
+}
+
+bool RunCrossProcess(const BenchConfig& config, base::Value::List* runs) {
+  // 和ipc_mojo_cpp_bindings_api一样，通过PlatformChannel启动子进程并发送invitation
+  mojo::PlatformChannel channel;
+  base::LaunchOptions options;
+  base::CommandLine command_line(
+      base::CommandLine::ForCurrentProcess()->GetProgram());
+  command_line.AppendSwitch(kServerSwitch);
+  channel.PrepareToPassRemoteEndpoint(&options, &command_line);
+  base::Process child_process = base::LaunchProcess(command_line, options);
+  channel.RemoteProcessLaunchAttempted();
+  if (!child_process.IsValid()) {
+    std::cerr << "failed to launch bench server process" << std::endl;
+    return false;
+  }
+
+  mojo::OutgoingInvitation invitation;
+  mojo::ScopedMessagePipeHandle pipe =
+      invitation.AttachMessagePipe(kServerPipeName);
+  mojo::OutgoingInvitation::Send(std::move(invitation), child_process.Handle(),
+                                 channel.TakeLocalEndpoint());
+
+  bool ok = RunBenchmarks(
+      "cross_process",
+      mojo::PendingRemote<bench::mojom::BenchServer>(std::move(pipe), 0),
+      config, runs);
+
+  // pipe断开后子进程退出
+  int exit_code = 0;
+  if (!child_process.WaitForExitWithTimeout(base::Seconds(10), &exit_code))
+    child_process.Terminate(1, /*wait=*/false);
+  return ok;
+}
+
+// 子进程：运行BenchServer直到父进程断开
+void RunServerProcess() {
+  mojo::IncomingInvitation invitation = mojo::IncomingInvitation::Accept(
+      mojo::PlatformChannel::RecoverPassedEndpointFromCommandLine(
+          *base::CommandLine::ForCurrentProcess()));
+
+  base::RunLoop run_loop;
+  BenchServerImpl server_impl(
+      mojo::PendingReceiver<bench::mojom::BenchServer>(
+          invitation.ExtractMessagePipe(kServerPipeName)),
+      run_loop.QuitClosure());
+  run_loop.Run();
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  base::CommandLine::Init(argc, argv);
+  const base::CommandLine& command_line =
+      *base::CommandLine::ForCurrentProcess();
+
+  MojoResult ret = MojoInitialize(nullptr);
+  if (MOJO_RESULT_OK != ret) {
+    std::cerr << "mojo init failed: " << ret << std::endl;
+    return 1;
+  }
+  base::SingleThreadTaskExecutor main_task_executor(base::MessagePumpType::IO);
+
+  if (command_line.HasSwitch(kServerSwitch)) {
+    RunServerProcess();
+    MojoShutdown(nullptr);
+    return 0;
+  }
+
+  BenchConfig config;
+  config.messages = GetSizeSwitch(command_line, kMessagesSwitch, 20000);
+  config.round_trips = GetSizeSwitch(command_line, kRoundTripsSwitch, 5000);
+  for (const std::string& size :
+       GetListSwitch(command_line, kPayloadSizesSwitch, "16,1024,65536")) {
+    size_t value;
+    if (base::StringToSizeT(size, &value))
+      config.payload_sizes.push_back(value);
+  }
+  config.large_messages =
+      GetSizeSwitch(command_line, kLargeMessagesSwitch, 100);
+  for (const std::string& size :
+       GetListSwitch(command_line, kLargePayloadSizesSwitch,
+                     "65536,1048576,8388608")) {
+    size_t value;
+    if (base::StringToSizeT(size, &value))
+      config.large_payload_sizes.push_back(value);
+  }
+  // LogStream测试的DataPipeProducer在ThreadPool上写pipe
+  base::ThreadPoolInstance::CreateAndStartWithDefaultParams("ipc_bench");
+
+  base::Value::List runs;
+  bool ok = true;
+  for (const std::string& setup :
+       GetListSwitch(command_line, kSetupsSwitch,
+                     "same_thread,cross_thread,cross_process")) {
+    bool setup_ok;
+    if (setup == "same_thread") {
+      setup_ok = RunSameThread(config, &runs);
+    } else if (setup == "cross_thread") {
+      setup_ok = RunCrossThread(config, &runs);
+    } else if (setup == "cross_process") {
+      setup_ok = RunCrossProcess(config, &runs);
+    } else {
+      std::cerr << "unknown setup " << setup << std::endl;
+      continue;
+    }
+    if (!setup_ok) {
+      std::cerr << setup << ": bench server disconnected" << std::endl;
+      ok = false;
+    }
+  }
+
+  base::Value::Dict report;
+  report.Set("messages", static_cast<int>(config.messages));
+  report.Set("round_trips", static_cast<int>(config.round_trips));
+  report.Set("large_messages", static_cast<int>(config.large_messages));
+  report.Set("runs", std::move(runs));
+
+  std::string json;
+  base::JSONWriter::WriteWithOptions(base::Value(std::move(report)),
+                                     base::JSONWriter::OPTIONS_PRETTY_PRINT,
+                                     &json);
+  std::cout << json;
+  if (command_line.HasSwitch(kOutputSwitch)) {
+    base::FilePath output = command_line.GetSwitchValuePath(kOutputSwitch);
+    if (!base::WriteFile(output, json))
+      std::cerr << "failed to write " << output << std::endl;
+  }
+
+  base::ThreadPoolInstance::Get()->Shutdown();
+  MojoShutdown(nullptr);
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,63 @@
+#include "buffered_logger.h"
+
+#include <utility>
+
+#include "base/bind.h"
+
+BufferedLogger::BufferedLogger(
+    mojo::PendingRemote<sample::mojom::Logger> logger,
+    const Options& options)
+    : options_(options), logger_(std::move(logger)) {
+  pending_lines_.reserve(options_.max_batch_lines);
+}
+
+BufferedLogger::~BufferedLogger() {
+  DCHECK_CALLED_ON_VALID_SEQUENCE(sequence_checker_);
+  Flush();
+}
+
+void BufferedLogger::Log(std::string message) {
+  DCHECK_CALLED_ON_VALID_SEQUENCE(sequence_checker_);
+  ++num_lines_;
+  // A line that doesn't fit the current batch starts the next one.
+  if (!pending_lines_.empty() &&
+      pending_bytes_ + message.size() > options_.max_batch_bytes) {
+    Flush();
+  }
+  pending_bytes_ += message.size();
+  pending_lines_.push_back(std::move(message));
+  if (pending_lines_.size() >= options_.max_batch_lines ||
+      pending_bytes_ >= options_.max_batch_bytes) {
+    Flush();
+    return;
+  }
+  if (!flush_timer_.IsRunning()) {
+    // Unretained is safe, the timer is owned by |this|.
+    flush_timer_.Start(FROM_HERE, options_.max_delay,
+                       base::BindOnce(&BufferedLogger::Flush,
+                                      base::Unretained(this)));
+  }
+}
+
+void BufferedLogger::Flush() {
+  DCHECK_CALLED_ON_VALID_SEQUENCE(sequence_checker_);
+  flush_timer_.Stop();
+  if (pending_lines_.empty())
+    return;
+  ++num_messages_;
+  // The lines are serialized into the message right away.
+  if (pending_lines_.size() == 1)
+    logger_->Log(pending_lines_.front());
+  else
+    logger_->LogBatch(pending_lines_);
+  pending_lines_.clear();
+  pending_bytes_ = 0;
+}
+
+void BufferedLogger::GetTail(
+    uint32_t count,
+    sample::mojom::Logger::GetTailCallback callback) {
+  DCHECK_CALLED_ON_VALID_SEQUENCE(sequence_checker_);
+  Flush();
+  logger_->GetTail(count, std::move(callback));
+}
@@ -0,0 +1,64 @@
+#ifndef AKAMA_SDK_SAMPLE_IPC_MOJO_BASE_BUFFERED_LOGGER_H_
+#define AKAMA_SDK_SAMPLE_IPC_MOJO_BASE_BUFFERED_LOGGER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "akama-sdk/sample/ipc_mojo_base/mojom/logger.mojom.h"
+#include "base/sequence_checker.h"
+#include "base/time/time.h"
+#include "base/timer/timer.h"
+#include "mojo/public/cpp/bindings/pending_remote.h"
+#include "mojo/public/cpp/bindings/remote.h"
+
+// Client side of sample.mojom.Logger that coalesces lines into LogBatch()
+// calls, so a burst of logging costs one message per batch instead of one
+// per line. A batch is sent once it holds |max_batch_lines| lines or
+// |max_batch_bytes| bytes, or |max_delay| after its first line, whichever
+// comes first. Lines keep their order, also relative to GetTail().
+//
+// Lives on the sequence the remote is bound on.
+class BufferedLogger {
+ public:
+  struct Options {
+    size_t max_batch_lines = 256;
+    // Mojo messages are copied whole, keep them well below the size limit.
+    size_t max_batch_bytes = 64 * 1024;
+    base::TimeDelta max_delay = base::Milliseconds(50);
+  };
+
+  BufferedLogger(mojo::PendingRemote<sample::mojom::Logger> logger,
+                 const Options& options);
+  BufferedLogger(const BufferedLogger&) = delete;
+  BufferedLogger& operator=(const BufferedLogger&) = delete;
+  // Sends the pending lines.
+  ~BufferedLogger();
+
+  void Log(std::string message);
+  // Sends the pending lines now.
+  void Flush();
+  // Flushes, so the tail includes every line logged before.
+  void GetTail(uint32_t count,
+               sample::mojom::Logger::GetTailCallback callback);
+
+  uint64_t num_lines() const { return num_lines_; }
+  // Mojo messages sent for the lines.
+  uint64_t num_messages() const { return num_messages_; }
+
+ private:
+  const Options options_;
+  mojo::Remote<sample::mojom::Logger> logger_;
+
+  std::vector<std::string> pending_lines_;
+  size_t pending_bytes_ = 0;
+  base::OneShotTimer flush_timer_;
+
+  uint64_t num_lines_ = 0;
+  uint64_t num_messages_ = 0;
+
+  SEQUENCE_CHECKER(sequence_checker_);
+};
+
+#endif  // AKAMA_SDK_SAMPLE_IPC_MOJO_BASE_BUFFERED_LOGGER_H_
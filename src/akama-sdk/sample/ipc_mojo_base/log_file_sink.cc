@@ -0,0 +1,291 @@
+#include "log_file_sink.h"
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+#include "base/bind.h"
+#include "base/files/file.h"
+#include "base/files/file_util.h"
+#include "base/logging.h"
+#include "base/memory/ref_counted.h"
+#include "base/strings/string_number_conversions.h"
+#include "base/synchronization/lock.h"
+#include "base/task/sequenced_task_runner.h"
+#include "base/task/thread_pool.h"
+#include "base/thread_annotations.h"
+#include "build/build_config.h"
+
+#if BUILDFLAG(IS_POSIX)
+#include <limits.h>
+#include <sys/uio.h>
+
+#include "base/posix/eintr_wrapper.h"
+#endif
+
+// The part of the sink living on the file sequence. Batches are queued from
+// the logging sequence under |lock_|, which is never held during I/O.
+class LogFileSink::FileWriter
+    : public base::RefCountedThreadSafe<LogFileSink::FileWriter> {
+ public:
+  explicit FileWriter(const Options& options)
+      : options_(options),
+        task_runner_(base::ThreadPool::CreateSequencedTaskRunner(
+            {base::MayBlock(), base::TaskPriority::BEST_EFFORT,
+             base::TaskShutdownBehavior::BLOCK_SHUTDOWN})) {}
+  FileWriter(const FileWriter&) = delete;
+  FileWriter& operator=(const FileWriter&) = delete;
+
+  // Returns false, dropping |batch|, if too much is queued already.
+  bool Enqueue(std::string batch) {
+    {
+      base::AutoLock lock(lock_);
+      if (queued_bytes_ + batch.size() > options_.max_queued_bytes)
+        return false;
+      queued_bytes_ += batch.size();
+      queue_.push_back(std::move(batch));
+      if (write_scheduled_)
+        return true;
+      write_scheduled_ = true;
+    }
+    task_runner_->PostTask(FROM_HERE,
+                           base::BindOnce(&FileWriter::WriteQueued, this));
+    return true;
+  }
+
+  // Runs |done| on the calling sequence once the queue is written.
+  void Flush(base::OnceClosure done) {
+    task_runner_->PostTaskAndReply(
+        FROM_HERE, base::BindOnce(&FileWriter::WriteQueued, this),
+        std::move(done));
+  }
+
+  void Close() {
+    task_runner_->PostTask(FROM_HERE,
+                           base::BindOnce(&FileWriter::CloseFile, this));
+  }
+
+  void GetStats(Stats* stats) const {
+    base::AutoLock lock(lock_);
+    stats->bytes_written = bytes_written_;
+    stats->writes = writes_;
+    stats->rotations = rotations_;
+    stats->write_errors = write_errors_;
+  }
+
+ private:
+  friend class base::RefCountedThreadSafe<FileWriter>;
+  ~FileWriter() = default;
+
+  void WriteQueued() {
+    std::vector<std::string> batches;
+    {
+      base::AutoLock lock(lock_);
+      batches.swap(queue_);
+      queued_bytes_ = 0;
+      write_scheduled_ = false;
+    }
+    // Consecutive batches go into one write, up to where the file rotates.
+    size_t begin = 0;
+    while (begin < batches.size()) {
+      if (!file_.IsValid() || NeedsRotation(batches[begin].size()))
+        OpenFile();
+      int64_t size = file_size_;
+      size_t end = begin;
+      do {
+        size += batches[end].size();
+        ++end;
+      } while (end < batches.size() &&
+               size + static_cast<int64_t>(batches[end].size()) <=
+                   options_.max_file_size);
+      WriteBatches(batches, begin, end);
+      begin = end;
+    }
+  }
+
+  bool NeedsRotation(size_t next_write) const {
+    if (file_size_ == 0)
+      return false;
+    if (file_size_ + static_cast<int64_t>(next_write) > options_.max_file_size)
+      return true;
+    return !options_.max_file_age.is_zero() &&
+           base::Time::Now() - file_opened_ >= options_.max_file_age;
+  }
+
+  // Opens the log file, rotating the current one away if it has data.
+  void OpenFile() {
+    bool rotate = file_.IsValid();
+    file_.Close();
+    if (rotate) {
+      for (int i = options_.max_files - 1; i > 0; --i) {
+        base::FilePath from = i == 1 ? options_.path : GetRotatedPath(i - 1);
+        base::FilePath to = GetRotatedPath(i);
+        if (i == options_.max_files - 1)
+          base::DeleteFile(to);
+        if (base::PathExists(from))
+          base::Move(from, to);
+      }
+      if (options_.max_files <= 1)
+        base::DeleteFile(options_.path);
+      base::AutoLock lock(lock_);
+      ++rotations_;
+    }
+    file_.Initialize(options_.path, base::File::FLAG_OPEN_ALWAYS |
+                                        base::File::FLAG_APPEND);
+    if (!file_.IsValid()) {
+      LOG(ERROR) << "Can't open " << options_.path << ": "
+                 << base::File::ErrorToString(file_.error_details());
+    }
+    file_size_ = file_.IsValid() ? std::max<int64_t>(file_.GetLength(), 0) : 0;
+    file_opened_ = base::Time::Now();
+  }
+
+  base::FilePath GetRotatedPath(int index) const {
+    return options_.path.AddExtensionASCII(base::NumberToString(index));
+  }
+
+  void WriteBatches(const std::vector<std::string>& batches,
+                    size_t begin,
+                    size_t end) {
+    int64_t written = 0;
+    int writes = 0;
+    bool ok = file_.IsValid();
+#if BUILDFLAG(IS_POSIX)
+    while (ok && begin < end) {
+      iovec iov[IOV_MAX];
+      int count = 0;
+      for (size_t i = begin; i < end && count < IOV_MAX; ++i, ++count) {
+        iov[count].iov_base = const_cast<char*>(batches[i].data());
+        iov[count].iov_len = batches[i].size();
+      }
+      // Resumes a short write in the middle of a batch.
+      size_t skip = 0;
+      int first = 0;
+      while (first < count) {
+        iov[first].iov_base = static_cast<char*>(iov[first].iov_base) + skip;
+        iov[first].iov_len -= skip;
+        ssize_t result = HANDLE_EINTR(
+            writev(file_.GetPlatformFile(), iov + first, count - first));
+        if (result < 0) {
+          ok = false;
+          break;
+        }
+        ++writes;
+        written += result;
+        skip = static_cast<size_t>(result);
+        while (first < count && skip >= iov[first].iov_len)
+          skip -= iov[first++].iov_len;
+      }
+      begin += count;
+    }
+#else
+    for (size_t i = begin; ok && i < end; ++i) {
+      const int size = static_cast<int>(batches[i].size());
+      ok = file_.WriteAtCurrentPos(batches[i].data(), size) == size;
+      ++writes;
+      if (ok)
+        written += batches[i].size();
+    }
+#endif
+    file_size_ += written;
+    base::AutoLock lock(lock_);
+    bytes_written_ += written;
+    writes_ += writes;
+    if (!ok)
+      ++write_errors_;
+  }
+
+  void CloseFile() {
+    WriteQueued();
+    file_.Close();
+  }
+
+  const Options options_;
+  const scoped_refptr<base::SequencedTaskRunner> task_runner_;
+
+  // Only used on |task_runner_|.
+  base::File file_;
+  int64_t file_size_ = 0;
+  base::Time file_opened_;
+
+  // Synchronise access to the members below.
+  mutable base::Lock lock_;
+  std::vector<std::string> queue_ GUARDED_BY(lock_);
+  size_t queued_bytes_ GUARDED_BY(lock_) = 0;
+  bool write_scheduled_ GUARDED_BY(lock_) = false;
+  uint64_t bytes_written_ GUARDED_BY(lock_) = 0;
+  uint64_t writes_ GUARDED_BY(lock_) = 0;
+  uint64_t rotations_ GUARDED_BY(lock_) = 0;
+  uint64_t write_errors_ GUARDED_BY(lock_) = 0;
+};
+
+LogFileSink::Options::Options() = default;
+
+LogFileSink::Options::Options(const Options&) = default;
+
+LogFileSink::Options::~Options() = default;
+
+LogFileSink::LogFileSink(const Options& options)
+    : options_(options),
+      file_writer_(base::MakeRefCounted<FileWriter>(options)) {
+  batch_.reserve(options_.batch_size);
+}
+
+LogFileSink::~LogFileSink() {
+  DCHECK_CALLED_ON_VALID_SEQUENCE(sequence_checker_);
+  HandOff();
+  file_writer_->Close();
+}
+
+void LogFileSink::Write(base::StringPiece line) {
+  DCHECK_CALLED_ON_VALID_SEQUENCE(sequence_checker_);
+  ++lines_;
+  ++batch_lines_;
+  batch_.append(line.data(), line.size());
+  batch_.push_back('\n');
+  if (batch_.size() >= options_.batch_size) {
+    HandOff();
+  } else if (!batch_timer_.IsRunning()) {
+    // Unretained is safe, the timer is owned by |this|.
+    batch_timer_.Start(
+        FROM_HERE, options_.batch_delay,
+        base::BindOnce(&LogFileSink::HandOff, base::Unretained(this)));
+  }
+}
+
+void LogFileSink::Flush(base::OnceClosure done) {
+  DCHECK_CALLED_ON_VALID_SEQUENCE(sequence_checker_);
+  HandOff();
+  file_writer_->Flush(std::move(done));
+}
+
+LogFileSink::Stats LogFileSink::GetStats() const {
+  DCHECK_CALLED_ON_VALID_SEQUENCE(sequence_checker_);
+  Stats stats;
+  stats.lines = lines_;
+  stats.dropped_lines = dropped_lines_;
+  file_writer_->GetStats(&stats);
+  return stats;
+}
+
+void LogFileSink::HandOff() {
+  DCHECK_CALLED_ON_VALID_SEQUENCE(sequence_checker_);
+  batch_timer_.Stop();
+  if (batch_.empty())
+    return;
+  if (unreported_dropped_lines_) {
+    batch_.insert(0, "<log file sink fell behind, " +
+                         base::NumberToString(unreported_dropped_lines_) +
+                         " lines dropped>\n");
+  }
+  std::string batch;
+  batch.reserve(options_.batch_size);
+  batch.swap(batch_);
+  if (file_writer_->Enqueue(std::move(batch))) {
+    unreported_dropped_lines_ = 0;
+  } else {
+    unreported_dropped_lines_ += batch_lines_;
+    dropped_lines_ += batch_lines_;
+  }
+  batch_lines_ = 0;
+}
@@ -0,0 +1,92 @@
+#ifndef AKAMA_SDK_SAMPLE_IPC_MOJO_BASE_LOG_FILE_SINK_H_
+#define AKAMA_SDK_SAMPLE_IPC_MOJO_BASE_LOG_FILE_SINK_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "base/callback.h"
+#include "base/files/file_path.h"
+#include "base/memory/scoped_refptr.h"
+#include "base/sequence_checker.h"
+#include "base/strings/string_piece.h"
+#include "base/time/time.h"
+#include "base/timer/timer.h"
+
+// Writes log lines to a file without ever blocking the sequence that logs,
+// typically the IPC thread.
+//
+// Lines are gathered into batches of |batch_size| bytes, or whatever arrived
+// within |batch_delay|, which are handed over to a BEST_EFFORT, MayBlock
+// ThreadPool sequence. That sequence writes all batches queued since its
+// last run with one vectored write, so the disk sees few large writes. The
+// file is rotated to <path>.1 ... <path>.<max_files - 1> once it would grow
+// past |max_file_size| or is older than |max_file_age|.
+//
+// If the disk falls behind by more than |max_queued_bytes|, new batches are
+// dropped instead of queued, and the number of lines lost is written to the
+// file once there is room again.
+class LogFileSink {
+ public:
+  struct Options {
+    Options();
+    Options(const Options&);
+    ~Options();
+
+    base::FilePath path;
+    int64_t max_file_size = 16 * 1024 * 1024;
+    // Zero to rotate by size only.
+    base::TimeDelta max_file_age = base::Hours(1);
+    // Including the current file.
+    int max_files = 5;
+    size_t batch_size = 64 * 1024;
+    base::TimeDelta batch_delay = base::Milliseconds(500);
+    size_t max_queued_bytes = 8 * 1024 * 1024;
+  };
+
+  struct Stats {
+    uint64_t lines = 0;
+    uint64_t dropped_lines = 0;
+    // Updated by the file sequence.
+    uint64_t bytes_written = 0;
+    uint64_t writes = 0;
+    uint64_t rotations = 0;
+    uint64_t write_errors = 0;
+  };
+
+  explicit LogFileSink(const Options& options);
+  LogFileSink(const LogFileSink&) = delete;
+  LogFileSink& operator=(const LogFileSink&) = delete;
+  // Hands over the last batch. The file is written and closed later on the
+  // file sequence, which blocks shutdown until then.
+  ~LogFileSink();
+
+  // Appends |line| and a newline.
+  void Write(base::StringPiece line);
+  // Hands over the current batch and runs |done| on this sequence once every
+  // line written before is on disk, e.g. before shutting down.
+  void Flush(base::OnceClosure done);
+
+  Stats GetStats() const;
+
+ private:
+  class FileWriter;
+
+  // Hands |batch_| over to the file sequence.
+  void HandOff();
+
+  const Options options_;
+  const scoped_refptr<FileWriter> file_writer_;
+
+  std::string batch_;
+  size_t batch_lines_ = 0;
+  base::OneShotTimer batch_timer_;
+  uint64_t lines_ = 0;
+  // Dropped and not reported in the file yet.
+  uint64_t unreported_dropped_lines_ = 0;
+  uint64_t dropped_lines_ = 0;
+
+  SEQUENCE_CHECKER(sequence_checker_);
+};
+
+#endif  // AKAMA_SDK_SAMPLE_IPC_MOJO_BASE_LOG_FILE_SINK_H_
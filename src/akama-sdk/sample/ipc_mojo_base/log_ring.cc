@@ -0,0 +1,293 @@
+#include "log_ring.h"
+
+#include <atomic>
+#include <cstring>
+#include <new>
+#include <string>
+#include <utility>
+
+#include "base/bind.h"
+#include "base/logging.h"
+#include "base/memory/ptr_util.h"
+#include "base/strings/string_number_conversions.h"
+
+// Every member shared with the other side sits on its own cache line, so
+// the producer and the consumer don't invalidate each other's.
+struct LogRingHeader {
+  uint32_t magic;
+  uint64_t capacity;
+
+  // Owned by the producer.
+  alignas(64) std::atomic<uint64_t> write_pos;
+  std::atomic<uint64_t> dropped_lines;
+
+  // Owned by the consumer.
+  alignas(64) std::atomic<uint64_t> read_pos;
+  // Set by the consumer when it stops reading, and cleared by whoever
+  // wakes it up.
+  std::atomic<uint32_t> consumer_idle;
+};
+
+namespace {
+
+constexpr uint32_t kRingMagic = 0x474f4c52;  // "RLOG"
+constexpr size_t kMinCapacity = 4 * 1024;
+// Records start with their length and are aligned to it.
+constexpr uint64_t kRecordAlignment = sizeof(uint32_t);
+// Length of the record filling the end of the ring when the next one doesn't
+// fit there.
+constexpr uint32_t kPaddingRecord = 0xffffffff;
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free,
+              "The ring is shared between processes");
+static_assert(std::atomic<uint32_t>::is_always_lock_free,
+              "The ring is shared between processes");
+
+uint64_t GetRecordSize(size_t length) {
+  return (sizeof(uint32_t) + length + kRecordAlignment - 1) &
+         ~(kRecordAlignment - 1);
+}
+
+}  // namespace
+
+/* static */
+std::unique_ptr<LogRingProducer> LogRingProducer::Create(
+    sample::mojom::Logger* logger,
+    size_t capacity) {
+  // A power of two, so positions map to offsets with a mask.
+  size_t ring_capacity = kMinCapacity;
+  while (ring_capacity < capacity)
+    ring_capacity *= 2;
+
+  base::UnsafeSharedMemoryRegion region =
+      base::UnsafeSharedMemoryRegion::Create(sizeof(LogRingHeader) +
+                                             ring_capacity);
+  if (!region.IsValid())
+    return nullptr;
+  base::WritableSharedMemoryMapping mapping = region.Map();
+  if (!mapping.IsValid())
+    return nullptr;
+  // The consumer may look at the ring as soon as it is sent.
+  LogRingHeader* header = new (mapping.memory()) LogRingHeader();
+  header->magic = kRingMagic;
+  header->capacity = ring_capacity;
+  header->consumer_idle.store(1);
+
+  mojo::PendingRemote<sample::mojom::LogRing> ring;
+  logger->OpenRing(std::move(region), ring.InitWithNewPipeAndPassReceiver());
+  return base::WrapUnique(
+      new LogRingProducer(std::move(mapping), ring_capacity, std::move(ring)));
+}
+
+LogRingProducer::LogRingProducer(
+    base::WritableSharedMemoryMapping mapping,
+    size_t capacity,
+    mojo::PendingRemote<sample::mojom::LogRing> ring)
+    : mapping_(std::move(mapping)),
+      header_(static_cast<LogRingHeader*>(mapping_.memory())),
+      data_(static_cast<char*>(mapping_.memory()) + sizeof(LogRingHeader)),
+      capacity_(capacity),
+      ring_(std::move(ring)) {}
+
+LogRingProducer::~LogRingProducer() {
+  DCHECK_CALLED_ON_VALID_SEQUENCE(sequence_checker_);
+}
+
+bool LogRingProducer::Write(base::StringPiece line) {
+  DCHECK_CALLED_ON_VALID_SEQUENCE(sequence_checker_);
+  if (!ring_.is_connected())
+    return false;
+
+  // Checked before any arithmetic on the positions.
+  const uint64_t record_size =
+      line.size() < kPaddingRecord ? GetRecordSize(line.size()) : capacity_ + 1;
+  if (record_size > capacity_) {
+    header_->dropped_lines.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+  uint64_t offset = write_pos_ & (capacity_ - 1);
+  const uint64_t space_to_end = capacity_ - offset;
+  // Records don't wrap, one that doesn't fit at the end starts over at 0.
+  const uint64_t padding = record_size > space_to_end ? space_to_end : 0;
+  // The consumer's read position lives in shared memory. One that isn't
+  // within the last |capacity_| bytes written means the ring is corrupted.
+  const uint64_t read_pos = header_->read_pos.load(std::memory_order_acquire);
+  if (read_pos > write_pos_ || write_pos_ - read_pos > capacity_) {
+    ring_.reset();
+    return false;
+  }
+  const uint64_t used = write_pos_ - read_pos;
+  if (padding + record_size > capacity_ - used) {
+    header_->dropped_lines.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+
+  if (padding) {
+    const uint32_t marker = kPaddingRecord;
+    memcpy(data_ + offset, &marker, sizeof(marker));
+    write_pos_ += padding;
+    offset = 0;
+  }
+  const uint32_t length = static_cast<uint32_t>(line.size());
+  memcpy(data_ + offset, &length, sizeof(length));
+  memcpy(data_ + offset + sizeof(length), line.data(), line.size());
+  write_pos_ += record_size;
+
+  // Pairs with the consumer setting |consumer_idle| before checking
+  // |write_pos| once more: either it sees this record, or this sees it idle.
+  header_->write_pos.store(write_pos_, std::memory_order_seq_cst);
+  if (header_->consumer_idle.exchange(0, std::memory_order_seq_cst)) {
+    ++num_doorbells_;
+    ring_->Doorbell();
+  }
+  return true;
+}
+
+void LogRingProducer::Flush(base::OnceClosure done) {
+  DCHECK_CALLED_ON_VALID_SEQUENCE(sequence_checker_);
+  ring_->Flush(std::move(done));
+}
+
+uint64_t LogRingProducer::dropped_lines() const {
+  return header_->dropped_lines.load(std::memory_order_relaxed);
+}
+
+/* static */
+std::unique_ptr<LogRingConsumer> LogRingConsumer::Create(
+    base::UnsafeSharedMemoryRegion region,
+    mojo::PendingReceiver<sample::mojom::LogRing> receiver,
+    LineCallback line_callback) {
+  if (!region.IsValid() || region.GetSize() <= sizeof(LogRingHeader))
+    return nullptr;
+  base::WritableSharedMemoryMapping mapping = region.Map();
+  if (!mapping.IsValid())
+    return nullptr;
+  // Trust nothing but the size of the mapping.
+  const uint64_t capacity = mapping.size() - sizeof(LogRingHeader);
+  const LogRingHeader* header =
+      static_cast<const LogRingHeader*>(mapping.memory());
+  if (header->magic != kRingMagic || header->capacity != capacity ||
+      (capacity & (capacity - 1)) != 0 ||
+      (header->read_pos.load() & (kRecordAlignment - 1)) != 0) {
+    LOG(ERROR) << "Invalid log ring";
+    return nullptr;
+  }
+  return base::WrapUnique(new LogRingConsumer(std::move(mapping), capacity,
+                                              std::move(receiver),
+                                              std::move(line_callback)));
+}
+
+LogRingConsumer::LogRingConsumer(
+    base::WritableSharedMemoryMapping mapping,
+    uint64_t capacity,
+    mojo::PendingReceiver<sample::mojom::LogRing> receiver,
+    LineCallback line_callback)
+    : mapping_(std::move(mapping)),
+      header_(static_cast<LogRingHeader*>(mapping_.memory())),
+      data_(static_cast<const char*>(mapping_.memory()) +
+            sizeof(LogRingHeader)),
+      capacity_(capacity),
+      receiver_(this, std::move(receiver)),
+      line_callback_(std::move(line_callback)),
+      read_pos_(header_->read_pos.load(std::memory_order_relaxed)) {
+  receiver_.set_disconnect_handler(base::BindOnce(
+      &LogRingConsumer::OnDisconnect, base::Unretained(this)));
+}
+
+LogRingConsumer::~LogRingConsumer() {
+  DCHECK_CALLED_ON_VALID_SEQUENCE(sequence_checker_);
+}
+
+void LogRingConsumer::set_disconnect_handler(base::OnceClosure handler) {
+  disconnect_handler_ = std::move(handler);
+}
+
+void LogRingConsumer::Doorbell() {
+  DCHECK_CALLED_ON_VALID_SEQUENCE(sequence_checker_);
+  Drain();
+}
+
+void LogRingConsumer::Flush(FlushCallback callback) {
+  DCHECK_CALLED_ON_VALID_SEQUENCE(sequence_checker_);
+  Drain();
+  std::move(callback).Run();
+}
+
+void LogRingConsumer::Drain() {
+  while (!closed_) {
+    if (!ReadUntil(header_->write_pos.load(std::memory_order_acquire)))
+      return;
+    ReportDroppedLines();
+
+    header_->consumer_idle.store(1, std::memory_order_seq_cst);
+    if (header_->write_pos.load(std::memory_order_seq_cst) == read_pos_)
+      return;
+    // More came in meanwhile. Keep reading, unless the producer cleared the
+    // flag already, then its doorbell does.
+    if (!header_->consumer_idle.exchange(0, std::memory_order_seq_cst))
+      return;
+  }
+}
+
+bool LogRingConsumer::ReadUntil(uint64_t write_pos) {
+  if (write_pos - read_pos_ > capacity_) {
+    Close("Log ring write position out of range");
+    return false;
+  }
+  std::string line;
+  while (read_pos_ != write_pos) {
+    const uint64_t offset = read_pos_ & (capacity_ - 1);
+    const uint64_t space_to_end = capacity_ - offset;
+    uint32_t length;
+    memcpy(&length, data_ + offset, sizeof(length));
+    if (length == kPaddingRecord) {
+      if (space_to_end > write_pos - read_pos_) {
+        Close("Log ring padding out of range");
+        return false;
+      }
+      read_pos_ += space_to_end;
+    } else {
+      const uint64_t record_size = GetRecordSize(length);
+      if (record_size > space_to_end || record_size > write_pos - read_pos_) {
+        Close("Log ring record out of range");
+        return false;
+      }
+      // Copied out, the producer could scribble over the ring meanwhile.
+      line.assign(data_ + offset + sizeof(length), length);
+      read_pos_ += record_size;
+      line_callback_.Run(line);
+    }
+    // Hands the space back to the producer right away.
+    header_->read_pos.store(read_pos_, std::memory_order_release);
+  }
+  return true;
+}
+
+void LogRingConsumer::ReportDroppedLines() {
+  const uint64_t dropped_lines =
+      header_->dropped_lines.load(std::memory_order_relaxed);
+  if (dropped_lines == reported_dropped_lines_)
+    return;
+  line_callback_.Run("<log ring full, " +
+                     base::NumberToString(dropped_lines -
+                                          reported_dropped_lines_) +
+                     " lines dropped>");
+  reported_dropped_lines_ = dropped_lines;
+}
+
+void LogRingConsumer::OnDisconnect() {
+  // The producer may have written more after its last doorbell.
+  if (!ReadUntil(header_->write_pos.load(std::memory_order_acquire)))
+    return;
+  ReportDroppedLines();
+  Close(nullptr);
+}
+
+void LogRingConsumer::Close(const char* reason) {
+  if (reason)
+    LOG(ERROR) << reason;
+  closed_ = true;
+  receiver_.reset();
+  if (disconnect_handler_)
+    std::move(disconnect_handler_).Run();
+}
@@ -0,0 +1,135 @@
+#ifndef AKAMA_SDK_SAMPLE_IPC_MOJO_BASE_LOG_RING_H_
+#define AKAMA_SDK_SAMPLE_IPC_MOJO_BASE_LOG_RING_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+#include "akama-sdk/sample/ipc_mojo_base/mojom/logger.mojom.h"
+#include "base/callback.h"
+#include "base/memory/shared_memory_mapping.h"
+#include "base/memory/unsafe_shared_memory_region.h"
+#include "base/sequence_checker.h"
+#include "base/strings/string_piece.h"
+#include "mojo/public/cpp/bindings/pending_receiver.h"
+#include "mojo/public/cpp/bindings/pending_remote.h"
+#include "mojo/public/cpp/bindings/receiver.h"
+#include "mojo/public/cpp/bindings/remote.h"
+
+// Shared state of the ring, at the start of the shared memory. Defined in
+// log_ring.cc.
+struct LogRingHeader;
+
+// Single-producer/single-consumer ring of log lines in shared memory, so the
+// lines of a chatty client don't go through Mojo messages at all.
+//
+// The producer appends length-prefixed records and publishes its write
+// position; the consumer reads up to it and publishes its read position,
+// which frees the space. The LogRing pipe only carries a Doorbell() when the
+// producer writes to a ring whose consumer went idle, so a busy consumer
+// gets no messages at all. The region may be shared with another process,
+// the consumer validates every record and drops the ring on garbage.
+//
+// The producer never waits for the consumer: a line that doesn't fit a full
+// ring is dropped and counted, and the consumer reports the count as a line
+// of its own.
+
+class LogRingProducer {
+ public:
+  static constexpr size_t kDefaultCapacity = 1024 * 1024;
+
+  // Creates a ring of at least |capacity| bytes and hands it over to
+  // |logger|. Returns null if the shared memory can't be allocated.
+  static std::unique_ptr<LogRingProducer> Create(
+      sample::mojom::Logger* logger,
+      size_t capacity = kDefaultCapacity);
+
+  LogRingProducer(const LogRingProducer&) = delete;
+  LogRingProducer& operator=(const LogRingProducer&) = delete;
+  ~LogRingProducer();
+
+  // Appends |line|. Returns false if it was dropped because the ring is full
+  // or the consumer is gone. A consumer that corrupted the read position is
+  // disconnected.
+  bool Write(base::StringPiece line);
+  // Runs |done| once the consumer read every line written before.
+  void Flush(base::OnceClosure done);
+
+  uint64_t dropped_lines() const;
+  // Doorbell() messages sent.
+  uint64_t num_doorbells() const { return num_doorbells_; }
+
+ private:
+  LogRingProducer(base::WritableSharedMemoryMapping mapping,
+                  size_t capacity,
+                  mojo::PendingRemote<sample::mojom::LogRing> ring);
+
+  const base::WritableSharedMemoryMapping mapping_;
+  LogRingHeader* const header_;
+  char* const data_;
+  const uint64_t capacity_;
+  mojo::Remote<sample::mojom::LogRing> ring_;
+
+  // Private copy of the write position, the shared one is only published.
+  uint64_t write_pos_ = 0;
+  uint64_t num_doorbells_ = 0;
+
+  SEQUENCE_CHECKER(sequence_checker_);
+};
+
+class LogRingConsumer : public sample::mojom::LogRing {
+ public:
+  // Called with every line read from the ring.
+  using LineCallback = base::RepeatingCallback<void(base::StringPiece line)>;
+
+  // Returns null if |region| doesn't hold a valid ring.
+  static std::unique_ptr<LogRingConsumer> Create(
+      base::UnsafeSharedMemoryRegion region,
+      mojo::PendingReceiver<sample::mojom::LogRing> receiver,
+      LineCallback line_callback);
+
+  LogRingConsumer(const LogRingConsumer&) = delete;
+  LogRingConsumer& operator=(const LogRingConsumer&) = delete;
+  ~LogRingConsumer() override;
+
+  // Runs |handler| when the producer is gone or the ring was dropped.
+  void set_disconnect_handler(base::OnceClosure handler);
+
+  // sample::mojom::LogRing:
+  void Doorbell() override;
+  void Flush(FlushCallback callback) override;
+
+ private:
+  LogRingConsumer(base::WritableSharedMemoryMapping mapping,
+                  uint64_t capacity,
+                  mojo::PendingReceiver<sample::mojom::LogRing> receiver,
+                  LineCallback line_callback);
+
+  // Reads every record there is, then goes idle.
+  void Drain();
+  // Reads up to |write_pos|. Returns false if it closed the ring on a
+  // malformed record.
+  bool ReadUntil(uint64_t write_pos);
+  void ReportDroppedLines();
+  void OnDisconnect();
+  // Stops reading, |reason| is null unless the producer corrupted the ring.
+  // Runs the disconnect handler, which may delete |this|.
+  void Close(const char* reason);
+
+  const base::WritableSharedMemoryMapping mapping_;
+  LogRingHeader* const header_;
+  const char* const data_;
+  const uint64_t capacity_;
+  mojo::Receiver<sample::mojom::LogRing> receiver_;
+  const LineCallback line_callback_;
+  base::OnceClosure disconnect_handler_;
+
+  // Private copy of the read position, the shared one is only published.
+  uint64_t read_pos_;
+  uint64_t reported_dropped_lines_ = 0;
+  bool closed_ = false;
+
+  SEQUENCE_CHECKER(sequence_checker_);
+};
+
+#endif  // AKAMA_SDK_SAMPLE_IPC_MOJO_BASE_LOG_RING_H_
@@ -0,0 +1,104 @@
+#include "log_store.h"
+
+#include <algorithm>
+#include <cstring>
+#include <utility>
+
+#include "base/check.h"
+
+LogStore::ReadResult::ReadResult() = default;
+
+LogStore::ReadResult::ReadResult(ReadResult&&) = default;
+
+LogStore::ReadResult& LogStore::ReadResult::operator=(ReadResult&&) = default;
+
+LogStore::ReadResult::~ReadResult() = default;
+
+LogStore::LogStore(const Options& options) : options_(options) {
+  DCHECK_GT(options_.max_lines, 0u);
+  DCHECK_GT(options_.chunk_size, 0u);
+  DCHECK_GT(options_.max_chunks, 0u);
+}
+
+LogStore::~LogStore() = default;
+
+void LogStore::Append(base::StringPiece line) {
+  const size_t size = std::min(line.size(), options_.chunk_size);
+  if (lines_.size() == options_.max_lines)
+    DropOldestLine();
+  ReserveBytes(size);
+  Chunk& chunk = chunks_.back();
+  char* data = chunk.data.get() + chunk.used;
+  memcpy(data, line.data(), size);
+  chunk.used += size;
+  lines_.push_back({data, size, chunk.id, base::TimeTicks::Now()});
+  ++next_sequence_;
+}
+
+void LogStore::Clear() {
+  lines_.clear();
+  // The newest chunk is appended to again, the others are recycled as the
+  // log grows back.
+  for (Chunk& chunk : chunks_)
+    chunk.used = 0;
+}
+
+std::vector<std::string> LogStore::GetTail(size_t count) const {
+  count = std::min(count, lines_.size());
+  std::vector<std::string> tail;
+  tail.reserve(count);
+  for (size_t i = lines_.size() - count; i < lines_.size(); ++i)
+    tail.emplace_back(lines_[i].data, lines_[i].size);
+  return tail;
+}
+
+std::vector<LogStore::Entry> LogStore::GetTailEntries(size_t count) const {
+  count = std::min(count, lines_.size());
+  std::vector<Entry> tail;
+  tail.reserve(count);
+  for (size_t i = lines_.size() - count; i < lines_.size(); ++i) {
+    tail.push_back(
+        {lines_[i].time, std::string(lines_[i].data, lines_[i].size)});
+  }
+  return tail;
+}
+
+LogStore::ReadResult LogStore::ReadSince(uint64_t sequence,
+                                         size_t max_count) const {
+  ReadResult result;
+  result.first_sequence = first_sequence();
+  const uint64_t start = std::clamp(sequence, first_sequence(), next_sequence_);
+  const size_t begin = static_cast<size_t>(start - first_sequence());
+  const size_t end = begin + std::min(max_count, lines_.size() - begin);
+  result.lines.reserve(end - begin);
+  for (size_t i = begin; i < end; ++i)
+    result.lines.emplace_back(lines_[i].data, lines_[i].size);
+  result.next_sequence = first_sequence() + end;
+  return result;
+}
+
+void LogStore::ReserveBytes(size_t size) {
+  if (!chunks_.empty() &&
+      chunks_.back().used + size <= options_.chunk_size) {
+    return;
+  }
+  Chunk chunk;
+  if (chunks_.size() < options_.max_chunks) {
+    chunk.data = std::make_unique<char[]>(options_.chunk_size);
+  } else {
+    // Recycle the oldest chunk along with the lines in it, which are the
+    // oldest lines.
+    while (!lines_.empty() && lines_.front().chunk_id == chunks_.front().id)
+      DropOldestLine();
+    chunk = std::move(chunks_.front());
+    chunks_.pop_front();
+    chunk.used = 0;
+  }
+  chunk.id = next_chunk_id_++;
+  chunks_.push_back(std::move(chunk));
+}
+
+void LogStore::DropOldestLine() {
+  lines_.pop_front();
+  ++dropped_lines_;
+}
@@ -0,0 +1,105 @@
+#ifndef AKAMA_SDK_SAMPLE_IPC_MOJO_BASE_LOG_STORE_H_
+#define AKAMA_SDK_SAMPLE_IPC_MOJO_BASE_LOG_STORE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "base/containers/circular_deque.h"
+#include "base/strings/string_piece.h"
+#include "base/time/time.h"
+
+// Bounded in-memory log. Line bytes are copied into large chunks that are
+// reused once the log wraps, so appending doesn't allocate in the steady
+// state and memory stays at |max_chunks| * |chunk_size| plus the index.
+// The oldest lines are dropped when the store is full, by line count or by
+// bytes, whichever comes first.
+//
+// Every line gets a sequence number, counting from 0 since the store was
+// created, so readers can resume where they left off and notice the lines
+// they missed, and the time it was appended, so the tails of several stores
+// can be merged.
+class LogStore {
+ public:
+  struct Options {
+    size_t max_lines = 100000;
+    size_t chunk_size = 64 * 1024;
+    size_t max_chunks = 64;
+  };
+
+  struct ReadResult {
+    ReadResult();
+    ReadResult(ReadResult&&);
+    ReadResult& operator=(ReadResult&&);
+    ~ReadResult();
+
+    // Oldest sequence number still stored. Lines before it were dropped.
+    uint64_t first_sequence = 0;
+    // Sequence number to continue reading from.
+    uint64_t next_sequence = 0;
+    std::vector<std::string> lines;
+  };
+
+  struct Entry {
+    base::TimeTicks time;
+    std::string line;
+  };
+
+  explicit LogStore(const Options& options);
+  LogStore(const LogStore&) = delete;
+  LogStore& operator=(const LogStore&) = delete;
+  ~LogStore();
+
+  // Lines longer than a chunk are truncated.
+  void Append(base::StringPiece line);
+  // Drops every line. Keeps the chunks for reuse and the sequence numbers.
+  void Clear();
+
+  // Returns up to |count| of the newest lines, oldest first.
+  std::vector<std::string> GetTail(size_t count) const;
+  // Like GetTail(), with the time each line was appended.
+  std::vector<Entry> GetTailEntries(size_t count) const;
+  // Returns up to |max_count| lines starting at |sequence|, or at the oldest
+  // line still stored if |sequence| was dropped.
+  ReadResult ReadSince(uint64_t sequence, size_t max_count) const;
+
+  const Options& options() const { return options_; }
+  size_t size() const { return lines_.size(); }
+  bool empty() const { return lines_.empty(); }
+  uint64_t first_sequence() const { return next_sequence_ - lines_.size(); }
+  uint64_t next_sequence() const { return next_sequence_; }
+  // Lines dropped to make room.
+  uint64_t dropped_lines() const { return dropped_lines_; }
+
+ private:
+  struct Line {
+    const char* data;
+    size_t size;
+    uint64_t chunk_id;
+    base::TimeTicks time;
+  };
+
+  struct Chunk {
+    std::unique_ptr<char[]> data;
+    size_t used = 0;
+    // Counts up with every chunk started, recycled ones included.
+    uint64_t id = 0;
+  };
+
+  // Makes room for |size| bytes in the newest chunk.
+  void ReserveBytes(size_t size);
+  void DropOldestLine();
+
+  const Options options_;
+  // Oldest first.
+  base::circular_deque<Line> lines_;
+  // Oldest first, the last one is appended to.
+  base::circular_deque<Chunk> chunks_;
+  uint64_t next_chunk_id_ = 0;
+  uint64_t next_sequence_ = 0;
+  uint64_t dropped_lines_ = 0;
+};
+
+#endif  // AKAMA_SDK_SAMPLE_IPC_MOJO_BASE_LOG_STORE_H_
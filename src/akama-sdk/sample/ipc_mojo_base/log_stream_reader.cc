@@ -0,0 +1,63 @@
+#include "log_stream_reader.h"
+
+#include <utility>
+
+#include "base/check_op.h"
+
+LogStreamReader::LogStreamReader(mojo::ScopedDataPipeConsumerHandle stream,
+                                 size_t max_line_size,
+                                 LineCallback line_callback,
+                                 DoneCallback done)
+    : max_line_size_(max_line_size),
+      line_callback_(std::move(line_callback)),
+      done_(std::move(done)),
+      drainer_(this, std::move(stream)) {
+  DCHECK_GT(max_line_size_, 0u);
+}
+
+LogStreamReader::~LogStreamReader() {
+  DCHECK_CALLED_ON_VALID_SEQUENCE(sequence_checker_);
+}
+
+void LogStreamReader::OnDataAvailable(const void* data, size_t num_bytes) {
+  DCHECK_CALLED_ON_VALID_SEQUENCE(sequence_checker_);
+  num_bytes_ += num_bytes;
+  base::StringPiece remaining(static_cast<const char*>(data), num_bytes);
+  while (!remaining.empty()) {
+    size_t newline = remaining.find('\n');
+    if (newline == base::StringPiece::npos) {
+      AppendPartialLine(remaining);
+      return;
+    }
+    base::StringPiece line = remaining.substr(0, newline);
+    remaining.remove_prefix(newline + 1);
+    if (partial_line_.empty()) {
+      line_callback_.Run(line);
+    } else {
+      AppendPartialLine(line);
+      line_callback_.Run(partial_line_);
+      partial_line_.clear();
+    }
+  }
+}
+
+void LogStreamReader::OnDataComplete() {
+  DCHECK_CALLED_ON_VALID_SEQUENCE(sequence_checker_);
+  // The last line may come without a newline.
+  if (!partial_line_.empty()) {
+    line_callback_.Run(partial_line_);
+    partial_line_.clear();
+  }
+  std::move(done_).Run(num_bytes_);
+}
+
+void LogStreamReader::AppendPartialLine(base::StringPiece data) {
+  while (partial_line_.size() + data.size() > max_line_size_) {
+    size_t size = max_line_size_ - partial_line_.size();
+    partial_line_.append(data.data(), size);
+    data.remove_prefix(size);
+    line_callback_.Run(partial_line_);
+    partial_line_.clear();
+  }
+  partial_line_.append(data.data(), data.size());
+}
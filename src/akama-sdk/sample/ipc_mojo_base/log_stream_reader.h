@@ -0,0 +1,58 @@
+#ifndef AKAMA_SDK_SAMPLE_IPC_MOJO_BASE_LOG_STREAM_READER_H_
+#define AKAMA_SDK_SAMPLE_IPC_MOJO_BASE_LOG_STREAM_READER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "base/callback.h"
+#include "base/sequence_checker.h"
+#include "base/strings/string_piece.h"
+#include "mojo/public/cpp/system/data_pipe.h"
+#include "mojo/public/cpp/system/data_pipe_drainer.h"
+
+// Reads '\n'-separated log lines from a data pipe as the producer writes
+// them, e.g. a captured request body that is still being received.
+//
+// Lines are handed out as views into the pipe's buffer, so the bytes are
+// only copied by whoever keeps them. The exception is a line that spans two
+// reads, which is joined in a buffer first. Such a line is split every
+// |max_line_size| bytes, so a producer that never writes a newline can't
+// make the reader grow without bound.
+class LogStreamReader : public mojo::DataPipeDrainer::Client {
+ public:
+  // Called with every line read, without the newline.
+  using LineCallback = base::RepeatingCallback<void(base::StringPiece line)>;
+  // Called with the number of bytes read once the producer closed the pipe.
+  using DoneCallback = base::OnceCallback<void(uint64_t num_bytes)>;
+
+  // |done| may delete |this|.
+  LogStreamReader(mojo::ScopedDataPipeConsumerHandle stream,
+                  size_t max_line_size,
+                  LineCallback line_callback,
+                  DoneCallback done);
+  LogStreamReader(const LogStreamReader&) = delete;
+  LogStreamReader& operator=(const LogStreamReader&) = delete;
+  ~LogStreamReader() override;
+
+ private:
+  // mojo::DataPipeDrainer::Client:
+  void OnDataAvailable(const void* data, size_t num_bytes) override;
+  void OnDataComplete() override;
+
+  // Appends |data| to |partial_line_|, handing out full buffers.
+  void AppendPartialLine(base::StringPiece data);
+
+  const size_t max_line_size_;
+  const LineCallback line_callback_;
+  DoneCallback done_;
+  mojo::DataPipeDrainer drainer_;
+
+  // Start of a line whose newline wasn't read yet.
+  std::string partial_line_;
+  uint64_t num_bytes_ = 0;
+
+  SEQUENCE_CHECKER(sequence_checker_);
+};
+
+#endif  // AKAMA_SDK_SAMPLE_IPC_MOJO_BASE_LOG_STREAM_READER_H_
@@ -0,0 +1,265 @@
+#include "logger_service.h"
+
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <utility>
+
+#include "base/barrier_callback.h"
+#include "base/barrier_closure.h"
+#include "base/bind.h"
+#include "base/strings/string_number_conversions.h"
+#include "base/strings/string_piece.h"
+#include "base/system/sys_info.h"
+#include "base/task/sequenced_task_runner.h"
+#include "base/task/thread_pool.h"
+#include "base/threading/sequenced_task_runner_handle.h"
+#include "log_ring.h"
+#include "log_stream_reader.h"
+#include "mojo/public/cpp/base/big_buffer.h"
+#include "mojo/public/cpp/bindings/receiver_set.h"
+
+namespace {
+
+// Sorts |lines| by time and keeps the newest |count|.
+void KeepNewest(size_t count, std::vector<LoggerService::TailLine>* lines) {
+  std::stable_sort(lines->begin(), lines->end(),
+                   [](const LoggerService::TailLine& a,
+                      const LoggerService::TailLine& b) {
+                     return a.time < b.time;
+                   });
+  if (lines->size() > count)
+    lines->erase(lines->begin(), lines->end() - count);
+}
+
+void MergeTails(size_t count,
+                LoggerService::TailCallback callback,
+                std::vector<std::vector<LoggerService::TailLine>> tails) {
+  std::vector<LoggerService::TailLine> merged;
+  for (std::vector<LoggerService::TailLine>& tail : tails) {
+    merged.insert(merged.end(), std::make_move_iterator(tail.begin()),
+                  std::make_move_iterator(tail.end()));
+  }
+  KeepNewest(count, &merged);
+  std::move(callback).Run(std::move(merged));
+}
+
+// Runs |done| on |task_runner|.
+void PostDone(scoped_refptr<base::SequencedTaskRunner> task_runner,
+              base::OnceClosure done) {
+  task_runner->PostTask(FROM_HERE, std::move(done));
+}
+
+// One client and its shard.
+class LoggerImpl : public sample::mojom::Logger {
+ public:
+  // Lines are also written to |sink| unless it is null.
+  LoggerImpl(uint64_t client_id,
+             const LogStore::Options& shard_options,
+             LogFileSink* sink)
+      : client_id_(client_id), store_(shard_options), sink_(sink) {}
+  LoggerImpl(const LoggerImpl&) = delete;
+  LoggerImpl& operator=(const LoggerImpl&) = delete;
+  ~LoggerImpl() override {}
+
+  uint64_t client_id() const { return client_id_; }
+  const LogStore& store() const { return store_; }
+
+  // sample::mojom::Logger:
+  void Log(const std::string& message) override { RecordLine(message); }
+
+  void LogBatch(const std::vector<std::string>& messages) override {
+    for (const std::string& message : messages)
+      RecordLine(message);
+  }
+
+  // A large payload is a mapping of shared memory, the lines are recorded
+  // straight from it.
+  void LogPayload(mojo_base::BigBuffer payload) override {
+    base::StringPiece text(reinterpret_cast<const char*>(payload.data()),
+                           payload.size());
+    while (!text.empty()) {
+      size_t newline = text.find('\n');
+      RecordLine(text.substr(0, newline));
+      if (newline == base::StringPiece::npos)
+        break;
+      text.remove_prefix(newline + 1);
+    }
+  }
+
+  // One reader per stream, deleted once it replied.
+  void LogStream(mojo::ScopedDataPipeConsumerHandle stream,
+                 LogStreamCallback callback) override {
+    const uint64_t id = next_stream_id_++;
+    stream_readers_[id] = std::make_unique<LogStreamReader>(
+        std::move(stream), store_.options().chunk_size,
+        base::BindRepeating(&LoggerImpl::RecordLine, base::Unretained(this)),
+        base::BindOnce(&LoggerImpl::OnStreamDone, base::Unretained(this), id,
+                       std::move(callback)));
+  }
+
+  // Lines read from the ring are recorded like the ones from the pipe.
+  void OpenRing(base::UnsafeSharedMemoryRegion region,
+                mojo::PendingReceiver<sample::mojom::LogRing> ring) override {
+    ring_consumer_ = LogRingConsumer::Create(
+        std::move(region), std::move(ring),
+        base::BindRepeating(&LoggerImpl::RecordLine, base::Unretained(this)));
+    if (!ring_consumer_)
+      return;
+    ring_consumer_->set_disconnect_handler(
+        base::BindOnce(&LoggerImpl::OnRingClosed, base::Unretained(this)));
+  }
+
+  void GetTail(uint32_t count, GetTailCallback callback) override {
+    std::move(callback).Run(store_.GetTail(
+        std::min(count, sample::mojom::Logger::kMaxLinesPerReply)));
+  }
+
+  void ReadSince(uint64_t sequence,
+                 uint32_t max_count,
+                 ReadSinceCallback callback) override {
+    LogStore::ReadResult result = store_.ReadSince(
+        sequence,
+        std::min(max_count, sample::mojom::Logger::kMaxLinesPerReply));
+    std::move(callback).Run(result.first_sequence, result.next_sequence,
+                            std::move(result.lines));
+  }
+
+ private:
+  void RecordLine(base::StringPiece line) {
+    if (sink_)
+      sink_->Write(line);
+    store_.Append(line);
+  }
+
+  void OnRingClosed() { ring_consumer_.reset(); }
+
+  void OnStreamDone(uint64_t id,
+                    LogStreamCallback callback,
+                    uint64_t num_bytes) {
+    std::move(callback).Run(num_bytes);
+    stream_readers_.erase(id);
+  }
+
+  const uint64_t client_id_;
+  LogStore store_;
+  LogFileSink* const sink_;
+  std::unique_ptr<LogRingConsumer> ring_consumer_;
+  std::map<uint64_t, std::unique_ptr<LogStreamReader>> stream_readers_;
+  uint64_t next_stream_id_ = 0;
+};
+
+}  // namespace
+
+// The clients bound on one sequence.
+class LoggerService::ShardGroup {
+ public:
+  ShardGroup(const LogStore::Options& shard_options,
+             const LogFileSink::Options& sink_options)
+      : shard_options_(shard_options) {
+    if (!sink_options.path.empty())
+      sink_ = std::make_unique<LogFileSink>(sink_options);
+    // Unretained is safe, the receivers are owned by |this|.
+    receivers_.set_disconnect_handler(base::BindRepeating(
+        &ShardGroup::OnDisconnect, base::Unretained(this)));
+  }
+  ShardGroup(const ShardGroup&) = delete;
+  ShardGroup& operator=(const ShardGroup&) = delete;
+  ~ShardGroup() = default;
+
+  void Bind(mojo::PendingReceiver<sample::mojom::Logger> receiver,
+            uint64_t client_id) {
+    auto client =
+        std::make_unique<LoggerImpl>(client_id, shard_options_, sink_.get());
+    mojo::ReceiverId id = receivers_.Add(client.get(), std::move(receiver));
+    clients_[id] = std::move(client);
+  }
+
+  std::vector<TailLine> GetTail(size_t count) {
+    std::vector<TailLine> tail;
+    for (const auto& it : clients_) {
+      const LoggerImpl& client = *it.second;
+      for (LogStore::Entry& entry : client.store().GetTailEntries(count))
+        tail.push_back({entry.time, client.client_id(), std::move(entry.line)});
+    }
+    KeepNewest(count, &tail);
+    return tail;
+  }
+
+  void Flush(base::OnceClosure done) {
+    if (sink_)
+      sink_->Flush(std::move(done));
+    else
+      std::move(done).Run();
+  }
+
+ private:
+  // Purges the shard of the client that went away.
+  void OnDisconnect() { clients_.erase(receivers_.current_receiver()); }
+
+  const LogStore::Options shard_options_;
+  // Declared before the clients writing to it and the receivers calling
+  // them, so it is destroyed last.
+  std::unique_ptr<LogFileSink> sink_;
+  std::map<mojo::ReceiverId, std::unique_ptr<LoggerImpl>> clients_;
+  mojo::ReceiverSet<sample::mojom::Logger> receivers_;
+};
+
+LoggerService::Options::Options() = default;
+
+LoggerService::Options::Options(const Options&) = default;
+
+LoggerService::Options::~Options() = default;
+
+LoggerService::LoggerService(const Options& options) {
+  size_t num_sequences = options.num_sequences;
+  if (num_sequences == 0)
+    num_sequences = base::SysInfo::NumberOfProcessors();
+  shard_groups_.reserve(num_sequences);
+  for (size_t i = 0; i < num_sequences; ++i) {
+    LogFileSink::Options sink_options = options.sink_options;
+    if (!sink_options.path.empty() && num_sequences > 1) {
+      sink_options.path = sink_options.path.InsertBeforeExtensionASCII(
+          "-" + base::NumberToString(i));
+    }
+    shard_groups_.emplace_back(
+        base::ThreadPool::CreateSequencedTaskRunner(
+            {base::TaskPriority::USER_VISIBLE}),
+        options.shard_options, sink_options);
+  }
+}
+
+LoggerService::~LoggerService() {
+  DCHECK_CALLED_ON_VALID_SEQUENCE(sequence_checker_);
+}
+
+void LoggerService::Bind(
+    mojo::PendingReceiver<sample::mojom::Logger> receiver) {
+  DCHECK_CALLED_ON_VALID_SEQUENCE(sequence_checker_);
+  const uint64_t client_id = next_client_id_++;
+  shard_groups_[client_id % shard_groups_.size()]
+      .AsyncCall(&ShardGroup::Bind)
+      .WithArgs(std::move(receiver), client_id);
+}
+
+void LoggerService::GetMergedTail(size_t count, TailCallback callback) {
+  DCHECK_CALLED_ON_VALID_SEQUENCE(sequence_checker_);
+  auto barrier = base::BarrierCallback<std::vector<TailLine>>(
+      shard_groups_.size(),
+      base::BindOnce(&MergeTails, count, std::move(callback)));
+  for (base::SequenceBound<ShardGroup>& shard_group : shard_groups_)
+    shard_group.AsyncCall(&ShardGroup::GetTail).WithArgs(count).Then(barrier);
+}
+
+void LoggerService::Flush(base::OnceClosure done) {
+  DCHECK_CALLED_ON_VALID_SEQUENCE(sequence_checker_);
+  base::RepeatingClosure barrier =
+      base::BarrierClosure(shard_groups_.size(), std::move(done));
+  for (base::SequenceBound<ShardGroup>& shard_group : shard_groups_) {
+    // The sinks reply on their sequences, |done| runs on this one.
+    shard_group.AsyncCall(&ShardGroup::Flush)
+        .WithArgs(base::BindOnce(&PostDone,
+                                 base::SequencedTaskRunnerHandle::Get(),
+                                 barrier));
+  }
+}
@@ -0,0 +1,81 @@
+#ifndef AKAMA_SDK_SAMPLE_IPC_MOJO_BASE_LOGGER_SERVICE_H_
+#define AKAMA_SDK_SAMPLE_IPC_MOJO_BASE_LOGGER_SERVICE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "akama-sdk/sample/ipc_mojo_base/mojom/logger.mojom.h"
+#include "base/callback.h"
+#include "base/sequence_checker.h"
+#include "base/threading/sequence_bound.h"
+#include "base/time/time.h"
+#include "log_file_sink.h"
+#include "log_store.h"
+#include "mojo/public/cpp/bindings/pending_receiver.h"
+
+// sample.mojom.Logger for many clients at once.
+//
+// Every client gets its own bounded LogStore, its shard, so a chatty client
+// only evicts its own lines, and Logger.GetTail()/ReadSince() read the
+// caller's shard. Clients are spread round-robin over |num_sequences|
+// ThreadPool sequences, each with a mojo::ReceiverSet of its own, so
+// ingestion runs on several cores without the shards sharing a lock. When a
+// client disconnects, only its shard is purged.
+//
+// GetMergedTail() reads the newest lines of every shard, ordered by the time
+// they were logged. Each sequence writes to a LogFileSink of its own, at
+// <path>-<index> when there is more than one.
+//
+// Lives on the sequence it was created on. Needs a ThreadPoolInstance.
+class LoggerService {
+ public:
+  struct Options {
+    Options();
+    Options(const Options&);
+    ~Options();
+
+    // Zero for one per core.
+    size_t num_sequences = 0;
+    // Bounds of every client's shard.
+    LogStore::Options shard_options;
+    // Empty |path| to keep the lines in memory only.
+    LogFileSink::Options sink_options;
+  };
+
+  struct TailLine {
+    base::TimeTicks time;
+    // In the order clients were bound, from 0.
+    uint64_t client_id;
+    std::string line;
+  };
+
+  using TailCallback = base::OnceCallback<void(std::vector<TailLine> lines)>;
+
+  explicit LoggerService(const Options& options);
+  LoggerService(const LoggerService&) = delete;
+  LoggerService& operator=(const LoggerService&) = delete;
+  // Disconnects every client. The shards go away on their sequences later.
+  ~LoggerService();
+
+  // Serves a new client.
+  void Bind(mojo::PendingReceiver<sample::mojom::Logger> receiver);
+  // Runs |callback| with the newest |count| lines of all clients, oldest
+  // first. Lines still queued in a pipe are not included.
+  void GetMergedTail(size_t count, TailCallback callback);
+  // Runs |done| once every line received so far is written to the sinks.
+  void Flush(base::OnceClosure done);
+
+  size_t num_sequences() const { return shard_groups_.size(); }
+
+ private:
+  class ShardGroup;
+
+  std::vector<base::SequenceBound<ShardGroup>> shard_groups_;
+  uint64_t next_client_id_ = 0;
+
+  SEQUENCE_CHECKER(sequence_checker_);
+};
+
+#endif  // AKAMA_SDK_SAMPLE_IPC_MOJO_BASE_LOGGER_SERVICE_H_
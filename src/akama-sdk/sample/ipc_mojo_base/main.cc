@@ -1,12 +1,31 @@
+#include <algorithm>
 #include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
 
 #include <mojo/core/embedder/embedder.h>
 #include <mojo/core/embedder/scoped_ipc_support.h>
-#include "akama-sdk/sample/ipc/mojom/logger.mojom.h"
+#include "akama-sdk/sample/ipc_mojo_base/mojom/logger.mojom.h"
+#include "base/bind.h"
+#include "base/containers/span.h"
+#include "base/files/file_util.h"
+#include "base/message_loop/message_pump_type.h"
+#include "base/run_loop.h"
+#include "base/strings/string_number_conversions.h"
+#include "base/synchronization/waitable_event.h"
+#include "base/task/single_thread_task_executor.h"
+#include "base/task/thread_pool/thread_pool_instance.h"
 #include "base/threading/thread.h"
 #include "base/time/time.h"
+#include "buffered_logger.h"
+#include "log_ring.h"
+#include "logger_service.h"
+#include "mojo/public/cpp/base/big_buffer.h"
+#include "mojo/public/cpp/bindings/pending_remote.h"
 #include "mojo/public/cpp/bindings/pending_receiver.h"
 #include "mojo/public/cpp/bindings/remote.h"
+#include "mojo/public/cpp/system/data_pipe.h"
 
 // clang-format off
 // Chromium Mojo & IPC：https://github.com/keyou/chromium_demo/blob/c/91.0.4472/docs/mojo.md
@@ -16,40 +35,132 @@
 // mojo c system api,使用较少：https://chromium.googlesource.com/chromium/src/+/refs/tags/103.0.5060.126/mojo/public/c/system/README.md
 // clang-format on
 
-class LoggerImpl : public sample::mojom::Logger {
- public:
-  // NOTE: A common pattern for interface implementations which have one
-  // instance per client is to take a PendingReceiver in the constructor.
-  // Receiver通过PendingReceiver从pipe接收消息，并反序列化消息以后调用T的方法。
-  explicit LoggerImpl(
-      mojo::PendingReceiver<sample::mojom::Logger> pending_receiver)
-      : receiver_(this, std::move(pending_receiver)) {
-    receiver_.set_disconnect_handler(
-        base::BindOnce(&LoggerImpl::OnError, base::Unretained(this)));
-  }
-  LoggerImpl(const LoggerImpl&) = delete;
-  LoggerImpl& operator=(const LoggerImpl&) = delete;
-  ~LoggerImpl() override {}
-
-  // sample::mojom::Logger:
-  void Log(const std::string& message) override {
-    std::cout << "[Logger] " << message << std::endl;
-    lines_.push_back(message);
+// 等待|logger|之前发送的消息全部处理完：同一个pipe上的消息按顺序处理，GetTail的回复最后到达
+template <typename LoggerType>
+void WaitForLogged(LoggerType& logger) {
+  base::RunLoop run_loop;
+  logger.GetTail(1, base::BindOnce(
+      [](base::OnceClosure quit, const std::vector<std::string>& tail) {
+        std::move(quit).Run();
+      },
+      run_loop.QuitClosure()));
+  run_loop.Run();
+}
+
+// 按序号增量读取|sender|的日志，下次从next_sequence继续。然后读所有客户端合并的最新日志，
+// 把sink写到磁盘以后通知|done|
+void ReadLogAndFlush(mojo::Remote<sample::mojom::Logger>* sender,
+                     LoggerService* service,
+                     base::WaitableEvent* done) {
+  (*sender)->ReadSince(
+      0, 100,
+      base::BindOnce(
+          [](LoggerService* service, base::WaitableEvent* done,
+             uint64_t first_sequence, uint64_t next_sequence,
+             const std::vector<std::string>& lines) {
+            for (size_t i = 0; i < lines.size(); ++i)
+              std::cout << "read " << next_sequence - lines.size() + i
+                        << ": " << lines[i] << std::endl;
+            // 每个客户端的shard里最新的行，按记录时间合并
+            service->GetMergedTail(
+                10, base::BindOnce(
+                        [](LoggerService* service, base::WaitableEvent* done,
+                           std::vector<LoggerService::TailLine> tail) {
+                          for (const LoggerService::TailLine& line : tail)
+                            std::cout << "merged tail: client "
+                                      << line.client_id << ": " << line.line
+                                      << std::endl;
+                          // 退出前把sink里还没写的日志写到磁盘
+                          service->Flush(
+                              base::BindOnce(&base::WaitableEvent::Signal,
+                                             base::Unretained(done)));
+                        },
+                        service, done));
+          },
+          service, done));
+}
+
+void PrintLogBenchmark(const char* name,
+                       uint64_t num_lines,
+                       uint64_t num_messages,
+                       base::TimeDelta elapsed) {
+  std::cout << name << " lines:" << num_lines << " messages:" << num_messages
+            << " time:" << elapsed.InMilliseconds() << "ms lines/s:"
+            << static_cast<int64_t>(num_lines / elapsed.InSecondsF())
+            << std::endl;
+}
+
+// 对比逐行Log、BufferedLogger合并成LogBatch、共享内存ring和多个客户端的吞吐，
+// 不写文件只测ipc开销。每个测试是LoggerService的一个新客户端，有自己的shard
+void RunLogBenchmark() {
+  base::SingleThreadTaskExecutor executor(base::MessagePumpType::IO);
+  constexpr int kNumLines = 100000;
+  LoggerService service{LoggerService::Options()};
+
+  // 每行一个mojo消息
+  {
+    mojo::Remote<sample::mojom::Logger> logger;
+    service.Bind(logger.BindNewPipeAndPassReceiver());
+    base::TimeTicks start = base::TimeTicks::Now();
+    for (int i = 0; i < kNumLines; ++i)
+      logger->Log("log line " + base::NumberToString(i));
+    WaitForLogged(*logger.get());
+    PrintLogBenchmark("Log", kNumLines, kNumLines,
+                      base::TimeTicks::Now() - start);
   }
 
-  void GetTail(GetTailCallback callback) override {
-    std::move(callback).Run(lines_.back());
+  // 按行数、字节数和时间合并成LogBatch
+  {
+    mojo::PendingRemote<sample::mojom::Logger> remote;
+    service.Bind(remote.InitWithNewPipeAndPassReceiver());
+    BufferedLogger logger(std::move(remote), BufferedLogger::Options());
+    base::TimeTicks start = base::TimeTicks::Now();
+    for (int i = 0; i < kNumLines; ++i)
+      logger.Log("log line " + base::NumberToString(i));
+    WaitForLogged(logger);
+    PrintLogBenchmark("LogBatch", logger.num_lines(), logger.num_messages(),
+                      base::TimeTicks::Now() - start);
   }
 
-  void OnError() {
-    std::cout << "Client disconnected! Purging log lines." << std::endl;
-    lines_.clear();
+  // 日志直接写进共享内存，pipe上只有consumer空闲时的Doorbell和最后的Flush。
+  // consumer在LoggerService的sequence上，和producer同时读写。consumer跟不上时ring满了，
+  // 放不下的行会被丢弃并计数
+  {
+    mojo::Remote<sample::mojom::Logger> remote;
+    service.Bind(remote.BindNewPipeAndPassReceiver());
+    std::unique_ptr<LogRingProducer> ring =
+        LogRingProducer::Create(remote.get(), 4 * 1024 * 1024);
+    if (!ring)
+      return;
+    base::TimeTicks start = base::TimeTicks::Now();
+    for (int i = 0; i < kNumLines; ++i)
+      ring->Write("log line " + base::NumberToString(i));
+    base::RunLoop run_loop;
+    ring->Flush(run_loop.QuitClosure());
+    run_loop.Run();
+    PrintLogBenchmark("LogRing", kNumLines, ring->num_doorbells() + 1,
+                      base::TimeTicks::Now() - start);
+    std::cout << "LogRing dropped lines:" << ring->dropped_lines()
+              << std::endl;
   }
 
- private:
-  mojo::Receiver<sample::mojom::Logger> receiver_;
-  std::vector<std::string> lines_;
-};
+  // 多个客户端同时写，LoggerService把它们分到不同的sequence上并行处理
+  {
+    constexpr int kNumClients = 8;
+    std::vector<mojo::Remote<sample::mojom::Logger>> loggers(kNumClients);
+    for (mojo::Remote<sample::mojom::Logger>& logger : loggers)
+      service.Bind(logger.BindNewPipeAndPassReceiver());
+    base::TimeTicks start = base::TimeTicks::Now();
+    for (int i = 0; i < kNumLines; ++i)
+      loggers[i % kNumClients]->Log("log line " + base::NumberToString(i));
+    for (mojo::Remote<sample::mojom::Logger>& logger : loggers)
+      WaitForLogged(*logger.get());
+    PrintLogBenchmark("Log 8 clients", kNumLines, kNumLines,
+                      base::TimeTicks::Now() - start);
+    std::cout << "LoggerService sequences:" << service.num_sequences()
+              << std::endl;
+  }
+}
 
 int main(int argc, char* argv[]) {
   std::cout << "start ipc:" << base::Time::Now() << std::endl;
@@ -59,14 +170,17 @@ int main(int argc, char* argv[]) {
     std::cout << "mojo init failed" << ret << std::endl;
     return 1;
   }
+  // LoggerService的shard在ThreadPool的sequence上接收日志，LogFileSink在ThreadPool上写文件
+  base::ThreadPoolInstance::CreateAndStartWithDefaultParams("ipc_mojo_base");
 
   base::Thread ipc_thread("ipc");
   base::Thread::Options options;
   options.message_pump_type = base::MessagePumpType::IO;
   ipc_thread.StartWithOptions(std::move(options));
 
+  base::WaitableEvent done;
   ipc_thread.task_runner()->PostTask(
-      FROM_HERE, base::BindOnce([]() {
+      FROM_HERE, base::BindOnce([](base::WaitableEvent* done) {
   // 两种方式等效：本质就是构造一个MessagePipe，sender和receiver分别绑定到两端来发送和接收
   // PendingRemote是发送端对pipe的封装，PendingReceiver是接收端对pipe的封装
   // Remote负责序列化T的接口调用，并通过PendingRemote把消息发送到pipe
@@ -88,20 +202,80 @@ int main(int argc, char* argv[]) {
             new mojo::Remote<sample::mojom::Logger>;
         auto pending_receiver = sender->BindNewPipeAndPassReceiver();
 #endif
-        LoggerImpl* recver = new LoggerImpl(std::move(pending_receiver));
-        (void)recver;
+        // LoggerService可以接多个客户端，每个客户端的日志在自己的shard里。
+        // 日志同时写入sink，sink在ThreadPool上写文件，不会阻塞接收日志的sequence
+        LoggerService::Options service_options;
+        service_options.num_sequences = 2;
+        base::FilePath temp_dir;
+        if (base::GetTempDir(&temp_dir)) {
+          service_options.sink_options.path =
+              temp_dir.AppendASCII("akama-sdk-ipc-logger.log");
+        }
+        LoggerService* service = new LoggerService(service_options);
+        service->Bind(std::move(pending_receiver));
+        // 另一个客户端
+        mojo::Remote<sample::mojom::Logger>* other =
+            new mojo::Remote<sample::mojom::Logger>;
+        service->Bind(other->BindNewPipeAndPassReceiver());
+        (*other)->Log("Hello from another client!");
 
         (*sender)->Log("Hello!");
-        (*sender)->GetTail(base::BindOnce([](const std::string& tail) {
-          std::cout << "tail: " << tail << std::endl;
-        }));
+        (*sender)->Log("World!");
+        (*sender)->GetTail(
+            1, base::BindOnce([](const std::vector<std::string>& tail) {
+              for (const std::string& line : tail)
+                std::cout << "tail: " << line << std::endl;
+            }));
+        // 大块日志用BigBuffer，超过阈值时放在共享内存里
+        const std::string stack = "stack:\n  #0 Crash()\n  #1 main()";
+        (*sender)->LogPayload(
+            mojo_base::BigBuffer(base::as_bytes(base::make_span(stack))));
+        // 还在生成的数据用data pipe边写边读，这里数据很少，一次写完就关闭
+        mojo::ScopedDataPipeProducerHandle producer;
+        mojo::ScopedDataPipeConsumerHandle consumer;
+        if (mojo::CreateDataPipe(nullptr, producer, consumer) !=
+            MOJO_RESULT_OK) {
+          ReadLogAndFlush(sender, service, done);
+          return;
+        }
+        const std::string body = "body line 1\nbody line 2";
+        uint32_t num_bytes = body.size();
+        producer->WriteData(body.data(), &num_bytes,
+                            MOJO_WRITE_DATA_FLAG_ALL_OR_NONE);
+        producer.reset();
+        // stream和Log之间没有顺序，读完stream再读全部日志。
+        // 不同客户端之间也没有顺序，等另一个客户端的日志处理完再读合并的日志
+        (*sender)->LogStream(
+            std::move(consumer),
+            base::BindOnce(
+                [](mojo::Remote<sample::mojom::Logger>* sender,
+                   mojo::Remote<sample::mojom::Logger>* other,
+                   LoggerService* service, base::WaitableEvent* done,
+                   uint64_t num_bytes) {
+                  std::cout << "stream bytes: " << num_bytes << std::endl;
+                  (*other)->GetTail(
+                      0, base::BindOnce(
+                             [](mojo::Remote<sample::mojom::Logger>* sender,
+                                LoggerService* service,
+                                base::WaitableEvent* done,
+                                const std::vector<std::string>& tail) {
+                               ReadLogAndFlush(sender, service, done);
+                             },
+                             sender, service, done));
+                },
+                sender, other, service, done));
 
-        // 模拟断开管道，触发LoggerImpl::OnError
+        // 模拟断开管道，只清空这个客户端的shard
         // sender->reset();
-      }));
+      }, &done));
+  done.Wait();
   // base::PlatformThread::Sleep(base::Milliseconds(1000));
   ipc_thread.Stop();
 
+  RunLogBenchmark();
+
+  // 等待BLOCK_SHUTDOWN的写文件任务完成
+  base::ThreadPoolInstance::Get()->Shutdown();
   MojoShutdown(nullptr);
   std::cout << "stop ipc:" << base::Time::Now() << std::endl;
   return 0;